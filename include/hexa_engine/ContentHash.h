@@ -0,0 +1,22 @@
+#pragma once
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/framework.h>
+#include <cstddef>
+#include <cstdint>
+
+// non-cryptographic 64-bit hash for telling if cached data is still up to date
+class EXPORT ContentHash
+{
+public:
+    static constexpr std::uint64_t seed = 14695981039346656037ull;
+
+    // fnv-1a over 8 byte words with extra mixing, bytes of tail one at a time
+    static std::uint64_t combine_bytes(std::uint64_t hash, const void* data, size_t size);
+
+    template<typename T>
+    static std::uint64_t combine(std::uint64_t hash, const T& value)
+    {
+        return combine_bytes(hash, &value, sizeof(T));
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "StaticMesh.h"
+
+#include <base_lib/List.h>
+#include <base_lib/framework.h>
+
+// how buffer capacity grows when geometry does not fit anymore
+enum class DynamicMeshGrowth
+{
+    // exactly what is needed, for geometry which rarely changes size
+    Exact,
+    // 1.5 times of what is needed
+    Moderate,
+    // 2 times of what is needed, for geometry which grows steadily
+    Double
+};
+
+// mesh for procedural geometry which is rebuilt often, keeps cpu copy and dynamic gpu buffers of each sub-mesh
+// changes are uploaded as sub-range patches, buffers are recreated only when capacity is exceeded
+// has no auto collision
+class EXPORT DynamicMesh : public StaticMesh
+{
+public:
+    explicit DynamicMesh(const String& name);
+
+    // name must not be used by other alive mesh, nullptr otherwise
+    static Shared<DynamicMesh> create(const String& name, uint sub_mesh_count, uint vertex_capacity = 1024, uint index_capacity = 4096, DynamicMeshGrowth growth = DynamicMeshGrowth::Double);
+
+    // replace geometry of sub-mesh, only range which differs from previous geometry is uploaded
+    void set_sub_mesh(uint sub_mesh, const List<Vertex>& vertices, const List<uint>& indices);
+    // overwrite part of sub-mesh vertices, range must be within current vertex count
+    void update_vertices(uint sub_mesh, uint first_vertex, const List<Vertex>& vertices);
+    // overwrite part of sub-mesh indices, range must be within current index count
+    void update_indices(uint sub_mesh, uint first_index, const List<uint>& indices);
+
+    const List<Vertex>& get_vertices(uint sub_mesh) const;
+    const List<uint>& get_indices(uint sub_mesh) const;
+
+    DynamicMeshGrowth get_growth() const { return growth_; }
+    void set_growth(DynamicMeshGrowth growth) { growth_ = growth; }
+
+    // bytes uploaded to gpu since creation, for profiling
+    size_t get_uploaded_bytes() const { return uploaded_bytes_; }
+
+private:
+    struct Section
+    {
+        List<Vertex> vertices;
+        List<uint> indices;
+        uint vertex_capacity;
+        uint index_capacity;
+        Vector3 bounds_min;
+        Vector3 bounds_max;
+    };
+
+    uint grow(uint required) const;
+    void create_vertex_buffer(uint sub_mesh, uint capacity);
+    void create_index_buffer(uint sub_mesh, uint capacity);
+    void write_vertices(uint sub_mesh, uint first, uint count);
+    void write_indices(uint sub_mesh, uint first, uint count);
+    void update_bounds(uint sub_mesh);
+
+    List<Section> sections_;
+    DynamicMeshGrowth growth_;
+    size_t uploaded_bytes_ = 0;
+};
@@ -128,6 +128,8 @@ public:
 private:
     void start();
     void tick(float delta_time);
+    // scene node is being rendered during pipelined tick, it gets new transform when frame is published
+    bool defer_scene_node_update();
 
     bool tick_enabled_ = false;
 
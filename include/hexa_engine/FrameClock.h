@@ -0,0 +1,57 @@
+#pragma once
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/framework.h>
+#include <chrono>
+#include <cstdint>
+
+// measures frame time with steady clock and paces frames to given interval
+// waiting sleeps while there is enough time left and spins the rest, so frame cap holds even with coarse os timer
+class EXPORT FrameClock
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // frame time statistics collected since previous report
+    struct Report
+    {
+        uint frames;
+        double average;
+        double deviation;
+        double min;
+        double max;
+    };
+
+    FrameClock();
+
+    // wait until at least min_frame_time passed since previous frame began, zero does not wait
+    // returns seconds since previous frame began
+    double tick(double min_frame_time = 0.0);
+
+    double get_delta() const { return delta_; }
+    // seconds since clock was created
+    double get_elapsed() const;
+    std::uint64_t get_frame_count() const { return frame_count_; }
+
+    // collected statistics are reset every time report is taken
+    bool take_report(double interval, Report& out_report);
+
+private:
+    void wait_until(Clock::time_point target);
+
+    Clock::time_point start_;
+    Clock::time_point frame_start_;
+    Clock::time_point next_frame_;
+    double delta_ = 0.0;
+    std::uint64_t frame_count_ = 0;
+
+    // how much longer than requested os sleep took recently, in seconds
+    double sleep_overshoot_;
+
+    Clock::time_point report_start_;
+    uint report_frames_ = 0;
+    double report_sum_ = 0.0;
+    double report_sum_squared_ = 0.0;
+    double report_min_ = 0.0;
+    double report_max_ = 0.0;
+};
@@ -1,8 +1,11 @@
 ﻿#pragma once
 
 #include "EventBus.h"
+#include "FrameClock.h"
 #include "GameInfo.h"
 #include "KeyCode.h"
+#include "MainThreadQueue.h"
+#include "MeshCache.h"
 #include "Module.h"
 #include "SoundHandle.h"
 #include "Table.h"
@@ -14,7 +17,8 @@
 #include <base_lib/Vector2.h>
 #include <base_lib/Vector3.h>
 #include <base_lib/Version.h>
-#include <mutex>
+#include <cstdint>
+#include <vector>
 
 class ITool;
 class TableBase;
@@ -131,7 +135,15 @@ public:
         return cast<T>(get_event_bus());
     }
 
-    static void call_on_main_thread(std::function<void()> func);
+    // run func on main thread at the beginning of one of next frames, higher priority runs first when frame budget is short
+    template<typename F>
+    static void call_on_main_thread(F&& func, MainThreadPriority priority = MainThreadPriority::Normal) {
+        instance_->main_thread_queue_.post(MainThreadTask(std::forward<F>(func)), priority);
+    }
+
+    // seconds per frame spent on main thread calls, rest is carried to next frame, zero is unlimited
+    static double get_main_thread_budget() { return instance_->main_thread_budget_; }
+    static void set_main_thread_budget(double seconds);
 
     static Shared<Texture>& get_white_texture() { return instance_->white_texture_; }
     static Shared<Texture>& get_uv_test_texture() { return instance_->uv_test_texture_; }
@@ -152,10 +164,23 @@ public:
     static void add_ui(const Shared<UIElement>& ui);
     static float get_ui_scale();
     static Vector3 get_un_projected_mouse();
-    static float get_time();
+    // seconds since render loop began, double keeps sub-millisecond precision over long sessions
+    static double get_time();
+    // real duration of last frame
+    static double get_delta_time();
+    static std::uint64_t get_frame_count();
 
     static GameStage get_stage();
 
+    // launched with --headless, there is no window, render system, textures and materials, world is ticked at fixed rate
+    // --unthrottled ticks as fast as possible instead of real time, --ticks N quits after N ticks
+    static bool is_headless();
+
+    // world of next frame is ticked on own thread while current frame is rendered, enabled with --pipelined
+    // takes effect when render loop starts, ogre objects changed during tick have to go through World::run_render_command
+    static bool is_pipelined_rendering();
+    static void set_pipelined_rendering(bool state);
+
     template<Convertible<Compound::Object> T>
     Shared<Table<T>> create_table(const Name& name) {
         if (!CheckError(get_stage() == GameStage::Initialization, "Database", "Table %s can be created only during initialization", name.c()))
@@ -197,8 +222,17 @@ private:
     bool handle_tool();
     void initialization_stage();
     void loading_stage();
+    void load_render_resources();
     void start();
+    // frame clock, game time and main thread calls, returns time of tick
+    double begin_frame();
     void render_loop();
+    void pipelined_render_loop();
+    void simulation_loop();
+    void run_main_thread_calls();
+    void update_sound_listener();
+    // input which arrives while tick runs is handled before next tick, returns true if event was queued
+    bool defer_input(MainThreadTask&& event);
     void unloading_stage();
 
     void search_table_files(const Path& path);
@@ -227,10 +261,11 @@ private:
     Vector2 mouse_pos_;
     Vector2 mouse_delta_;
     Vector3 un_projected_mouse_;
-    float time_;
+    double time_ = 0.0;
+    FrameClock frame_clock_;
 
     // Assets
-    Map<String, Shared<StaticMesh>> meshes_;
+    MeshCache meshes_;
     Map<String, Shared<Animation>> animations_;
     Map<String, Shared<Audio>> audios_;
     List<Shared<AudioChannel>> audio_channels_;
@@ -260,7 +295,18 @@ private:
     Ogre::Viewport* viewport_;
     Weak<UIElement> ui_under_mouse_;
     Weak<UIElement> pressed_ui_;
-    List<std::function<void()>> main_thread_calls_;
-    std::mutex main_thread_calls_mutex_;
+    MainThreadQueue main_thread_queue_;
+    double main_thread_budget_ = 0.004;
     Map<Name, Shared<ITool>> tools_;
+
+    // Headless
+    bool headless_ = false;
+    // tick as fast as possible instead of real time, for throughput measurements
+    bool headless_unthrottled_ = false;
+    // quit after this many ticks, zero is unlimited
+    uint headless_tick_limit_ = 0;
+
+    // Pipelining
+    bool pipelined_ = false;
+    std::vector<MainThreadTask> deferred_input_;
 };
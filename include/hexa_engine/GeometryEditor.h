@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "StaticMesh.h"
+#include "Transform.h"
 
 #include <base_lib/Color.h>
 #include <base_lib/List.h>
@@ -16,12 +17,80 @@ public:
         uint index;
     };
 
+    // result of post-transform vertex cache simulation
+    struct CacheStatistics
+    {
+        uint vertices_transformed;
+        // average cache miss ratio, transformed vertices per triangle, 0.5 is the best possible on big meshes
+        float acmr;
+        // average transform to vertex ratio, 1.0 means each vertex is transformed once
+        float atvr;
+    };
+
+    // how triangles contribute to normals of their vertices
+    enum class NormalWeighting
+    {
+        // each triangle counts the same
+        Uniform,
+        // bigger triangles count more, cheapest and good for even tessellation
+        Area,
+        // triangles count by their corner angle at vertex, independent of tessellation
+        Angle
+    };
+
+    // instruction set used by vectorized kernels
+    enum class SimdLevel
+    {
+        Scalar,
+        SSE,
+        AVX
+    };
+
+    // cache size used by default, close to what most desktop GPUs have
+    static constexpr uint default_cache_size = 16;
+
+    // remap table entry for vertex that must be dropped
+    static constexpr uint removed_vertex = static_cast<uint>(-1);
+
+    // sequence of geometry passes that can be built once and applied to many meshes
+    class EXPORT Pipeline
+    {
+    public:
+        typedef std::function<void(List<StaticMesh::Vertex>& vertices, List<uint>& indices)> Step;
+
+        // merge vertices, same by pos, uv and normal within epsilon
+        Pipeline& weld(float epsilon = 0.0f);
+        // merge vertices, same by pos within epsilon
+        Pipeline& weld_positions(float epsilon = 0.0f);
+        Pipeline& remove_unused_vertices();
+        Pipeline& compute_normals(bool invert = false, NormalWeighting weighting = NormalWeighting::Uniform);
+        Pipeline& optimize_vertex_cache(uint cache_size = default_cache_size);
+        Pipeline& optimize_overdraw(uint cache_size = default_cache_size);
+        Pipeline& optimize_vertex_fetch();
+        // keep ratio of triangles, unused vertices are removed
+        Pipeline& simplify(float ratio, float target_error = 1.0f);
+        Pipeline& translate(const Vector3& offset);
+        Pipeline& rotate(const Quaternion& quat);
+        Pipeline& scale(const Vector3& factor);
+        Pipeline& transform(const Transform& transformation);
+        Pipeline& add(const Step& step);
+
+        void run(List<StaticMesh::Vertex>& vertices, List<uint>& indices) const;
+
+    private:
+        List<Step> steps_;
+    };
+
     static Vector3 compute_normal(const Vector3& a, const Vector3& b, const Vector3& c);
 
-    // merge vertices, same by pos, uv and normal
-    static void optimize(List<StaticMesh::Vertex>& vertices, List<uint>& indices);
-    // merge vertices, same by pos
-    static void optimize_collision(List<StaticMesh::Vertex>& vertices, List<uint>& indices);
+    // merge vertices, same by pos, uv and normal within epsilon
+    static void optimize(List<StaticMesh::Vertex>& vertices, List<uint>& indices, float epsilon = 0.0f);
+    // merge vertices, same by pos within epsilon
+    static void optimize_collision(List<StaticMesh::Vertex>& vertices, List<uint>& indices, float epsilon = 0.0f);
+    // fill remap table with new index for each vertex, merged vertices share index, returns unique vertex count
+    static uint generate_vertex_remap(const List<StaticMesh::Vertex>& vertices, List<uint>& out_remap, bool positions_only = false, float epsilon = 0.0f);
+    // move vertices to places from remap table and rewrite indices in single pass
+    static void apply_vertex_remap(List<StaticMesh::Vertex>& vertices, List<uint>& indices, const List<uint>& remap, uint vertex_count);
     // remove indices for vertex rendering
     static void remove_indices(List<StaticMesh::Vertex>& vertices, List<uint>& indices);
     // invert triangles in vertex-only geometry
@@ -40,14 +109,31 @@ public:
     static void rotate(List<StaticMesh::Vertex>& vertices, const Quaternion& quat);
     // scale geometry
     static void scale(List<StaticMesh::Vertex>& vertices, const Vector3& factor);
+    // scale, rotate and translate positions and transform normals accordingly in one pass
+    static void transform(List<StaticMesh::Vertex>& vertices, const Transform& transformation);
+    // same with explicitly chosen kernel, level must not be higher than get_simd_level()
+    static void transform(List<StaticMesh::Vertex>& vertices, const Transform& transformation, SimdLevel level);
+    // best instruction set supported by cpu, detected once
+    static SimdLevel get_simd_level();
     // move geometry to center
     static void move_to_center(List<StaticMesh::Vertex>& vertices);
     // group triangles by same normals
     static void compute_faces(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices, List<Face>& out_faces, List<uint>& out_indices);
     // calculate normals from triangles into separate array
     static void compute_normals(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices, List<Vector3>& out_normals, bool invert = false);
-    // compute normals for triangles in place
-    static void compute_normals(List<StaticMesh::Vertex>& vertices, const List<uint>& indices, bool invert = false);
+    // compute smooth vertex normals in place, vertices not used by any triangle keep their normals
+    static void compute_normals(List<StaticMesh::Vertex>& vertices, const List<uint>& indices, bool invert = false, NormalWeighting weighting = NormalWeighting::Uniform);
+    // reorder triangles for post-transform vertex cache (Tipsify)
+    static void optimize_vertex_cache(List<uint>& indices, uint vertex_count, uint cache_size = default_cache_size);
+    // reorder clusters of cache-ordered triangles so that outer ones are drawn first
+    static void optimize_overdraw(const List<StaticMesh::Vertex>& vertices, List<uint>& indices, uint cache_size = default_cache_size);
+    // reorder vertices by first use in indices, unused vertices are removed
+    static void optimize_vertex_fetch(List<StaticMesh::Vertex>& vertices, List<uint>& indices);
+    // simulate FIFO post-transform vertex cache over indices
+    static CacheStatistics analyze_vertex_cache(const List<uint>& indices, uint vertex_count, uint cache_size = default_cache_size);
+    // quadric edge collapse until target index count or error relative to mesh size is reached, uv and normal seams and borders are kept
+    // vertices are not changed, returns relative error of result
+    static float simplify(const List<StaticMesh::Vertex>& vertices, List<uint>& indices, uint target_index_count, float target_error = 1.0f);
     // remove vertices that are not referred by indices
     static void remove_unused_vertices(List<StaticMesh::Vertex>& vertices, List<uint>& indices);
 
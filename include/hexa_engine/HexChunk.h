@@ -0,0 +1,111 @@
+#pragma once
+
+#include "StaticMesh.h"
+
+#include <base_lib/List.h>
+#include <base_lib/Pointers.h>
+#include <base_lib/framework.h>
+#include <functional>
+
+class DynamicMesh;
+class HexChunk;
+class Material;
+
+// tile types shared by hex chunks, tiles are hexagonal prisms with sides facing 0, 60, ... 300 degrees around Z
+// tile templates are in tile space: centered in XY, from 0 to height in Z
+// all tiles must be added before chunks using set start building
+class EXPORT HexTileSet
+{
+    friend HexChunk;
+
+public:
+    // lateral sides in order of their angles, then top, bottom and faces which are not on any side
+    static constexpr uint side_count = 9;
+    static constexpr uint side_top = 6;
+    static constexpr uint side_bottom = 7;
+    static constexpr uint side_inner = 8;
+
+    // apothem is distance from tile center to its side, height is size along Z
+    HexTileSet(float apothem, float height);
+
+    // materials are per sub-mesh, returns tile id, 0 is reserved for empty space
+    // non-opaque tiles hide only faces shared with tiles of the same id, like water surface inside water
+    byte16 add_tile(const List<StaticMesh::SubMesh>& sub_meshes, const List<Shared<Material>>& materials, bool opaque = true);
+
+    uint get_tile_count() const { return tiles_.length(); }
+    // distinct materials of all tiles, chunk meshes have one sub-mesh per each of them
+    const List<Shared<Material>>& get_materials() const { return materials_; }
+
+    float get_apothem() const { return apothem_; }
+    float get_height() const { return height_; }
+    // position of tile origin in chunk space, x and y are axial coordinates
+    Vector3 get_tile_position(int x, int y, int z) const;
+
+private:
+    struct Piece
+    {
+        uint material;
+        List<StaticMesh::Vertex> vertices;
+        List<uint> indices;
+    };
+
+    struct TileType
+    {
+        List<Piece> sides[side_count];
+        bool opaque;
+    };
+
+    float apothem_;
+    float height_;
+    List<TileType> tiles_;
+    List<Shared<Material>> materials_;
+};
+
+// box of hex tiles merged into one mesh with sub-mesh per material, faces hidden by neighbours are dropped
+// changed layers are rebuilt on workers, mesh is updated on main thread
+class EXPORT HexChunk : public EnableSharedFromThis<HexChunk>
+{
+public:
+    // name is base of mesh name, id is appended so that chunks with same name don't clash
+    HexChunk(const String& name, const Shared<const HexTileSet>& tile_set, uint size_x, uint size_y, uint size_z);
+
+    uint get_size_x() const { return size_x_; }
+    uint get_size_y() const { return size_y_; }
+    uint get_size_z() const { return size_z_; }
+
+    byte16 get_tile(uint x, uint y, uint z) const;
+    // call from main thread, mesh is updated on next update()
+    void set_tile(uint x, uint y, uint z, byte16 tile);
+
+    // start rebuild of changed layers if there is none running, call from main thread every frame
+    void update();
+    bool is_building() const { return building_; }
+
+    // null until first rebuild is finished
+    const Shared<DynamicMesh>& get_mesh() const { return mesh_; }
+    // called on main thread when mesh got new geometry
+    void set_on_rebuilt(const std::function<void()>& callback) { on_rebuilt_ = callback; }
+
+private:
+    typedef List<StaticMesh::SubMesh> LayerGeometry;
+
+    static void build_layer(const HexTileSet& tile_set, const List<byte16>& tiles, uint size_x, uint size_y, uint size_z, uint z, LayerGeometry& out_geometry);
+    void apply(const List<uint>& layers, const List<LayerGeometry>& geometry, const List<StaticMesh::SubMesh>& merged);
+
+    uint get_index(uint x, uint y, uint z) const { return x + size_x_ * (y + size_y_ * z); }
+
+    String name_;
+    Shared<const HexTileSet> tile_set_;
+    uint size_x_;
+    uint size_y_;
+    uint size_z_;
+    List<byte16> tiles_;
+
+    // geometry of each layer is kept, so that single tile change rebuilds at most three layers
+    List<LayerGeometry> layers_;
+    List<bool> dirty_layers_;
+    bool building_ = false;
+
+    Shared<DynamicMesh> mesh_;
+    std::function<void()> on_rebuilt_;
+};
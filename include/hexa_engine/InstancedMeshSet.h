@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Transform.h"
+
+#include <base_lib/Color.h>
+#include <base_lib/List.h>
+#include <base_lib/Map.h>
+#include <base_lib/Pointers.h>
+#include <base_lib/Quaternion.h>
+#include <base_lib/framework.h>
+#include <cstdint>
+
+class Material;
+class StaticMesh;
+class World;
+
+namespace Ogre
+{
+    class InstancedEntity;
+    class InstanceManager;
+}
+
+// many copies of one mesh without entity, scene node or component per copy, for foliage, rocks and debris
+// instances are kept in contiguous transform array and addressed by index, removal moves last instance into freed index
+// instances are grouped into cells with own static instance batches
+// changes only touch arrays of the set, ogre entities follow them and are uploaded once per cell at the end of world tick
+class EXPORT InstancedMeshSet
+{
+    friend World;
+
+    struct Cell
+    {
+        // per sub-mesh
+        List<Ogre::InstanceManager*> managers;
+        Vector3 origin;
+        uint count = 0;
+        bool dirty = false;
+        bool fragmented = false;
+        bool visible = true;
+    };
+
+public:
+    InstancedMeshSet(World* world, const Shared<StaticMesh>& mesh, const List<Shared<Material>>& materials);
+    ~InstancedMeshSet();
+
+    // returns index of new instance
+    uint add(const Transform& transform);
+    void add_many(const List<Transform>& transforms);
+    // last instance takes removed index
+    void remove(uint index);
+    void update(uint index, const Transform& transform);
+    // overwrite transforms starting at first index, range must be within current count
+    void update_many(uint first, const List<Transform>& transforms);
+    void clear();
+
+    // float4 shader parameter of instance, see InstanceParams
+    const Quaternion& get_parameter(uint index, uint parameter) const { return parameters_[index * parameter_count_ + parameter]; }
+    void set_parameter(uint index, uint parameter, const Quaternion& value);
+    // tint and variation are kept when instance moves into other cell
+    void set_tint(uint index, const Color& tint);
+    void set_variation(uint index, uint variation);
+
+    const Transform& get_transform(uint index) const { return transforms_[index]; }
+    const List<Transform>& get_transforms() const { return transforms_; }
+    uint get_count() const { return transforms_.length(); }
+
+    const Shared<StaticMesh>& get_mesh() const { return mesh_; }
+
+    // cells farther than this from camera are hidden, zero disables distance culling
+    float get_cull_distance() const { return cull_distance_; }
+    void set_cull_distance(float distance) { cull_distance_ = distance; }
+
+    uint get_cell_count() const { return cells_.size(); }
+    uint get_visible_cell_count() const;
+
+private:
+    Cell& get_or_create_cell(std::uint64_t key);
+    void create_entities(uint index);
+    void destroy_entities(uint index);
+    // entities of removed instance are destroyed on next flush
+    void retire_entities(uint index);
+    void mark_pending(uint index);
+    // bring entities of instance in line with its transform and parameters
+    void sync_instance(uint index);
+    void apply_transform(uint index);
+    void apply_parameters(uint index);
+
+    // apply pending changes, upload dirty cells and hide far ones, called by world at the end of tick or when pipelined frame is published
+    void flush(const Vector3* camera_location);
+    // scene manager is about to be destroyed
+    void release();
+
+    World* world_;
+    Shared<StaticMesh> mesh_;
+    List<Shared<Material>> materials_;
+    uint sub_mesh_count_;
+    float cull_distance_ = 0.0f;
+
+    List<Transform> transforms_;
+    List<std::uint64_t> instance_cells_;
+    // sub_mesh_count_ entities per instance
+    List<Ogre::InstancedEntity*> entities_;
+    // parameter_count_ values per instance
+    List<Quaternion> parameters_;
+    uint parameter_count_;
+
+    // instances changed since last flush
+    List<uint> pending_;
+    List<bool> pending_flags_;
+    List<Ogre::InstancedEntity*> retired_entities_;
+    // one per removed instance which had entities
+    List<std::uint64_t> retired_cells_;
+
+    Map<std::uint64_t, Cell> cells_;
+    uint next_cell_id_ = 0;
+    uint id_;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/framework.h>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// order in which queued calls are run, each lane with work runs at least one call per frame so none of them starves
+enum class MainThreadPriority : uint
+{
+    // gameplay continuations, something waits for them
+    High,
+    Normal,
+    // gpu uploads of loaded assets and other work that only has to be done eventually
+    Low
+};
+
+// move-only callable, small captures are stored inline so posting them does not allocate
+class EXPORT MainThreadTask
+{
+public:
+    MainThreadTask() = default;
+
+    template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, MainThreadTask>>>
+    MainThreadTask(F&& func)
+    {
+        typedef std::decay_t<F> Func;
+        if constexpr (sizeof(Func) <= inline_size && alignof(Func) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<Func>)
+        {
+            new (storage_) Func(std::forward<F>(func));
+            ops_ = &inline_ops<Func>;
+        }
+        else
+        {
+            *reinterpret_cast<Func**>(storage_) = new Func(std::forward<F>(func));
+            ops_ = &heap_ops<Func>;
+        }
+    }
+
+    MainThreadTask(MainThreadTask&& other) noexcept;
+    MainThreadTask& operator=(MainThreadTask&& other) noexcept;
+    MainThreadTask(const MainThreadTask&) = delete;
+    MainThreadTask& operator=(const MainThreadTask&) = delete;
+    ~MainThreadTask();
+
+    void operator()();
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    // fits std::function of every standard library
+    static constexpr size_t inline_size = 64;
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to);
+        void (*destroy)(void* storage);
+    };
+
+    template<typename Func>
+    inline static const Ops inline_ops = {
+        [](void* storage) { (*static_cast<Func*>(storage))(); },
+        [](void* from, void* to) {
+            new (to) Func(std::move(*static_cast<Func*>(from)));
+            static_cast<Func*>(from)->~Func();
+        },
+        [](void* storage) { static_cast<Func*>(storage)->~Func(); }
+    };
+
+    template<typename Func>
+    inline static const Ops heap_ops = {
+        [](void* storage) { (**static_cast<Func**>(storage))(); },
+        [](void* from, void* to) { *static_cast<Func**>(to) = *static_cast<Func**>(from); },
+        [](void* storage) { delete *static_cast<Func**>(storage); }
+    };
+
+    alignas(std::max_align_t) byte storage_[inline_size];
+    const Ops* ops_ = nullptr;
+};
+
+// calls posted from any thread and run on main thread
+// posting only holds lock for append, queue is swapped out under lock and run without it
+// calls which don't fit into frame budget stay queued for next frame
+class EXPORT MainThreadQueue
+{
+public:
+    void post(MainThreadTask&& task, MainThreadPriority priority = MainThreadPriority::Normal);
+
+    // run queued calls until budget in seconds is used up, zero runs everything which was queued before this call
+    // returns number of calls run
+    uint run(double budget);
+
+    // calls waiting to run, including ones carried over from previous frames, main thread only
+    uint get_pending_count();
+
+    static constexpr uint lane_count = 3;
+
+private:
+    struct Lane
+    {
+        // filled by any thread under mutex
+        std::vector<MainThreadTask> posted;
+        // owned by main thread
+        std::deque<MainThreadTask> ready;
+    };
+
+    Lane lanes_[lane_count];
+    std::mutex mutex_;
+};
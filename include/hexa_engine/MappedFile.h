@@ -0,0 +1,28 @@
+#pragma once
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/Path.h>
+#include <base_lib/Pointers.h>
+#include <base_lib/framework.h>
+
+// read-only view of a whole file mapped into memory
+class EXPORT MappedFile
+{
+public:
+    ~MappedFile();
+
+    static Shared<MappedFile> open(const Path& path);
+
+    const byte* get_data() const { return data_; }
+    size_t get_size() const { return size_; }
+
+private:
+    MappedFile() = default;
+
+    const byte* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
@@ -2,36 +2,82 @@
 
 #include "ModuleAssetID.h"
 
+#include <base_lib/Map.h>
 #include <base_lib/Pointers.h>
+#include <base_lib/Quaternion.h>
+#include <base_lib/String.h>
 
 class Game;
+class Shader;
 class Texture;
 class TileInfo;
 class MeshComponent;
 class Module;
+class InstancedMeshSet;
+class MaterialInstance;
 
 namespace Ogre
 {
     class Material;
 }
 
+// custom float4 parameters of every hardware instance, available to instancing shaders
+namespace InstanceParams
+{
+    // rgb multiplier and alpha
+    const uint TINT = 0;
+    // x is index of material variant, shaders pick texture layer or color by it
+    const uint VARIATION = 1;
+    const uint COUNT = 2;
+
+    // white tint, zero everything else
+    EXPORT Quaternion get_default(uint parameter);
+} // namespace InstanceParams
+
 class EXPORT Material
 {
     friend Module;
     friend MeshComponent;
+    friend InstancedMeshSet;
+    friend MaterialInstance;
 
 public:
+    virtual ~Material() = default;
+
     const ModuleAssetID& get_id() const { return id_; }
 
-    uint get_textures_count() const;
-    Shared<Texture> get_texture(uint index) const;
-    void set_texture(const Shared<Texture>& texture, uint index);
+    // texture units of material, same for all its instances
+    virtual uint get_textures_count() const;
+    virtual Shared<Texture> get_texture(uint index) const;
+    // null texture shows uv test one, both in material and in its instances
+    virtual void set_texture(const Shared<Texture>& texture, uint index);
 
-    bool is_instanced() const { return ogre_material_instancing_ != nullptr; }
+    // ShaderFeatures bits which programs of material have code for
+    uint get_supported_features() const;
+    bool is_instanced() const;
 
 private:
+    struct TextureVariant
+    {
+        Shared<Ogre::Material> material;
+        // units which keep these textures when material texture changes
+        Map<uint, Shared<Texture>> textures;
+    };
+
+    // ogre material with programs compiled for requested ShaderFeatures bits, unsupported bits are ignored
+    // variants are made on first request, so only combinations some mesh actually renders with cost anything
+    virtual Shared<Ogre::Material> get_ogre_material(uint features = 0);
+    // copy of ogre material with some textures replaced, shared by every instance with same replacements
+    Shared<Ogre::Material> get_texture_variant(const Map<uint, Shared<Texture>>& textures, uint features);
+    uint get_variant_features(uint features) const;
+
+    // features_ are always on, material was created with them
     Shared<Ogre::Material> ogre_material_;
-    Shared<Ogre::Material> ogre_material_instancing_;
+    Shared<Shader> vertex_shader_;
+    Shared<Shader> fragment_shader_;
+    uint features_ = 0;
     List<Shared<Texture>> textures_;
     ModuleAssetID id_;
+    Map<uint, Shared<Ogre::Material>> variants_;
+    Map<String, TextureVariant> texture_variants_;
 };
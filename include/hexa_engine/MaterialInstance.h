@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Material.h"
+
+#include <base_lib/Map.h>
+#include <base_lib/Quaternion.h>
+
+// variant of material which keeps passes and programs of its parent and replaces only some textures and parameters
+// instances with no texture replacements use ogre material of parent, ones with same replacements share one copy of it
+// so meshes using instances of one parent are sorted and batched together, and variant costs no more than its overrides
+// texture changes of instance or its parent show up right away, other changes apply when instance is set on mesh again
+class EXPORT MaterialInstance : public Material
+{
+    friend MeshComponent;
+
+public:
+    // instance of instance takes over its overrides and refers to the same parent
+    explicit MaterialInstance(const Shared<Material>& parent);
+
+    const Shared<Material>& get_parent() const { return parent_; }
+
+    uint get_textures_count() const override;
+    // replacement texture, or texture of parent
+    Shared<Texture> get_texture(uint index) const override;
+    void set_texture(const Shared<Texture>& texture, uint index) override;
+    // back to texture of parent
+    void reset_texture(uint index);
+
+    // float4 custom parameter of renderable, for instanced meshes index has to be below InstanceParams::COUNT
+    // parameters set on mesh component itself take precedence
+    bool get_parameter(uint index, Quaternion& out_value) const;
+    void set_parameter(uint index, const Quaternion& value);
+    void reset_parameter(uint index);
+    const Map<uint, Quaternion>& get_parameters() const { return parameters_; }
+
+private:
+    Shared<Ogre::Material> get_ogre_material(uint features = 0) override;
+    void update_ogre_materials();
+
+    Shared<Material> parent_;
+    Map<uint, Shared<Texture>> texture_overrides_;
+    Map<uint, Quaternion> parameters_;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <base_lib/List.h>
+#include <base_lib/Map.h>
+#include <base_lib/Pointers.h>
+#include <base_lib/String.h>
+#include <base_lib/framework.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+class StaticMesh;
+
+// finished or in-flight load of one mesh, shared by everyone who requested it
+class EXPORT MeshLoad
+{
+    friend StaticMesh;
+
+public:
+    typedef std::function<void(const Shared<StaticMesh>& mesh)> Callback;
+    typedef std::function<Shared<StaticMesh>()> Upload;
+
+    bool is_done() const;
+    // null while loading or if load failed
+    Shared<StaticMesh> get_mesh() const;
+    // callback runs on main thread when load is done, or right away if it is done already
+    void then(const Callback& callback);
+    // block until done, must not be called from main thread because upload is performed there
+    Shared<StaticMesh> wait() const;
+
+private:
+    // worker part is done, upload is what is left for main thread
+    void prepare(const Upload& upload);
+    // wait for worker part and run upload unless it ran already, called on main thread
+    Shared<StaticMesh> complete();
+    // first result wins, called on main thread
+    void finish(const Shared<StaticMesh>& mesh);
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable done_condition_;
+    bool done_ = false;
+    Upload upload_;
+    Shared<StaticMesh> mesh_;
+    List<Callback> callbacks_;
+};
+
+// loaded and loading meshes by path, safe to use from any thread
+class EXPORT MeshCache
+{
+public:
+    Shared<MeshLoad> find(const String& key) const;
+    // existing load of key, or new one which caller has to perform, in which case out_created is set
+    Shared<MeshLoad> find_or_add(const String& key, bool& out_created);
+    void remove(const String& key);
+    void clear();
+
+private:
+    Map<String, Shared<MeshLoad>> loads_;
+    mutable std::mutex mutex_;
+};
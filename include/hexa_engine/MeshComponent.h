@@ -3,10 +3,12 @@
 #include "CollisionMaskBits.h"
 #include "EntityComponent.h"
 
+#include <base_lib/Map.h>
 #include <base_lib/Matrix4x4.h>
 #include <base_lib/Name.h>
 #include <base_lib/Quaternion.h>
 #include <base_lib/Vector2.h>
+#include <cstdint>
 
 class Material;
 
@@ -15,6 +17,7 @@ namespace Ogre
     class InstanceManager;
     class InstancedEntity;
     class Entity;
+    class SceneNode;
 } // namespace Ogre
 
 class Collision;
@@ -36,6 +39,8 @@ enum class PhysicalBodyType
 
 class EXPORT MeshComponent : public EntityComponent
 {
+    friend World;
+
 public:
     explicit MeshComponent(const Shared<StaticMesh>& mesh, const List<Shared<Material>>& materials);
     explicit MeshComponent(const Shared<StaticMesh>& mesh, const Shared<Material>& material);
@@ -54,7 +59,10 @@ public:
     void set_material(const Shared<Material>& material, uint material_slot);
     Shared<Material> get_material(uint material_slot) const;
 
+    // float4 shader parameter, for instanced meshes it is per instance and index must be below InstanceParams::COUNT
     void set_material_parameter(Quaternion value, uint material_slot, uint parameter_index);
+    // variant of material selected by instancing shader, unlike set_material does not move instance into other batch
+    void set_material_variant(uint variant, uint material_slot);
 
     PhysicalBodyType get_body_type() const { return body_type_; }
     void set_body_type(PhysicalBodyType body_type);
@@ -62,21 +70,43 @@ public:
     bool is_visible() const { return is_visible_; }
     void set_visibility(bool state);
 
+    // merge with other static meshes nearby into buffers shared per material, applies to static bodies with non-instanced meshes of full vertex format
+    // batched mesh stays where owner was when it was batched
+    bool is_static_batching() const { return static_batching_; }
+    void set_static_batching(bool state);
+
 private:
+    // physics part is immediate, ogre part goes through World::run_render_command
     void spawn_mesh(const Shared<Entity>& owner, const Shared<World>& world);
+    void spawn_render_objects(const Shared<Entity>& owner, const Shared<World>& world, const Shared<StaticMesh>& mesh);
+    void respawn_mesh();
     void update_visibility();
     void destroy_mesh(const Shared<Entity>& owner, const Shared<World>& world);
+    void destroy_render_objects(const Shared<Entity>& owner, const Shared<World>& world);
+    void apply_material(uint slot);
     Shared<Material> get_valid_material(uint slot);
+    // variant of slot material which also decodes vertex format of spawned mesh
+    Shared<Ogre::Material> get_valid_ogre_material(uint slot, uint features = 0);
+    void create_instanced_entity(uint slot, Ogre::SceneNode* node);
+    void apply_material_parameters(uint slot);
 
     Shared<StaticMesh> mesh_;
     List<Shared<Material>> materials_;
+    // parameters set per slot, applied again whenever entities are recreated
+    List<Map<uint, Quaternion>> material_parameters_;
     reactphysics3d::RigidBody* rigid_body_ = nullptr;
     reactphysics3d::Collider* collider_ = nullptr;
     Shared<Collision> collision_;
     byte16 collision_mask_ = CollisionMaskBits::NONE;
     PhysicalBodyType body_type_ = PhysicalBodyType::Dynamic;
     bool is_visible_ = true;
+    bool static_batching_ = false;
+    // entity is only template of static batch member and is never attached
+    bool static_batched_ = false;
+    std::uint64_t static_batch_cell_ = 0;
 
+    // mesh whose ogre objects exist, lags behind mesh_ while pipelined tick runs
+    Shared<StaticMesh> spawned_mesh_;
     Ogre::Entity* ogre_entity_ = nullptr;
     List<Ogre::InstancedEntity*> ogre_instanced_entities_;
     List<Ogre::InstanceManager*> cached_instance_managers_;
@@ -4,6 +4,7 @@
 
 #include <base_lib/Array2D.h>
 #include <base_lib/Color.h>
+#include <base_lib/List.h>
 #include <base_lib/Map.h>
 #include <base_lib/Name.h>
 #include <base_lib/Path.h>
@@ -40,9 +41,14 @@ public:
     virtual Path get_module_path(const String& sub_path = "") const = 0;
 
     Shared<Texture> load_texture(const Name& name);
+    // decode and mips are made on worker, texture is white until upload runs on main thread
+    Shared<Texture> load_texture_async(const Name& name);
+    // every png in sub-directory of textures, named "directory/file"
+    List<Shared<Texture>> load_textures_async(const String& directory);
     Shared<Texture> create_texture(const Array2D<Color>& pixels, const Name& name);
 
     Shared<Material> load_material(const Name& name);
+    // full copy of ogre material registered under new name, for variants which only differ in textures or parameters use MaterialInstance
     Shared<Material> clone_material(const Shared<Material>& material, const Name& new_name = Name());
 
     Path get_resources_path() const;
@@ -58,7 +64,10 @@ private:
 
     static void reset_global_resources_directories();
 
+    // parses description only, programs are compiled when material first asks for them
     Shared<Shader> load_shader_program(const Name& name);
+    // compile programs recorded as used in previous launches, ones missing from shader cache in parallel
+    void warm_shader_programs();
 
     Name module_name;
 
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "StaticMesh.h"
+
+#include <base_lib/List.h>
+#include <base_lib/Path.h>
+#include <base_lib/framework.h>
+
+// wavefront obj parser working on memory-mapped file in parallel line-aligned chunks
+// output is in file space, one vertex per face corner, sub-meshes are split by o, g and usemtl
+class EXPORT ObjImporter
+{
+public:
+    // returns false if file can not be read or has no faces
+    static bool import(const Path& path, List<StaticMesh::SubMesh>& out_sub_meshes);
+};
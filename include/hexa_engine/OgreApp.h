@@ -11,15 +11,24 @@
 
 class Texture;
 
+namespace Ogre
+{
+    class DefaultHardwareBufferManager;
+}
+
 class OgreApp : public OgreBites::ApplicationContext, public OgreBites::InputListener, OgreBites::WindowEventListener, public OgreBites::TrayListener
 {
 public:
     explicit OgreApp(const String& name);
 
     void setup() override;
+    // root without render system and window, for simulation on machines without gpu
+    void init_headless();
     void load();
     void close();
 
+    bool is_headless() const { return headless_buffer_manager_ != nullptr; }
+
     bool keyPressed(const OgreBites::KeyboardEvent& evt) override;
     bool keyReleased(const OgreBites::KeyboardEvent& evt) override;
     bool textInput(const OgreBites::TextInputEvent& evt) override;
@@ -46,4 +55,5 @@ public:
 
 private:
     Shared<OgreBites::TrayManager> ui_;
+    Shared<Ogre::DefaultHardwareBufferManager> headless_buffer_manager_;
 };
@@ -10,6 +10,7 @@ public:
 
     float get_physics_tick_interval() const { return physics_tick_interval_; }
 
+    // frames per second render loop is held to, 0 is unlimited
     uint fps_limit = 60;
 
     float audio_general = 1.0f;
@@ -1,31 +1,76 @@
 #pragma once
 
+#include "ModuleAssetID.h"
+
+#include <base_lib/List.h>
+#include <base_lib/Map.h>
 #include <base_lib/Pointers.h>
+#include <base_lib/Set.h>
+#include <base_lib/String.h>
 
 class Module;
 
 namespace Ogre {
     class GpuProgram;
-    
+    class HighLevelGpuProgram;
 }
 
+// optional parts of shader program, every set bit adds its define, program is compiled per combination which is actually used
+namespace ShaderFeatures
+{
+    const uint INSTANCING = 1 << 0;
+    const uint SKINNING = 1 << 1;
+    const uint ALPHA_TEST = 1 << 2;
+    const uint FOG = 1 << 3;
+    // vertex buffer layouts of VertexFormat, program gets decode functions from VertexQuantization
+    const uint COMPACT_VERTEX = 1 << 4;
+    const uint QUANTIZED_VERTEX = 1 << 5;
+    const uint COUNT = 6;
+
+    // name used in .sha and .mat files, index is bit position
+    EXPORT String get_name(uint index);
+    // unknown names are reported and skipped
+    EXPORT uint from_names(const List<String>& names);
+} // namespace ShaderFeatures
+
+// description of .sha program, programs for feature combinations are compiled on first use
 class Shader {
 private:
     friend Module;
     
 public:
     Shader();
-    Shader(Shared<Ogre::GpuProgram> regular);
-    Shader(Shared<Ogre::GpuProgram> regular, Shared<Ogre::GpuProgram> instanced);
 
     operator bool() const;
 
     bool is_valid() const;
-    bool has_instanced() const;
-    
-    Shared<Ogre::GpuProgram> try_get_instanced() const;
+    const ModuleAssetID& get_id() const { return id_; }
+
+    // features program source has code for, others are ignored when program is requested
+    uint get_features() const { return features_; }
+    bool has_program(uint features) const;
+
+    // compiled on first request, nullptr if compilation failed
+    Shared<Ogre::GpuProgram> get_program(uint features);
 
 private:
-    Shared<Ogre::GpuProgram> regular_;
-    Shared<Ogre::GpuProgram> instanced_;
+    // program with defines and parameters of features, not compiled yet
+    Shared<Ogre::HighLevelGpuProgram> create_program(uint features) const;
+    // compile or take from shader cache, nullptr on compile error
+    Shared<Ogre::GpuProgram> finish_program(uint features, const Shared<Ogre::HighLevelGpuProgram>& program);
+
+    ModuleAssetID id_;
+    String source_;
+    uint type_ = 0;
+    String entry_point_;
+    String target_;
+    List<String> defines_;
+    uint features_ = 0;
+    // auto constant types by parameter name, base ones and ones added by each feature
+    // instancing params replace base ones as instanced program gets world matrices from instance buffer
+    Map<String, uint> params_;
+    Map<String, uint> feature_params_[ShaderFeatures::COUNT];
+
+    Map<uint, Shared<Ogre::GpuProgram>> programs_;
+    Set<uint> failed_features_;
 };
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ModuleAssetID.h"
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/List.h>
+#include <base_lib/Path.h>
+#include <base_lib/Pointers.h>
+#include <base_lib/framework.h>
+
+namespace Ogre
+{
+    class HighLevelGpuProgram;
+}
+
+// shader program compiled with given features in some previous launch
+struct ShaderUsage
+{
+    ModuleAssetID shader;
+    uint features;
+};
+
+// compiled shader microcode kept on disk between launches, built on top of ogre microcode cache
+// entries are keyed by hash of source, defines, entry point and language, so edited program simply misses and is compiled again
+// file is kept per render system, microcode of one can't be used by another
+// next to it is list of program variants which were used, so that they can be compiled during loading instead of first frame needing them
+class EXPORT ShaderCache
+{
+public:
+    // enable microcode caching and read cache and usage list from directory, call before first program is loaded
+    static void load(const Path& directory);
+    // write cache and usage list back if something was compiled since they were loaded
+    static void save();
+
+    // true if program will be loaded from cache instead of compiled, counts towards report
+    static bool lookup(const Shared<Ogre::HighLevelGpuProgram>& program);
+    static void add_compile_time(double seconds);
+
+    static void record_usage(const ModuleAssetID& shader, uint features);
+    static const List<ShaderUsage>& get_usage() { return usage_; }
+    // log hits, misses and time spent compiling since last report
+    static void report();
+
+private:
+    inline static Path path_;
+    inline static Path usage_path_;
+    inline static bool enabled_ = false;
+    inline static bool loaded_ = false;
+    inline static List<ShaderUsage> usage_;
+    inline static bool usage_dirty_ = false;
+    inline static uint hits_ = 0;
+    inline static uint misses_ = 0;
+    inline static double compile_time_ = 0.0;
+};
@@ -1,11 +1,16 @@
 ﻿#pragma once
 
+#include "MeshCache.h"
+
 #include <base_lib/Path.h>
 #include <base_lib/Pointers.h>
 #include <base_lib/Quaternion.h>
 #include <base_lib/Vector3.h>
 
 class MeshComponent;
+class MappedFile;
+class DynamicMesh;
+class InstancedMeshSet;
 class Collision;
 class World;
 class Entity;
@@ -24,11 +29,37 @@ enum class AutoCollisionMode
     Complex
 };
 
+// layout of vertices in gpu buffer, compact ones need vertex programs with compact_vertex or quantized_vertex feature
+enum class VertexFormat : uint
+{
+    // float3 position, float2 uv, float3 normal, 32 bytes
+    Full,
+    // float3 position, half2 uv, octahedral normal in short2 normalized, 20 bytes
+    Compact,
+    // short4 normalized position relative to mesh bounds, half2 uv, octahedral normal in short2 normalized, 16 bytes
+    Quantized
+};
+
+// levels of detail generated from visible geometry by simplification
+struct MeshLodSettings
+{
+    // levels after full detail one, 0 disables lod
+    uint level_count = 0;
+    // part of triangles each level keeps from previous one
+    float reduction = 0.5f;
+    // camera distance where first simplified level starts, each next level starts twice as far
+    float distance = 2000.0f;
+    // part of triangles kept in Convex and Complex auto collision
+    float collision_reduction = 1.0f;
+};
+
 class EXPORT StaticMesh
 {
     friend Entity;
     friend World;
     friend MeshComponent;
+    friend DynamicMesh;
+    friend InstancedMeshSet;
 
 public:
     struct Vertex
@@ -65,10 +96,75 @@ public:
         Shared<Collision> collision;
     };
 
+    struct CookedCollision
+    {
+        enum class Type : uint
+        {
+            Sphere,
+            Box,
+            ConvexMesh,
+            ConcaveMesh
+        };
+
+        Type type;
+        Vector3 location;
+        Quaternion rotation;
+        // box half size, sphere radius is stored in x
+        Vector3 extent;
+        // ranges in collision_positions, collision_indices and collision_faces of CookedMesh
+        uint position_start;
+        uint position_count;
+        uint index_start;
+        uint index_count;
+        uint face_start;
+        uint face_count;
+    };
+
+    struct CookedSubMesh
+    {
+        uint index_start;
+        uint index_count;
+    };
+
+    struct CookedFace
+    {
+        uint size;
+        uint index;
+    };
+
+    // mesh after all processing, can be uploaded to gpu and physics as is
+    struct EXPORT CookedMesh
+    {
+        List<Vertex> vertices;
+        // indices of all sub-meshes, already offset into shared vertices
+        List<uint> indices;
+        List<CookedSubMesh> sub_meshes;
+        // starting camera distance of each simplified level
+        List<float> lod_distances;
+        // index ranges of simplified levels, all sub-meshes of level one after another
+        List<CookedSubMesh> lod_sub_meshes;
+        Vector3 bounds_min;
+        Vector3 bounds_max;
+
+        List<CookedCollision> collisions;
+        List<Vector3> collision_positions;
+        List<uint> collision_indices;
+        List<CookedFace> collision_faces;
+    };
+
     explicit StaticMesh(const String& name);
+    ~StaticMesh();
 
-    static Shared<StaticMesh> construct(const String& name, const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode = AutoCollisionMode::Default, bool compute_normals = true);
-    static Shared<StaticMesh> load_file_obj(const Path& path, AutoCollisionMode collision_mode = AutoCollisionMode::Default);
+    // name must not be used by other alive mesh, nullptr otherwise
+    static Shared<StaticMesh> construct(const String& name, const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode = AutoCollisionMode::Default, bool compute_normals = true, bool optimize = true, VertexFormat vertex_format = VertexFormat::Full, const MeshLodSettings& lod = MeshLodSettings());
+    // uses cooked .hmesh next to the source if it is up to date, cooks it otherwise
+    static Shared<StaticMesh> load_file_obj(const Path& path, AutoCollisionMode collision_mode = AutoCollisionMode::Default, VertexFormat vertex_format = VertexFormat::Full, const MeshLodSettings& lod = MeshLodSettings());
+    // same as load_file_obj, but file is read and cooked on worker threads and only gpu upload happens on main thread
+    // requests for the same path share one load
+    static Shared<MeshLoad> load_async(const Path& path, AutoCollisionMode collision_mode = AutoCollisionMode::Default, VertexFormat vertex_format = VertexFormat::Full, const MeshLodSettings& lod = MeshLodSettings());
+
+    // process sub-meshes into final buffers and collision shapes, does not touch gpu or physics
+    static CookedMesh cook(const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode = AutoCollisionMode::Default, bool compute_normals = true, bool optimize = true, const MeshLodSettings& lod = MeshLodSettings());
 
     uint get_material_count() const;
 
@@ -76,12 +172,33 @@ public:
     Vector3 get_bounds_half_size() const;
     bool is_empty() const;
 
+    VertexFormat get_vertex_format() const;
+    // box which quantized positions are relative to, shaders decode position as center + pos * extents
+    Vector3 get_quantization_center() const;
+    Vector3 get_quantization_extents() const;
+
     void make_instanced();
 
     static Shared<StaticMesh> empty;
 
 private:
-    static Shared<StaticMesh> create(const String& name, const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode, bool compute_normals);
+    struct CookedMeshView;
+    struct PreparedMesh;
+
+    static Shared<StaticMesh> create(const String& name, const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode, bool compute_normals, bool optimize, VertexFormat vertex_format, const MeshLodSettings& lod);
+    static Shared<StaticMesh> upload(const String& name, const CookedMeshView& cooked, VertexFormat vertex_format);
+    // nullptr and error if mesh resource with given name still exists, names have to be unique
+    static Shared<Ogre::Mesh> create_ogre_mesh(const String& name);
+
+    // everything that does not touch gpu, safe to call from worker
+    static Shared<PreparedMesh> prepare_file_obj(const Path& path, AutoCollisionMode collision_mode, const MeshLodSettings& lod);
+    // mesh cache key and mesh name of file load, every setting that changes result is part of it
+    static String get_load_key(const Path& path, AutoCollisionMode collision_mode, VertexFormat vertex_format, const MeshLodSettings& lod);
+    // main thread part of file load, failed one is dropped from mesh cache so that it can be retried
+    static MeshLoad::Upload make_upload(const String& key, const Shared<PreparedMesh>& prepared, VertexFormat vertex_format);
+    // map cache file and point view into it if it is up to date
+    static bool map_cooked(const Path& source_path, const Path& cooked_path, AutoCollisionMode collision_mode, const MeshLodSettings& lod, Shared<MappedFile>& out_file, CookedMeshView& out_view);
+    static bool save_cooked(const CookedMesh& cooked, const Path& source_path, const Path& cooked_path, AutoCollisionMode collision_mode, const MeshLodSettings& lod);
 
     List<CollisionShapeInfo> collisions_;
 
@@ -89,4 +206,8 @@ private:
 
     bool instanced_;
     String name_;
+
+    VertexFormat vertex_format_;
+    Vector3 quantization_center_;
+    Vector3 quantization_extents_;
 };
@@ -15,31 +15,129 @@ class Module;
 class Game;
 class UIElement;
 class Image;
+class TextureAtlas;
+class Texture;
 
 namespace Ogre {
     class Texture;
+    class Image;
 }
 
+// area of texture in pixels
+struct TextureRect
+{
+    uint x = 0;
+    uint y = 0;
+    uint width = 0;
+    uint height = 0;
+};
+
+enum class TextureLock
+{
+    Read,
+    // area is uploaded to gpu when region is released
+    Write,
+    ReadWrite
+};
+
+// strided view into cpu copy of texture pixels, rows are get_stride() pixels apart
+// writable region uploads only its own area when destroyed, main thread only
+class EXPORT TextureRegion {
+private:
+    friend Texture;
+
+public:
+    TextureRegion(TextureRegion&& other) noexcept;
+    TextureRegion(const TextureRegion&) = delete;
+    TextureRegion& operator=(const TextureRegion&) = delete;
+    TextureRegion& operator=(TextureRegion&&) = delete;
+    ~TextureRegion();
+
+    uint get_width() const { return rect_.width; }
+    uint get_height() const { return rect_.height; }
+    uint get_stride() const { return stride_; }
+    const TextureRect& get_rect() const { return rect_; }
+
+    Color* get_row(uint y) { return data_ + static_cast<size_t>(y) * stride_; }
+    const Color* get_row(uint y) const { return data_ + static_cast<size_t>(y) * stride_; }
+    Color& at(uint x, uint y) { return get_row(y)[x]; }
+    const Color& at(uint x, uint y) const { return get_row(y)[x]; }
+
+private:
+    TextureRegion(Texture* texture, const TextureRect& rect, Color* data, uint stride, bool write);
+
+    Texture* texture_;
+    TextureRect rect_;
+    Color* data_;
+    uint stride_;
+    bool write_;
+};
+
 class EXPORT Texture {
 private:
     friend Module;
     friend Material;
+    friend TextureAtlas;
+    friend TextureRegion;
 
 public:
     uint get_width() const;
     uint get_height() const;
+    // reads from cpu copy of pixels
     Color get_pixel(uint x, uint y) const;
 
     void save_to_file(const Path& path);
 
+    // uploads whole texture, or reloads it if size differs
     void put_pixels(const Array2D<Color>& pixels);
     Array2D<Color> get_pixels() const;
 
+    // pixel access works on cpu copy, which is read back from gpu once on first access and kept
+    // keeping it up front moves that readback to loading instead of first gameplay access
+    void keep_shadow_copy();
+    void release_shadow_copy();
+    bool has_shadow_copy() const { return shadow_valid_; }
+
+    // rect is clipped to texture size, texture must outlive region
+    TextureRegion lock_region(const TextureRect& rect, TextureLock mode = TextureLock::ReadWrite);
+
     const ModuleAssetID& get_id() const { return id_; }
 
+    // false while asynchronous load is in flight, texture is 1x1 white until then
+    bool is_loaded() const { return loaded_; }
+    // asynchronous load could not decode file, texture stays white until it is requested again
+    bool is_failed() const { return failed_; }
+
 private:
+    // image decoded by worker, handed over to main thread
+    struct PendingLoad;
+
     Texture();
 
+    // decode and convert to texture format, safe to call from worker thread
+    // mips are generated on cpu if requested, otherwise texture generates them on upload
+    static bool decode_file(const Path& path, bool generate_mipmaps, Ogre::Image& out_image);
+
+    // replace pixels and mips with prepared image, main thread only
+    void upload_image(const Ogre::Image& image);
+
+    // decode file on worker and upload it on main thread, texture keeps its current pixels until then
+    static void load_file_async(const Shared<Texture>& texture, const Path& path);
+    // wait for decoding of asynchronous load and upload it unless it is uploaded already, main thread only
+    // returns false if decoding failed
+    bool complete_load();
+
+    void ensure_shadow_copy() const;
+    // send part of cpu copy to gpu, lower mips are regenerated from whole copy
+    void upload_rect(const TextureRect& rect);
+
     Shared<Ogre::Texture> ogre_texture_;
     ModuleAssetID id_;
+    bool loaded_ = true;
+    bool failed_ = false;
+    Shared<PendingLoad> pending_;
+
+    // row-major, get_width() pixels per row, lazily filled by const accessors
+    mutable List<Color> shadow_;
+    mutable bool shadow_valid_ = false;
 };
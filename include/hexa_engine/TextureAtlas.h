@@ -0,0 +1,55 @@
+#pragma once
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/Map.h>
+#include <base_lib/Name.h>
+#include <base_lib/Pointers.h>
+#include <base_lib/String.h>
+#include <base_lib/Vector2.h>
+#include <base_lib/framework.h>
+
+class Module;
+class Texture;
+
+enum class TextureAtlasMode
+{
+    // textures packed side by side into one 2d texture, borders repeat edge pixels so mips don't bleed between neighbours
+    Atlas,
+    // one layer of 2d array texture per texture, all are scaled to size of the first one
+    Array
+};
+
+// place of one packed texture
+struct TextureAtlasEntry
+{
+    // whole 0..1 range in array mode
+    Vector2 uv_min;
+    Vector2 uv_max;
+    // always 0 in atlas mode
+    uint layer = 0;
+};
+
+// textures of one resource directory merged into single ogre texture, so that meshes using them can share one material
+// result is cached on disk and reused while none of source files changed
+class EXPORT TextureAtlas
+{
+public:
+    // pack every png in sub-directory of module textures, entries are named by file name without extension
+    // padding is rounded up to power of two, atlas gets as many mips as keep at least one border pixel
+    static Shared<TextureAtlas> build(const Shared<Module>& module, const String& directory, TextureAtlasMode mode, uint padding = 8);
+
+    TextureAtlasMode get_mode() const { return mode_; }
+    const Shared<Texture>& get_texture() const { return texture_; }
+
+    bool contains(const Name& name) const;
+    // empty entry for unknown name
+    TextureAtlasEntry get_entry(const Name& name) const;
+    const Map<Name, TextureAtlasEntry>& get_entries() const { return entries_; }
+
+private:
+    TextureAtlas() = default;
+
+    TextureAtlasMode mode_ = TextureAtlasMode::Atlas;
+    Shared<Texture> texture_;
+    Map<Name, TextureAtlasEntry> entries_;
+};
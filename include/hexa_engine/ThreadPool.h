@@ -0,0 +1,45 @@
+#pragma once
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/List.h>
+#include <base_lib/Pointers.h>
+#include <base_lib/framework.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// fixed set of worker threads shared by engine systems for background and parallel work
+class EXPORT ThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+    // processes items in [begin, end)
+    typedef std::function<void(uint begin, uint end)> RangeTask;
+
+    ~ThreadPool();
+
+    // pool sized to hardware, created on first use
+    static ThreadPool& get();
+
+    // run task on one of workers, order is not guaranteed
+    void enqueue(const Task& task);
+    // split [0, count) into ranges of at least grain items and process them on workers and calling thread, returns when all items are processed
+    // can be called from worker, calling thread keeps processing ranges itself so it never waits for queued tasks
+    void parallel_for(uint count, const RangeTask& task, uint grain = 1);
+
+    uint get_worker_count() const { return workers_.length(); }
+
+private:
+    explicit ThreadPool(uint worker_count);
+
+    void worker_loop();
+
+    List<Shared<std::thread>> workers_;
+    // fifo, popped from front under lock
+    std::deque<Task> tasks_;
+    std::mutex tasks_mutex_;
+    std::condition_variable tasks_condition_;
+    bool stopping_ = false;
+};
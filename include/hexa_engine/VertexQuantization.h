@@ -0,0 +1,59 @@
+#pragma once
+
+#include "StaticMesh.h"
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/String.h>
+#include <base_lib/Vector2.h>
+#include <base_lib/Vector3.h>
+#include <base_lib/framework.h>
+#include <cstdint>
+
+// cpu side encoding of compact vertex formats, shaders must decode them the same way
+class EXPORT VertexQuantization
+{
+public:
+    struct CompactVertex
+    {
+        Vector3 pos;
+        byte16 uv[2];
+        uint norm;
+    };
+
+    struct QuantizedVertex
+    {
+        std::int16_t pos[4];
+        byte16 uv[2];
+        uint norm;
+    };
+
+    // renderable custom parameters with quantization box, center and extents in xyz
+    static constexpr uint center_parameter = 0xfff0;
+    static constexpr uint extents_parameter = 0xfff1;
+
+    static uint get_vertex_size(VertexFormat format);
+
+    // ShaderFeatures bit material needs to read buffers of format, 0 for Full
+    static uint get_shader_features(VertexFormat format);
+    // hlsl decode_position and decode_normal for programs compiled with format feature
+    static String get_shader_source();
+
+    static byte16 float_to_half(float value);
+    static float half_to_float(byte16 value);
+
+    // octahedral mapping of unit vector into two 16-bit normalized values packed as x | y << 16
+    static uint encode_octahedral(const Vector3& normal);
+    static Vector3 decode_octahedral(uint encoded);
+
+    // position is mapped into [-1, 1] of box around center, w is always 1
+    static void encode_position(const Vector3& pos, const Vector3& center, const Vector3& extents, std::int16_t out[4]);
+    static Vector3 decode_position(const std::int16_t encoded[4], const Vector3& center, const Vector3& extents);
+
+    // extents that are safe to divide by, even for flat meshes
+    static Vector3 get_safe_extents(const Vector3& bounds_min, const Vector3& bounds_max);
+
+    // write vertices in given format, out must have room for count * get_vertex_size(format) bytes
+    static void encode(const StaticMesh::Vertex* vertices, uint count, VertexFormat format, const Vector3& bounds_min, const Vector3& bounds_max, byte* out);
+    // read vertices back, used for validation and cpu-side access
+    static void decode(const byte* data, uint count, VertexFormat format, const Vector3& bounds_min, const Vector3& bounds_max, StaticMesh::Vertex* out);
+};
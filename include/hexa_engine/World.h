@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "Entity.h"
+#include "MainThreadQueue.h"
 #include "SoundHandle.h"
 #include "TimerHandle.h"
 #include "Transform.h"
@@ -9,8 +10,12 @@
 #include <base_lib/List.h>
 #include <base_lib/Set.h>
 #include <base_lib/Vector3.h>
+#include <cstdint>
+#include <vector>
 
 class StaticMesh;
+class Material;
+class InstancedMeshSet;
 class Audio;
 class CameraComponent;
 class ItemDrop;
@@ -21,6 +26,7 @@ class Entity;
 
 namespace reactphysics3d {
     class PhysicsWorld;
+    class RigidBody;
 }
 
 namespace Ogre {
@@ -28,6 +34,7 @@ namespace Ogre {
     class Light;
     class SceneNode;
     class SceneManager;
+    class StaticGeometry;
 } // namespace Ogre
 
 class EXPORT World : public EnableSharedFromThis<World> {
@@ -35,12 +42,40 @@ class EXPORT World : public EnableSharedFromThis<World> {
     friend MeshComponent;
     friend CameraComponent;
     friend Entity;
+    friend InstancedMeshSet;
 
     struct TimerEntry {
         float time;
         std::function<void()> func;
     };
 
+    struct FrozenBody {
+        Vector3 linear_velocity;
+        Vector3 angular_velocity;
+        bool sleeping;
+    };
+
+    // instance managers of mesh created with one batch size, one per sub-mesh
+    struct InstanceManagerGroup {
+        List<Ogre::InstanceManager*> managers;
+        uint batch_size = 0;
+        uint live_count = 0;
+    };
+
+    // new instances go to the last group, groups with smaller batches stay until their last instance is released
+    struct MeshInstancing {
+        List<InstanceManagerGroup> groups;
+        uint live_count = 0;
+        uint next_group_id = 0;
+    };
+
+    // static meshes of one cell merged into shared buffers per material, rebuilt at the end of tick when membership changes
+    struct StaticBatchCell {
+        Ogre::StaticGeometry* geometry = nullptr;
+        Map<MeshComponent*, Transform> members;
+        bool dirty = false;
+    };
+
 public:
     bool spawn_entity(const Shared<Entity>& entity, const Transform& transform);
     bool spawn_entity(const Shared<Entity>& entity);
@@ -73,7 +108,7 @@ public:
     Vector3 get_gravity() const;
     void set_gravity(const Vector3& val) const;
 
-    float get_time() const { return time_; }
+    double get_time() const { return time_; }
 
     TimerHandle delay(float time, std::function<void()> func);
 
@@ -81,6 +116,33 @@ public:
 
     void set_directional_light(const Color& color, float intensity, const Quaternion& rotation);
 
+    // dynamic bodies farther than activation radius from every source are frozen until a source comes near
+    void add_activation_source(const Shared<Entity>& entity);
+    void remove_activation_source(const Shared<Entity>& entity);
+
+    float get_activation_radius() const { return activation_radius_; }
+    void set_activation_radius(float radius);
+
+    // merged static batches, each one costs draw call per material instead of per mesh
+    uint get_static_batch_count() const { return static_batch_cells_.size(); }
+
+    // set of mesh copies without entities, materials are per sub-mesh
+    Shared<InstancedMeshSet> create_instanced_mesh_set(const Shared<StaticMesh>& mesh, const List<Shared<Material>>& materials = {});
+    void destroy_instanced_mesh_set(const Shared<InstancedMeshSet>& set);
+
+    // change of ogre objects, while pipelined simulation runs it is delayed until simulated frame is published to renderer
+    template<typename F>
+    void run_render_command(F&& func) {
+        if (simulating_) {
+            render_commands_.push_back(MainThreadTask(std::forward<F>(func)));
+        } else {
+            func();
+        }
+    }
+
+    // true while tick runs on worker next to rendering of previous frame
+    bool is_simulating() const { return simulating_; }
+
 protected:
     virtual void on_start();
     virtual void on_tick(float delta_time);
@@ -95,7 +157,25 @@ private:
     void set_entity_tick_enabled(const Shared<Entity>& entity, bool state);
     void mark_entity_for_destroy(const Shared<Entity>& entity, bool state);
 
-    List<Ogre::InstanceManager*> get_or_create_instance_managers(const Shared<StaticMesh>& mesh, uint batch_instance_count, uint instanced_params_count);
+    void update_physics_activation();
+    void forget_body(reactphysics3d::RigidBody* body);
+
+    // batch size of new managers follows live instance count of mesh, every acquire must be paired with release
+    List<Ogre::InstanceManager*> acquire_instance_managers(const Shared<StaticMesh>& mesh);
+    void release_instance_managers(const Shared<StaticMesh>& mesh, const List<Ogre::InstanceManager*>& managers);
+    Ogre::InstanceManager* create_instance_manager(const String& name, const Shared<StaticMesh>& mesh, uint sub_mesh, uint batch_size) const;
+
+    // component must have template entity that is not attached to scene
+    void add_static_batch_member(MeshComponent* component, const Transform& transform);
+    void remove_static_batch_member(MeshComponent* component);
+    // materials of member changed
+    void mark_static_batch_dirty(MeshComponent* component);
+    void rebuild_static_batches();
+    void flush_instanced_mesh_sets();
+
+    // runs delayed render commands and copies transforms of moved entities to their scene nodes, main thread only
+    void apply_render_state();
+    void mark_render_dirty(const Shared<Entity>& entity);
 
     Set<Shared<Entity>> entities_;
     Set<Shared<Entity>> tick_list_;
@@ -114,9 +194,23 @@ private:
     Quaternion directional_rotation_;
     Ogre::SceneNode* directional_light_node_;
     Ogre::Light* directional_light_;
-    Map<Shared<StaticMesh>, List<Ogre::InstanceManager*>> instance_managers_;
+    Map<Shared<StaticMesh>, MeshInstancing> instance_managers_;
 
     Map<TimerHandle, TimerEntry> timer_entries_;
 
-    float time_ = 0.0f;
+    List<Weak<Entity>> activation_sources_;
+    Map<reactphysics3d::RigidBody*, FrozenBody> frozen_bodies_;
+    float activation_radius_ = 5000.0f;
+    float activation_check_accum_ = 0.0f;
+
+    Map<std::uint64_t, StaticBatchCell> static_batch_cells_;
+
+    List<Shared<InstancedMeshSet>> instanced_mesh_sets_;
+
+    // set by game around pipelined tick, scene graph is being rendered meanwhile and must not be touched
+    bool simulating_ = false;
+    std::vector<MainThreadTask> render_commands_;
+    Set<Shared<Entity>> render_dirty_entities_;
+
+    double time_ = 0.0;
 };
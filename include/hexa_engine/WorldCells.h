@@ -0,0 +1,18 @@
+#pragma once
+
+#include <base_lib/BasicTypes.h>
+#include <base_lib/Vector3.h>
+#include <base_lib/framework.h>
+#include <cstdint>
+
+// cubic grid which splits world for static batches and instanced mesh sets, so that far parts are culled as whole
+class EXPORT WorldCells
+{
+public:
+    static constexpr float cell_size = 5000.0f;
+
+    // 21 bits per axis, cells wrap around after about 5 billion units
+    static std::uint64_t get_key(const Vector3& location);
+    // min corner of cell containing location
+    static Vector3 get_origin(const Vector3& location);
+};
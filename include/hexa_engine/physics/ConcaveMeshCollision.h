@@ -19,6 +19,7 @@ class EXPORT ConcaveMeshCollision : public Collision
 
 public:
     ConcaveMeshCollision(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices);
+    ConcaveMeshCollision(const List<Vector3>& positions, const List<uint>& indices);
 
     ~ConcaveMeshCollision();
 
@@ -28,6 +29,8 @@ protected:
     reactphysics3d::CollisionShape* get_collider_shape() const override;
 
 private:
+    void create_shape();
+
     List<Vector3> vertices_copy_;
     List<uint> indices_copy_;
     reactphysics3d::TriangleVertexArray* triangle_vertex_array;
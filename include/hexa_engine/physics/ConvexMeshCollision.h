@@ -22,12 +22,19 @@ class EXPORT ConvexMeshCollision : public Collision
 
 public:
     ConvexMeshCollision(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices);
+    // construct from data which is already cooked
+    ConvexMeshCollision(const List<Vector3>& positions, const List<uint>& face_indices, const List<GeometryEditor::Face>& faces);
     ~ConvexMeshCollision();
 
+    // weld triangles and group them into polygon faces, the way physics expects them
+    static void cook(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices, List<Vector3>& out_positions, List<uint>& out_face_indices, List<GeometryEditor::Face>& out_faces);
+
 protected:
     reactphysics3d::CollisionShape* get_collider_shape() const override;
 
 private:
+    void create_shape();
+
     List<Vector3> vertices_copy_;
     List<uint> indices_copy_;
     List<GeometryEditor::Face> faces;
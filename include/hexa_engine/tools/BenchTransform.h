@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ITool.h"
+
+namespace Tools {
+    class BenchTransform : public ITool {
+        Name get_tool_name() const override { return "bench_transform"; }
+        String get_tool_description() const override { return "[vertex count] [iterations] compare GeometryEditor::transform kernels with per-vertex scale, rotate and translate"; }
+
+        void execute(const List<String>& args) override;
+    };
+} // namespace Tools
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ITool.h"
+
+namespace Tools {
+    class CheckVertexCache : public ITool {
+        Name get_tool_name() const override { return "check_vertex_cache"; }
+        String get_tool_description() const override { return "[grid size] check FIFO cache simulation on known index lists and that cache optimization lowers ACMR of shuffled grid"; }
+
+        void execute(const List<String>& args) override;
+    };
+} // namespace Tools
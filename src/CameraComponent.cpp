@@ -27,13 +27,15 @@ void CameraComponent::on_start()
     {
         if (auto world = owner->get_world())
         {
-            ogre_camera_ = world->manager_->createCamera("Camera");
-            ogre_camera_->setNearClipDistance(1);
-            ogre_camera_->setFarClipDistance(10000);
-            ogre_camera_->setAutoAspectRatio(true);
-            ogre_camera_->viewMatrixCalcDelegate = &makeViewMatrix;
+            world->run_render_command([this, self = shared_from_this(), owner, world]() {
+                ogre_camera_ = world->manager_->createCamera("Camera");
+                ogre_camera_->setNearClipDistance(1);
+                ogre_camera_->setFarClipDistance(10000);
+                ogre_camera_->setAutoAspectRatio(true);
+                ogre_camera_->viewMatrixCalcDelegate = &makeViewMatrix;
 
-            owner->scene_node_->attachObject(ogre_camera_);
+                owner->scene_node_->attachObject(ogre_camera_);
+            });
         }
     }
 }
@@ -44,7 +46,10 @@ void CameraComponent::on_destroy()
     {
         if (auto world = owner->get_world())
         {
-            world->manager_->destroyCamera(ogre_camera_);
+            world->run_render_command([this, self = shared_from_this(), world]() {
+                world->manager_->destroyCamera(ogre_camera_);
+                ogre_camera_ = nullptr;
+            });
         }
     }
 }
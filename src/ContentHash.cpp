@@ -0,0 +1,28 @@
+#include "hexa_engine/ContentHash.h"
+
+#include <cstring>
+
+const static std::uint64_t fnv_prime = 1099511628211ull;
+
+std::uint64_t ContentHash::combine_bytes(std::uint64_t hash, const void* data, size_t size)
+{
+    const auto bytes = static_cast<const byte*>(data);
+
+    size_t i = 0;
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+
+        // multiplication only carries upwards, shift brings high bits of word back down
+        hash = (hash ^ word) * fnv_prime;
+        hash ^= hash >> 32;
+    }
+
+    for (; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * fnv_prime;
+    }
+
+    return hash;
+}
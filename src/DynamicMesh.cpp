@@ -0,0 +1,285 @@
+#include "hexa_engine/DynamicMesh.h"
+
+#include <OgreHardwareBufferManager.h>
+#include <OgreMesh.h>
+#include <OgreSubMesh.h>
+#include <OgreVertexIndexData.h>
+#include <base_lib/Assert.h>
+#include <cstring>
+
+// range of elements in new data which differs from old data, new elements past old ones always differ
+template<typename T>
+static bool find_changed_range(const List<T>& old_data, const List<T>& new_data, uint& out_first, uint& out_count)
+{
+    const uint common = Math::min(old_data.length(), new_data.length());
+
+    uint first = 0;
+    while (first < common && memcmp(&old_data[first], &new_data[first], sizeof(T)) == 0) first++;
+
+    uint last = new_data.length();
+    if (new_data.length() <= old_data.length())
+    {
+        while (last > first && memcmp(&old_data[last - 1], &new_data[last - 1], sizeof(T)) == 0) last--;
+    }
+
+    out_first = first;
+    out_count = last - first;
+    return out_count > 0;
+}
+
+DynamicMesh::DynamicMesh(const String& name)
+    : StaticMesh(name)
+    , growth_(DynamicMeshGrowth::Double)
+{
+}
+
+Shared<DynamicMesh> DynamicMesh::create(const String& name, uint sub_mesh_count, uint vertex_capacity, uint index_capacity, DynamicMeshGrowth growth)
+{
+    Shared<DynamicMesh> result = MakeShared<DynamicMesh>(name);
+    result->growth_ = growth;
+    result->ogre_mesh_ = create_ogre_mesh(name);
+    if (!result->ogre_mesh_)
+        return nullptr;
+
+    for (uint i = 0; i < sub_mesh_count; i++)
+    {
+        auto sub = result->ogre_mesh_->createSubMesh();
+        sub->useSharedVertices = false;
+        sub->vertexData = new Ogre::VertexData();
+
+        Ogre::VertexDeclaration* decl = sub->vertexData->vertexDeclaration;
+        size_t offset = 0;
+        decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+        offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+        decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0);
+        offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
+        decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
+
+        sub->vertexData->vertexCount = 0;
+        sub->indexData->indexCount = 0;
+
+        result->sections_.add({List<Vertex>(), List<uint>(), 0, 0, Vector3::zero(), Vector3::zero()});
+        result->create_vertex_buffer(i, Math::max(vertex_capacity, 1u));
+        result->create_index_buffer(i, Math::max(index_capacity, 1u));
+    }
+
+    result->ogre_mesh_->_setBounds(Ogre::AxisAlignedBox(Ogre::Vector3::ZERO, Ogre::Vector3::ZERO));
+
+    return result;
+}
+
+void DynamicMesh::set_sub_mesh(uint sub_mesh, const List<Vertex>& vertices, const List<uint>& indices)
+{
+    if (!Check(sub_mesh < sections_.length(), "Dynamic Mesh", "Sub-mesh %i is out of range in mesh %s", sub_mesh, name_.c())) return;
+
+    auto& section = sections_[sub_mesh];
+    auto sub = ogre_mesh_->getSubMesh(sub_mesh);
+
+    bool full_vertex_upload = false;
+    bool full_index_upload = false;
+
+    if (vertices.length() > section.vertex_capacity)
+    {
+        const bool was_16bit = section.vertex_capacity <= 0x10000;
+        create_vertex_buffer(sub_mesh, grow(vertices.length()));
+        full_vertex_upload = true;
+
+        // indices have to be rewritten in wider type
+        if (was_16bit && section.vertex_capacity > 0x10000)
+        {
+            create_index_buffer(sub_mesh, Math::max(section.index_capacity, indices.length()));
+            full_index_upload = true;
+        }
+    }
+
+    if (indices.length() > section.index_capacity)
+    {
+        create_index_buffer(sub_mesh, grow(indices.length()));
+        full_index_upload = true;
+    }
+
+    uint first = 0;
+    uint count = 0;
+
+    if (full_vertex_upload)
+    {
+        section.vertices = vertices;
+        write_vertices(sub_mesh, 0, vertices.length());
+    }
+    else if (find_changed_range(section.vertices, vertices, first, count))
+    {
+        section.vertices = vertices;
+        write_vertices(sub_mesh, first, count);
+    }
+    else
+    {
+        section.vertices = vertices;
+    }
+
+    if (full_index_upload)
+    {
+        section.indices = indices;
+        write_indices(sub_mesh, 0, indices.length());
+    }
+    else if (find_changed_range(section.indices, indices, first, count))
+    {
+        section.indices = indices;
+        write_indices(sub_mesh, first, count);
+    }
+    else
+    {
+        section.indices = indices;
+    }
+
+    sub->vertexData->vertexCount = vertices.length();
+    sub->indexData->indexCount = indices.length();
+
+    update_bounds(sub_mesh);
+}
+
+void DynamicMesh::update_vertices(uint sub_mesh, uint first_vertex, const List<Vertex>& vertices)
+{
+    if (!Check(sub_mesh < sections_.length(), "Dynamic Mesh", "Sub-mesh %i is out of range in mesh %s", sub_mesh, name_.c())) return;
+
+    auto& section = sections_[sub_mesh];
+    if (!Check(first_vertex + vertices.length() <= section.vertices.length(), "Dynamic Mesh", "Vertex range is out of range in mesh %s", name_.c())) return;
+    if (vertices.length() == 0) return;
+
+    memcpy(section.vertices.get_data() + first_vertex, vertices.get_data(), sizeof(Vertex) * vertices.length());
+    write_vertices(sub_mesh, first_vertex, vertices.length());
+
+    update_bounds(sub_mesh);
+}
+
+void DynamicMesh::update_indices(uint sub_mesh, uint first_index, const List<uint>& indices)
+{
+    if (!Check(sub_mesh < sections_.length(), "Dynamic Mesh", "Sub-mesh %i is out of range in mesh %s", sub_mesh, name_.c())) return;
+
+    auto& section = sections_[sub_mesh];
+    if (!Check(first_index + indices.length() <= section.indices.length(), "Dynamic Mesh", "Index range is out of range in mesh %s", name_.c())) return;
+    if (indices.length() == 0) return;
+
+    memcpy(section.indices.get_data() + first_index, indices.get_data(), sizeof(uint) * indices.length());
+    write_indices(sub_mesh, first_index, indices.length());
+}
+
+const List<StaticMesh::Vertex>& DynamicMesh::get_vertices(uint sub_mesh) const
+{
+    return sections_[sub_mesh].vertices;
+}
+
+const List<uint>& DynamicMesh::get_indices(uint sub_mesh) const
+{
+    return sections_[sub_mesh].indices;
+}
+
+uint DynamicMesh::grow(uint required) const
+{
+    switch (growth_)
+    {
+    case DynamicMeshGrowth::Exact:
+        return required;
+    case DynamicMeshGrowth::Moderate:
+        return required + required / 2;
+    default:
+        return required * 2;
+    }
+}
+
+void DynamicMesh::create_vertex_buffer(uint sub_mesh, uint capacity)
+{
+    auto sub = ogre_mesh_->getSubMesh(sub_mesh);
+
+    // write only, cpu copy in section serves reads and diffs
+    Ogre::HardwareVertexBufferSharedPtr vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(sizeof(Vertex), capacity, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY);
+    sub->vertexData->vertexBufferBinding->setBinding(0, vbuf);
+
+    sections_[sub_mesh].vertex_capacity = capacity;
+}
+
+void DynamicMesh::create_index_buffer(uint sub_mesh, uint capacity)
+{
+    auto sub = ogre_mesh_->getSubMesh(sub_mesh);
+
+    const auto type = sections_[sub_mesh].vertex_capacity <= 0x10000 ? Ogre::HardwareIndexBuffer::IT_16BIT : Ogre::HardwareIndexBuffer::IT_32BIT;
+    sub->indexData->indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(type, capacity, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY);
+    sub->indexData->indexStart = 0;
+
+    sections_[sub_mesh].index_capacity = capacity;
+}
+
+void DynamicMesh::write_vertices(uint sub_mesh, uint first, uint count)
+{
+    if (count == 0) return;
+
+    const auto& section = sections_[sub_mesh];
+    auto vbuf = ogre_mesh_->getSubMesh(sub_mesh)->vertexData->vertexBufferBinding->getBuffer(0);
+
+    // discarding lets driver hand out fresh memory instead of waiting for gpu to finish with old one
+    const bool whole = first == 0 && count == section.vertices.length();
+    vbuf->writeData(sizeof(Vertex) * first, sizeof(Vertex) * count, section.vertices.get_data() + first, whole);
+
+    uploaded_bytes_ += sizeof(Vertex) * count;
+}
+
+void DynamicMesh::write_indices(uint sub_mesh, uint first, uint count)
+{
+    if (count == 0) return;
+
+    const auto& section = sections_[sub_mesh];
+    auto ibuf = ogre_mesh_->getSubMesh(sub_mesh)->indexData->indexBuffer;
+    const bool whole = first == 0 && count == section.indices.length();
+
+    if (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_16BIT)
+    {
+        List<byte16> short_indices(count);
+        for (uint i = 0; i < count; i++)
+        {
+            short_indices[i] = static_cast<byte16>(section.indices[first + i]);
+        }
+
+        ibuf->writeData(sizeof(byte16) * first, sizeof(byte16) * count, short_indices.get_data(), whole);
+        uploaded_bytes_ += sizeof(byte16) * count;
+    }
+    else
+    {
+        ibuf->writeData(sizeof(uint) * first, sizeof(uint) * count, section.indices.get_data() + first, whole);
+        uploaded_bytes_ += sizeof(uint) * count;
+    }
+}
+
+void DynamicMesh::update_bounds(uint sub_mesh)
+{
+    auto& section = sections_[sub_mesh];
+
+    if (section.vertices.length() > 0)
+    {
+        section.bounds_min = section.vertices[0].pos;
+        section.bounds_max = section.vertices[0].pos;
+        for (const auto& vertex : section.vertices)
+        {
+            section.bounds_min = Vector3(Math::min(section.bounds_min.x, vertex.pos.x), Math::min(section.bounds_min.y, vertex.pos.y), Math::min(section.bounds_min.z, vertex.pos.z));
+            section.bounds_max = Vector3(Math::max(section.bounds_max.x, vertex.pos.x), Math::max(section.bounds_max.y, vertex.pos.y), Math::max(section.bounds_max.z, vertex.pos.z));
+        }
+    }
+    else
+    {
+        section.bounds_min = Vector3::zero();
+        section.bounds_max = Vector3::zero();
+    }
+
+    Ogre::AxisAlignedBox bounds;
+    for (const auto& other : sections_)
+    {
+        if (other.vertices.length() == 0) continue;
+        bounds.merge(Ogre::AxisAlignedBox(cast_object<Ogre::Vector3>(other.bounds_min), cast_object<Ogre::Vector3>(other.bounds_max)));
+    }
+
+    if (bounds.isNull())
+    {
+        bounds = Ogre::AxisAlignedBox(Ogre::Vector3::ZERO, Ogre::Vector3::ZERO);
+    }
+
+    ogre_mesh_->_setBounds(bounds);
+    ogre_mesh_->_setBoundingSphereRadius(bounds.getHalfSize().length());
+}
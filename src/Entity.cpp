@@ -58,7 +58,7 @@ void Entity::set_transform(const Transform& transform)
 void Entity::set_location(const Vector3& location)
 {
     transform_.location = location;
-    if (scene_node_)
+    if (scene_node_ && !defer_scene_node_update())
     {
         scene_node_->setPosition(cast_object<Ogre::Vector3>(location));
     }
@@ -72,7 +72,7 @@ void Entity::translate(const Vector3& translation)
 void Entity::set_rotation(const Quaternion& rot)
 {
     transform_.rotation = rot;
-    if (scene_node_)
+    if (scene_node_ && !defer_scene_node_update())
     {
         scene_node_->setOrientation(Ogre::Quaternion(rot.w, rot.x, rot.y, rot.z));
     }
@@ -86,12 +86,26 @@ void Entity::rotate(const Vector3& axis, float angle)
 void Entity::set_scale(const Vector3& scale)
 {
     transform_.scale = scale;
-    if (scene_node_)
+    if (scene_node_ && !defer_scene_node_update())
     {
         scene_node_->setScale(cast_object<Ogre::Vector3>(scale));
     }
 }
 
+bool Entity::defer_scene_node_update()
+{
+    if (const auto world = get_world())
+    {
+        if (world->is_simulating())
+        {
+            world->mark_render_dirty(shared_from_this());
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void Entity::set_collision(const Shared<Collision>& collision, const Vector3& offset)
 {
     /*remove_collision();
@@ -0,0 +1,113 @@
+#include "hexa_engine/FrameClock.h"
+
+#include <base_lib/Math.h>
+#include <thread>
+
+// initial guess of sleep overshoot, adapts to actual timer resolution after few frames
+const static double default_sleep_overshoot = 0.002;
+// limits of overshoot estimate, upper one is coarse windows timer with some margin
+const static double min_sleep_overshoot = 0.0002;
+const static double max_sleep_overshoot = 0.02;
+// how fast old overshoot measurements are forgotten
+const static double sleep_overshoot_decay = 0.98;
+
+FrameClock::FrameClock()
+    : start_(Clock::now())
+    , frame_start_(start_)
+    , next_frame_(start_)
+    , sleep_overshoot_(default_sleep_overshoot)
+    , report_start_(start_)
+{
+}
+
+double FrameClock::tick(double min_frame_time)
+{
+    if (min_frame_time > 0.0)
+    {
+        const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(min_frame_time));
+
+        // fixed cadence, so that one late frame doesn't shift all following ones
+        next_frame_ += interval;
+        if (Clock::now() > next_frame_ + interval)
+        {
+            // too far behind, catching up would cause burst of short frames
+            next_frame_ = Clock::now();
+        }
+
+        wait_until(next_frame_);
+    }
+
+    const auto now = Clock::now();
+    delta_ = std::chrono::duration<double>(now - frame_start_).count();
+    frame_start_ = now;
+    if (min_frame_time <= 0.0)
+    {
+        next_frame_ = now;
+    }
+
+    frame_count_++;
+
+    if (report_frames_ == 0)
+    {
+        report_min_ = delta_;
+        report_max_ = delta_;
+    }
+    else
+    {
+        report_min_ = Math::min(report_min_, delta_);
+        report_max_ = Math::max(report_max_, delta_);
+    }
+    report_frames_++;
+    report_sum_ += delta_;
+    report_sum_squared_ += delta_ * delta_;
+
+    return delta_;
+}
+
+double FrameClock::get_elapsed() const
+{
+    return std::chrono::duration<double>(Clock::now() - start_).count();
+}
+
+bool FrameClock::take_report(double interval, Report& out_report)
+{
+    const auto now = Clock::now();
+    if (report_frames_ == 0 || std::chrono::duration<double>(now - report_start_).count() < interval) return false;
+
+    const double average = report_sum_ / report_frames_;
+    out_report.frames = report_frames_;
+    out_report.average = average;
+    out_report.deviation = Math::sqrt(Math::max(report_sum_squared_ / report_frames_ - average * average, 0.0));
+    out_report.min = report_min_;
+    out_report.max = report_max_;
+
+    report_start_ = now;
+    report_frames_ = 0;
+    report_sum_ = 0.0;
+    report_sum_squared_ = 0.0;
+
+    return true;
+}
+
+void FrameClock::wait_until(Clock::time_point target)
+{
+    // sleep while os timer can't overshoot the target
+    auto remaining = std::chrono::duration<double>(target - Clock::now()).count();
+    while (remaining > sleep_overshoot_)
+    {
+        const double requested = remaining - sleep_overshoot_;
+        const auto sleep_start = Clock::now();
+        std::this_thread::sleep_for(std::chrono::duration<double>(requested));
+        const double slept = std::chrono::duration<double>(Clock::now() - sleep_start).count();
+
+        sleep_overshoot_ = Math::clamp(Math::max(sleep_overshoot_ * sleep_overshoot_decay, slept - requested), min_sleep_overshoot, max_sleep_overshoot);
+
+        remaining = std::chrono::duration<double>(target - Clock::now()).count();
+    }
+
+    // spin the rest
+    while (Clock::now() < target)
+    {
+        std::this_thread::yield();
+    }
+}
@@ -2,15 +2,19 @@
 
 #include "hexa_engine/AudioChannel.h"
 #include "hexa_engine/CameraComponent.h"
+#include "hexa_engine/FrameClock.h"
 #include "hexa_engine/Material.h"
 #include "hexa_engine/Mod.h"
 #include "hexa_engine/OgreApp.h"
 #include "hexa_engine/SaveGame.h"
 #include "hexa_engine/Settings.h"
+#include "hexa_engine/ShaderCache.h"
 #include "hexa_engine/StaticMesh.h"
 #include "hexa_engine/TableBase.h"
 #include "hexa_engine/Texture.h"
 #include "hexa_engine/World.h"
+#include "hexa_engine/tools/BenchTransform.h"
+#include "hexa_engine/tools/CheckVertexCache.h"
 #include "hexa_engine/tools/Comp.h"
 #include "hexa_engine/tools/Help.h"
 #include "hexa_engine/tools/ITool.h"
@@ -20,16 +24,25 @@
 #include <OgreEntity.h>
 #include <OgreRenderWindow.h>
 #include <RTShaderSystem/OgreShaderGenerator.h>
+#include <base_lib/Assert.h>
 #include <base_lib/File.h>
 #include <base_lib/Logger.h>
 #include <base_lib/Path.h>
 #include <base_lib/Set.h>
 #include <base_lib/performance.h>
+#include <charconv>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <hexa_engine/Audio.h>
 #include <hexa_engine/IControllable.h>
 #include <reactphysics3d/reactphysics3d.h>
 #include <soloud/soloud.h>
 
+// how often frame time or simulation throughput is reported
+const static double frame_report_interval = 5.0;
+
 Game::Game(const String& name, int argc, char* argv[])
     : Module(Name(name))
 {
@@ -82,12 +95,56 @@ void Game::launch()
 
     verbose("Game", "Launching...");
 
-    ogre_app_->initApp();
+    for (uint i = 1; i < args_.length(); i++)
+    {
+        if (args_[i] == "--headless")
+        {
+            headless_ = true;
+        }
+        else if (args_[i] == "--unthrottled")
+        {
+            headless_unthrottled_ = true;
+        }
+        else if (args_[i] == "--ticks" && i + 1 < args_.length())
+        {
+            const auto& value = args_[++i];
+            const auto result = std::from_chars(value.c(), value.c() + value.length(), headless_tick_limit_);
+            if (result.ec != std::errc() || result.ptr != value.c() + value.length())
+            {
+                print_error("Game", "Invalid tick count %s, expected non-negative number", value.c());
+                headless_tick_limit_ = 0;
+            }
+        }
+        else if (args_[i] == "--pipelined")
+        {
+            pipelined_ = true;
+        }
+    }
+
+    if (headless_)
+    {
+        ogre_app_->init_headless();
+    }
+    else
+    {
+        ogre_app_->initApp();
+    }
 
     initialization_stage();
     loading_stage();
     start();
-    render_loop();
+    if (headless_)
+    {
+        simulation_loop();
+    }
+    else if (pipelined_)
+    {
+        pipelined_render_loop();
+    }
+    else
+    {
+        render_loop();
+    }
     unloading_stage();
 
     stage_ = GameStage::Unloaded;
@@ -110,23 +167,43 @@ void Game::possess(const Shared<IControllable>& controllable)
 void Game::use_camera(const Shared<CameraComponent>& camera)
 {
     instance_->current_camera_ = camera;
-    if (instance_->viewport_)
+    if (instance_->headless_)
     {
-        instance_->viewport_->setCamera(camera->ogre_camera_);
+        // camera still serves as activation source and culling origin
+        return;
     }
-    else
+
+    const auto apply = [camera]()
     {
-        instance_->viewport_ = instance_->ogre_app_->getRenderWindow()->addViewport(camera->ogre_camera_);
-        // Ogre::CompositorManager::getSingleton().addCompositor(instance_->viewport_,
-        // "Hexa/Flip_X_comp");
-        // Ogre::CompositorManager::getSingleton().setCompositorEnabled(instance_->viewport_,
-        // "Hexa/Flip_X_comp", true);
+        if (instance_->viewport_)
+        {
+            instance_->viewport_->setCamera(camera->ogre_camera_);
+        }
+        else
+        {
+            instance_->viewport_ = instance_->ogre_app_->getRenderWindow()->addViewport(camera->ogre_camera_);
+            // Ogre::CompositorManager::getSingleton().addCompositor(instance_->viewport_,
+            // "Hexa/Flip_X_comp");
+            // Ogre::CompositorManager::getSingleton().setCompositorEnabled(instance_->viewport_,
+            // "Hexa/Flip_X_comp", true);
 
-        Ogre::CompositorManager::getSingleton().addCompositor(instance_->viewport_, "DeferredShading/GBuffer");
-        Ogre::CompositorManager::getSingleton().setCompositorEnabled(instance_->viewport_, "DeferredShading/GBuffer", true);
+            Ogre::CompositorManager::getSingleton().addCompositor(instance_->viewport_, "DeferredShading/GBuffer");
+            Ogre::CompositorManager::getSingleton().setCompositorEnabled(instance_->viewport_, "DeferredShading/GBuffer", true);
 
-        Ogre::CompositorManager::getSingleton().addCompositor(instance_->viewport_, "DeferredShading/ShowLit");
-        Ogre::CompositorManager::getSingleton().setCompositorEnabled(instance_->viewport_, "DeferredShading/ShowLit", true);
+            Ogre::CompositorManager::getSingleton().addCompositor(instance_->viewport_, "DeferredShading/ShowLit");
+            Ogre::CompositorManager::getSingleton().setCompositorEnabled(instance_->viewport_, "DeferredShading/ShowLit", true);
+        }
+    };
+
+    // ogre camera of component spawned during pipelined tick does not exist yet, it is created by earlier render command
+    const auto owner = camera->get_owner();
+    if (const auto world = owner ? owner->get_world() : nullptr)
+    {
+        world->run_render_command(apply);
+    }
+    else
+    {
+        apply();
     }
 }
 
@@ -138,8 +215,11 @@ void Game::open_world(const Shared<World>& world)
     if (instance_->world_)
     {
         instance_->world_->init();
-        instance_->shader_generator_->addSceneManager(instance_->world_->manager_);
-        instance_->world_->manager_->addRenderQueueListener(&Ogre::OverlaySystem::getSingleton());
+        if (!instance_->headless_)
+        {
+            instance_->shader_generator_->addSceneManager(instance_->world_->manager_);
+            instance_->world_->manager_->addRenderQueueListener(&Ogre::OverlaySystem::getSingleton());
+        }
         instance_->world_->start();
         instance_->event_bus_->world_opened(world);
     }
@@ -155,8 +235,11 @@ void Game::close_world()
     {
         instance_->current_camera_ = nullptr;
 
-        instance_->world_->manager_->removeRenderQueueListener(&Ogre::OverlaySystem::getSingleton());
-        instance_->shader_generator_->removeSceneManager(instance_->world_->manager_);
+        if (!instance_->headless_)
+        {
+            instance_->world_->manager_->removeRenderQueueListener(&Ogre::OverlaySystem::getSingleton());
+            instance_->shader_generator_->removeSceneManager(instance_->world_->manager_);
+        }
         instance_->world_->close();
         instance_->event_bus_->world_closed(instance_->world_);
         instance_->world_ = nullptr;
@@ -198,11 +281,9 @@ const Shared<EventBus>& Game::get_event_bus()
     return instance_->event_bus_;
 }
 
-void Game::call_on_main_thread(std::function<void()> func)
+void Game::set_main_thread_budget(double seconds)
 {
-    instance_->main_thread_calls_mutex_.lock();
-    instance_->main_thread_calls_.add(func);
-    instance_->main_thread_calls_mutex_.unlock();
+    instance_->main_thread_budget_ = Math::max(seconds, 0.0);
 }
 
 Shared<Material> Game::get_basic_material()
@@ -264,6 +345,8 @@ const Vector2& Game::get_mouse_delta()
 
 void Game::set_mouse_grab(bool state)
 {
+    if (instance_->headless_) return;
+
     instance_->ogre_app_->setWindowGrab(state);
 }
 
@@ -274,11 +357,12 @@ void Game::set_cursor_texture(const Shared<Texture>& tex, uint hotspot_x, uint h
     Array2D<Color> cursor_pixels =
         Array2D<Color>(tex->get_width() * scale, tex->get_height() * scale);
 
+    const auto source = tex->lock_region({0, 0, tex->get_width(), tex->get_height()}, TextureLock::Read);
     for (uint x = 0; x < cursor_pixels.get_size_x(); x++)
     {
         for (uint y = 0; y < cursor_pixels.get_size_y(); y++)
         {
-            cursor_pixels.at(x, y) = tex->get_pixel(x / scale, y / scale);
+            cursor_pixels.at(x, y) = source.at(x / scale, y / scale);
         }
     }
 
@@ -306,16 +390,44 @@ Vector3 Game::get_un_projected_mouse()
     return instance_->un_projected_mouse_;
 }
 
-float Game::get_time()
+double Game::get_time()
 {
     return instance_->time_;
 }
 
+double Game::get_delta_time()
+{
+    return instance_->frame_clock_.get_delta();
+}
+
+std::uint64_t Game::get_frame_count()
+{
+    return instance_->frame_clock_.get_frame_count();
+}
+
 GameStage Game::get_stage()
 {
     return instance_->stage_;
 }
 
+bool Game::is_headless()
+{
+    return instance_->headless_;
+}
+
+bool Game::is_pipelined_rendering()
+{
+    return instance_->pipelined_;
+}
+
+void Game::set_pipelined_rendering(bool state)
+{
+    if (!Check(instance_->stage_ != GameStage::RenderLoop, "Game", "Pipelined rendering can't be switched inside render loop"))
+        return;
+
+    instance_->pipelined_ = state;
+}
+
 void Game::on_add_resource_directories(Set<String>& local,
                                        Set<String>& global)
 {
@@ -380,11 +492,13 @@ bool Game::handle_tool()
     if (tools_.size() == 0) {
         register_tool(MakeShared<Tools::Help>());
         register_tool(MakeShared<Tools::Comp>());
+        register_tool(MakeShared<Tools::BenchTransform>());
+        register_tool(MakeShared<Tools::CheckVertexCache>());
     }
     
     const List<String>& args = get_args();
 
-    if (args.length() >= 2 && args[1] == "comp")
+    if (args.length() >= 2)
     {
         const Name tool_name = Name(args[1]);
 
@@ -418,7 +532,15 @@ void Game::initialization_stage()
     settings_->read_settings(settings_json);
     Compound::Convert::save_to_file(settings_path, true, settings_->write_settings());
 
-    soloud_->init();
+    if (headless_)
+    {
+        // sounds are still played and tracked, just not heard
+        soloud_->init(SoLoud::Soloud::CLIP_ROUNDOFF, SoLoud::Soloud::NULLDRIVER);
+    }
+    else
+    {
+        soloud_->init();
+    }
 
     on_init();
 
@@ -463,6 +585,58 @@ void Game::loading_stage()
 
     register_resource_directories();
 
+    for (const auto& mod : mods_)
+    {
+        mod->register_resource_directories();
+    }
+
+    // textures, materials and ui need render system
+    if (!headless_)
+    {
+        load_render_resources();
+    }
+
+    // Audio channels
+    general_channel_ = AudioChannel::create();
+    general_channel_->set_volume(settings_->audio_general);
+
+    on_loading_stage();
+
+    // Call loading stage in mods
+    for (auto& mod : mods_)
+    {
+        try
+        {
+            mod->on_loading_stage();
+            verbose("Mod Loader", "Loaded mod %s", mod->info_.name.c());
+        }
+        catch (std::runtime_error err)
+        {
+            print_error("Mod Loader", "Failed to load mod %s: %s",
+                        mod->info_.name.c(), err.what());
+            return;
+        }
+    }
+
+    for (const auto& table_entry : tables_)
+    {
+        table_entry.value->post_load();
+    }
+
+    for (const auto& table_entry : tables_)
+    {
+        table_entry.value->init_assets();
+    }
+
+    if (!headless_)
+    {
+        ShaderCache::save();
+        ShaderCache::report();
+    }
+}
+
+void Game::load_render_resources()
+{
     // Engine/White texture
     {
         Array2D<Color> white(1, 1);
@@ -512,11 +686,6 @@ void Game::loading_stage()
         uv_test_texture_ = create_texture(uv_test, Name("uv_test"));
     }
 
-    for (const auto& mod : mods_)
-    {
-        mod->register_resource_directories();
-    }
-
     Ogre::ResourceGroupManager::getSingletonPtr()->initialiseResourceGroup(get_module_name().c());
     for (const auto& mod : mods_)
     {
@@ -526,43 +695,19 @@ void Game::loading_stage()
         }
     }
 
+    // program variants used in previous launches are compiled up front, others when first material needs them
+    ShaderCache::load(Path("cache"));
+    warm_shader_programs();
+    for (const auto& mod : mods_)
+    {
+        mod->warm_shader_programs();
+    }
+
     ogre_app_->load();
 
     // Fonts
     // TODO: Remove our fonts
     //default_font_ = SpriteFont::load_fnt(RESOURCES_FONTS + "arial.fnt");
-
-    // Audio channels
-    general_channel_ = AudioChannel::create();
-    general_channel_->set_volume(settings_->audio_general);
-
-    on_loading_stage();
-
-    // Call loading stage in mods
-    for (auto& mod : mods_)
-    {
-        try
-        {
-            mod->on_loading_stage();
-            verbose("Mod Loader", "Loaded mod %s", mod->info_.name.c());
-        }
-        catch (std::runtime_error err)
-        {
-            print_error("Mod Loader", "Failed to load mod %s: %s",
-                        mod->info_.name.c(), err.what());
-            return;
-        }
-    }
-
-    for (const auto& table_entry : tables_)
-    {
-        table_entry.value->post_load();
-    }
-
-    for (const auto& table_entry : tables_)
-    {
-        table_entry.value->init_assets();
-    }
 }
 
 void Game::start()
@@ -592,78 +737,234 @@ void Game::start()
     on_start();
 }
 
+double Game::begin_frame()
+{
+    const double tick_time = frame_clock_.tick(settings_->fps_limit > 0 ? 1.0 / settings_->fps_limit : 0.0);
+
+    time_ += tick_time;
+
+    run_main_thread_calls();
+
+    FrameClock::Report report;
+    if (frame_clock_.take_report(frame_report_interval, report))
+    {
+        verbose("Game", "%.1f fps, frame time %.2f ms, jitter %.2f ms, range %.2f - %.2f ms", 1.0 / report.average, report.average * 1000.0, report.deviation * 1000.0, report.min * 1000.0, report.max * 1000.0);
+    }
+
+    return tick_time;
+}
+
 void Game::render_loop()
 {
     verbose("Game", "Entering render loop...");
     stage_ = GameStage::RenderLoop;
 
-    /*float fps_delta_time_stack = 0;
-    uint fps_count = 0;
-    uint fps_last_count = 0;*/
-
     /*auto fps_display = MakeShared<TextBlock>();
     fps_display->set_z(10);
     add_ui(fps_display);*/
 
-    const auto start_time = std::chrono::system_clock::now();
-
-    auto tick_start = start_time;
+    frame_clock_ = FrameClock();
 
     while (!ogre_app_->getRoot()->endRenderingQueued())
     {
-        // while
-        // (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()
-        // - tick_start).count() / 1000.0f < 1.0f / settings_->fps_limit);
-        const float tick_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - tick_start).count() / 1000.0f;
-        tick_start = std::chrono::system_clock::now();
+        const double tick_time = begin_frame();
 
-        time_ += tick_time;
-
-        main_thread_calls_mutex_.lock();
-        for (auto& func : main_thread_calls_)
+        if (world_)
         {
-            func();
+            // ticking
+            if (tick_time > 0.0)
+            {
+                on_tick(static_cast<float>(tick_time));
+                world_->tick(static_cast<float>(tick_time));
+            }
+
+            if (current_camera_)
+            {
+                update_sound_listener();
+
+                mouse_delta_ = Vector2::zero();
+                ogre_app_->getRoot()->renderOneFrame();
+            }
         }
-        main_thread_calls_.clear();
-        main_thread_calls_mutex_.unlock();
+    }
+
+    close_world();
+}
+
+void Game::pipelined_render_loop()
+{
+    verbose("Game", "Entering pipelined render loop...");
+    stage_ = GameStage::RenderLoop;
 
-        /*fps_delta_time_stack += tick_time;
-        fps_count++;
-        if (fps_delta_time_stack >= 1)
+    // tick gets own thread, shared pool may be busy with loading and would hold the frame back
+    std::mutex tick_mutex;
+    std::condition_variable tick_condition;
+    Shared<World> ticked_world;
+    float tick_delta = 0.0f;
+    bool stopping = false;
+    // exception must not leave thread, it is rethrown on main thread same as in render_loop
+    std::exception_ptr tick_error;
+
+    std::thread simulation_thread([&]()
+    {
+        std::unique_lock lock(tick_mutex);
+        while (true)
         {
-            fps_delta_time_stack -= 1;
-            fps_last_count = fps_count;
-            fps_count = 0;
+            tick_condition.wait(lock, [&]() { return ticked_world || stopping; });
+            if (!ticked_world) return;
+
+            lock.unlock();
+            std::exception_ptr error;
+            try
+            {
+                on_tick(tick_delta);
+                ticked_world->tick(tick_delta);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            tick_error = error;
+            ticked_world = nullptr;
+            tick_condition.notify_all();
         }
+    });
 
-        fps_display->set_text(String::format("FPS: %i", fps_last_count));*/
+    frame_clock_ = FrameClock();
+
+    while (!ogre_app_->getRoot()->endRenderingQueued())
+    {
+        const double tick_time = begin_frame();
 
         if (world_)
         {
-            // ticking
-            if (tick_time > 0.0f)
+            // input polled while previous tick ran, next tick sees it
+            auto input = std::move(deferred_input_);
+            deferred_input_.clear();
+            for (auto& event : input)
             {
-                on_tick(tick_time);
-                world_->tick(tick_time);
+                event();
             }
 
+            // publish previous tick, this frame renders it
+            const auto world = world_;
+            world->apply_render_state();
+
             if (current_camera_)
             {
-                const auto cam_from = current_camera_->get_owner()->get_location();
-                const auto cam_to = current_camera_->get_owner()->get_location() + current_camera_->get_owner()->get_rotation().forward();
+                update_sound_listener();
+            }
 
-                soloud_->set3dListenerPosition(cam_from.x, cam_from.y, cam_from.z);
-                soloud_->set3dListenerAt(cam_to.x, cam_to.y, cam_to.z);
+            // next tick runs next to rendering, scene graph is not touched until it is published
+            if (tick_time > 0.0)
+            {
+                world->simulating_ = true;
+                {
+                    std::lock_guard lock(tick_mutex);
+                    ticked_world = world;
+                    tick_delta = static_cast<float>(tick_time);
+                }
+                tick_condition.notify_all();
+            }
 
-                mouse_delta_ = Vector2::zero();
+            if (current_camera_)
+            {
                 ogre_app_->getRoot()->renderOneFrame();
             }
+
+            if (world->simulating_)
+            {
+                std::unique_lock lock(tick_mutex);
+                tick_condition.wait(lock, [&]() { return !ticked_world; });
+                world->simulating_ = false;
+                mouse_delta_ = Vector2::zero();
+
+                if (tick_error) break;
+            }
+        }
+    }
+
+    {
+        std::lock_guard lock(tick_mutex);
+        stopping = true;
+    }
+    tick_condition.notify_all();
+    simulation_thread.join();
+
+    deferred_input_.clear();
+
+    if (tick_error)
+    {
+        print_error("Game", "Tick failed on simulation thread");
+        std::rethrow_exception(tick_error);
+    }
+
+    close_world();
+}
+
+void Game::simulation_loop()
+{
+    verbose("Game", "Entering headless simulation loop...");
+    stage_ = GameStage::RenderLoop;
+
+    // same step as physics, so every tick advances physics exactly once
+    const float tick_time = settings_->get_physics_tick_interval();
+
+    frame_clock_ = FrameClock();
+
+    while (!ogre_app_->getRoot()->endRenderingQueued() && (headless_tick_limit_ == 0 || frame_clock_.get_frame_count() < headless_tick_limit_))
+    {
+        frame_clock_.tick(headless_unthrottled_ ? 0.0 : tick_time);
+
+        time_ += tick_time;
+
+        run_main_thread_calls();
+
+        if (world_)
+        {
+            on_tick(tick_time);
+            world_->tick(tick_time);
+        }
+
+        FrameClock::Report report;
+        if (frame_clock_.take_report(frame_report_interval, report))
+        {
+            verbose("Game", "Simulated %u ticks: %.1f ticks/s, %.2fx real time, tick time %.3f ms, jitter %.3f ms", report.frames, 1.0 / report.average, tick_time / report.average, report.average * 1000.0, report.deviation * 1000.0);
         }
     }
 
+    const double total_seconds = Math::max(frame_clock_.get_elapsed(), static_cast<double>(KINDA_SMALL_NUMBER));
+    const auto tick_count = frame_clock_.get_frame_count();
+    verbose("Game", "Simulation finished after %llu ticks in %.2fs: %.1f ticks/s, %.2fx real time", static_cast<unsigned long long>(tick_count), total_seconds, tick_count / total_seconds, tick_count * tick_time / total_seconds);
+
     close_world();
 }
 
+void Game::run_main_thread_calls()
+{
+    main_thread_queue_.run(main_thread_budget_);
+}
+
+void Game::update_sound_listener()
+{
+    const auto cam_from = current_camera_->get_owner()->get_location();
+    const auto cam_to = current_camera_->get_owner()->get_location() + current_camera_->get_owner()->get_rotation().forward();
+
+    soloud_->set3dListenerPosition(cam_from.x, cam_from.y, cam_from.z);
+    soloud_->set3dListenerAt(cam_to.x, cam_to.y, cam_to.z);
+}
+
+bool Game::defer_input(MainThreadTask&& event)
+{
+    if (!world_ || !world_->is_simulating())
+        return false;
+
+    deferred_input_.push_back(std::move(event));
+    return true;
+}
+
 void Game::unloading_stage()
 {
     verbose("Game", "Unloading stage...");
@@ -676,6 +977,12 @@ void Game::unloading_stage()
 
     on_unloading_stage();
 
+    // programs compiled lazily after loading stage
+    if (!headless_)
+    {
+        ShaderCache::save();
+    }
+
     meshes_.clear();
 
     soloud_->stopAll();
@@ -755,6 +1062,9 @@ void Game::load_tables(const Path& path)
 
 bool Game::keyPressed(KeyCode key, bool repeat)
 {
+    if (instance_ && instance_->defer_input([key, repeat]() { instance_->keyPressed(key, repeat); }))
+        return true;
+
     if (instance_)
     {
         if (repeat)
@@ -786,6 +1096,9 @@ bool Game::keyPressed(KeyCode key, bool repeat)
 
 bool Game::keyReleased(KeyCode key)
 {
+    if (instance_ && instance_->defer_input([key]() { instance_->keyReleased(key); }))
+        return true;
+
     if (instance_)
     {
         /*if (instance_->ui_input_element_)
@@ -813,6 +1126,9 @@ bool Game::textInput(const char* chars)
 
 bool Game::mousePressed(int button)
 {
+    if (instance_ && instance_->defer_input([button]() { instance_->mousePressed(button); }))
+        return true;
+
     if (instance_ && instance_->current_controllable_)
     {
         /*if (auto ui_under_mouse = instance_->ui_under_mouse_.lock())
@@ -853,6 +1169,9 @@ bool Game::mousePressed(int button)
 
 bool Game::mouseReleased(int button)
 {
+    if (instance_->defer_input([button]() { instance_->mouseReleased(button); }))
+        return true;
+
     if (instance_->current_controllable_)
     {
         /*if (auto released_ui = instance_->pressed_ui_.lock())
@@ -877,6 +1196,9 @@ bool Game::axisMoved(int axis, float value)
 
 bool Game::mouseMoved(const Vector2& new_pos, const Vector2& delta)
 {
+    if (instance_->defer_input([new_pos, delta]() { instance_->mouseMoved(new_pos, delta); }))
+        return true;
+
     instance_->mouse_pos_ = new_pos;
 
     mouse_delta_ += delta;
@@ -908,6 +1230,9 @@ bool Game::mouseMoved(const Vector2& new_pos, const Vector2& delta)
 
 bool Game::wheelRolled(float y)
 {
+    if (instance_->defer_input([y]() { instance_->wheelRolled(y); }))
+        return true;
+
     if (/*instance_->ui_input_element_ == nullptr && */instance_->current_controllable_)
     {
         instance_->current_controllable_->scroll(y);
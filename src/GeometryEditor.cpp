@@ -1,45 +1,141 @@
 ﻿#include "hexa_engine/GeometryEditor.h"
 
+#include "hexa_engine/ThreadPool.h"
+
 #include <base_lib/Map.h>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 
 Vector3 GeometryEditor::compute_normal(const Vector3& a, const Vector3& b, const Vector3& c) {
     return (c - a).cross_product(b - a).normalized();
 }
 
-void GeometryEditor::optimize(List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
-    for (uint i = 0; i < vertices.length() - 1; i++) {
-        for (uint j = i + 1; j < vertices.length(); j++) {
-            if (vertices[i].pos == vertices[j].pos && vertices[i].uv == vertices[j].uv && vertices[i].norm == vertices[j].norm) {
-                for (uint k = 0; k < indices.length(); k++) {
-                    if (indices[k] == j) {
-                        indices[k] = i;
-                    } else if (indices[k] > j) {
-                        indices[k]--;
-                    }
-                }
+void GeometryEditor::optimize(List<StaticMesh::Vertex>& vertices, List<uint>& indices, float epsilon) {
+    List<uint> remap;
+    const uint vertex_count = generate_vertex_remap(vertices, remap, false, epsilon);
+    apply_vertex_remap(vertices, indices, remap, vertex_count);
+}
 
-                vertices.remove_at(j--);
-            }
-        }
+void GeometryEditor::optimize_collision(List<StaticMesh::Vertex>& vertices, List<uint>& indices, float epsilon) {
+    List<uint> remap;
+    const uint vertex_count = generate_vertex_remap(vertices, remap, true, epsilon);
+    apply_vertex_remap(vertices, indices, remap, vertex_count);
+}
+
+// cell of spatial hash, holds float bits when welding is exact or quantized coordinates otherwise
+struct WeldCell {
+    int32 x;
+    int32 y;
+    int32 z;
+
+    bool operator==(const WeldCell& rhs) const = default;
+};
+
+struct WeldCellHash {
+    size_t operator()(const WeldCell& cell) const {
+        size_t hash = static_cast<uint>(cell.x) * 73856093u;
+        hash ^= static_cast<uint>(cell.y) * 19349663u;
+        hash ^= static_cast<uint>(cell.z) * 83492791u;
+        return hash;
+    }
+};
+
+FORCEINLINE int32 weld_cell_coord(float value, float epsilon) {
+    if (epsilon > 0.0f) {
+        // keep one cell of room on each side for neighbour lookups
+        const float limit = static_cast<float>(std::numeric_limits<int32>::max() - 1);
+        return static_cast<int32>(Math::clamp(std::floor(value / epsilon), -limit, limit));
     }
+
+    // + 0.0f turns -0.0f into 0.0f, so they hash the same as they compare
+    return std::bit_cast<int32>(value + 0.0f);
 }
 
-void GeometryEditor::optimize_collision(List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
-    for (uint i = 0; i < vertices.length() - 1; i++) {
-        for (uint j = i + 1; j < vertices.length(); j++) {
-            if (vertices[i].pos == vertices[j].pos) {
-                for (uint k = 0; k < indices.length(); k++) {
-                    if (indices[k] == j) {
-                        indices[k] = i;
-                    } else if (indices[k] > j) {
-                        indices[k]--;
+FORCEINLINE bool nearly_equal(float a, float b, float epsilon) {
+    return epsilon > 0.0f ? std::abs(a - b) <= epsilon : a == b;
+}
+
+FORCEINLINE bool vertices_match(const StaticMesh::Vertex& a, const StaticMesh::Vertex& b, bool positions_only, float epsilon) {
+    if (!nearly_equal(a.pos.x, b.pos.x, epsilon) || !nearly_equal(a.pos.y, b.pos.y, epsilon) || !nearly_equal(a.pos.z, b.pos.z, epsilon)) return false;
+    if (positions_only) return true;
+
+    return nearly_equal(a.uv.x, b.uv.x, epsilon) && nearly_equal(a.uv.y, b.uv.y, epsilon) &&
+           nearly_equal(a.norm.x, b.norm.x, epsilon) && nearly_equal(a.norm.y, b.norm.y, epsilon) && nearly_equal(a.norm.z, b.norm.z, epsilon);
+}
+
+uint GeometryEditor::generate_vertex_remap(const List<StaticMesh::Vertex>& vertices, List<uint>& out_remap, bool positions_only, float epsilon) {
+    out_remap = List<uint>(vertices.length());
+
+    // each cell points to the last unique vertex which falls in it, unique vertices of one cell are chained
+    std::unordered_map<WeldCell, uint, WeldCellHash> cells;
+    cells.reserve(vertices.length());
+    List<uint> chain(vertices.length());
+
+    // with tolerance, matching vertex may lie in any neighbour cell
+    const int32 range = epsilon > 0.0f ? 1 : 0;
+
+    uint vertex_count = 0;
+    for (uint i = 0; i < vertices.length(); i++) {
+        const auto& vertex = vertices[i];
+        const WeldCell cell = {weld_cell_coord(vertex.pos.x, epsilon), weld_cell_coord(vertex.pos.y, epsilon), weld_cell_coord(vertex.pos.z, epsilon)};
+
+        uint match = removed_vertex;
+        for (int32 dx = -range; dx <= range && match == removed_vertex; dx++) {
+            for (int32 dy = -range; dy <= range && match == removed_vertex; dy++) {
+                for (int32 dz = -range; dz <= range && match == removed_vertex; dz++) {
+                    const auto found = cells.find({cell.x + dx, cell.y + dy, cell.z + dz});
+                    if (found == cells.end()) continue;
+
+                    for (uint candidate = found->second; candidate != removed_vertex; candidate = chain[candidate]) {
+                        if (vertices_match(vertices[candidate], vertex, positions_only, epsilon)) {
+                            match = candidate;
+                            break;
+                        }
                     }
                 }
-
-                vertices.remove_at(j--);
             }
         }
+
+        if (match != removed_vertex) {
+            out_remap[i] = out_remap[match];
+        } else {
+            auto& head = cells.try_emplace(cell, removed_vertex).first->second;
+            chain[i] = head;
+            head = i;
+            out_remap[i] = vertex_count++;
+        }
+    }
+
+    return vertex_count;
+}
+
+void GeometryEditor::apply_vertex_remap(List<StaticMesh::Vertex>& vertices, List<uint>& indices, const List<uint>& remap, uint vertex_count) {
+    List<StaticMesh::Vertex> result(vertex_count);
+    List<bool> written(vertex_count, false);
+
+    // first vertex mapped to a slot wins, the same way it did with pairwise merging
+    for (uint i = 0; i < vertices.length(); i++) {
+        const uint target = remap[i];
+        if (target == removed_vertex || written[target]) continue;
+
+        result[target] = vertices[i];
+        written[target] = true;
+    }
+
+    for (auto& index : indices) {
+        index = remap[index];
     }
+
+    vertices = std::move(result);
 }
 
 void GeometryEditor::remove_indices(List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
@@ -102,16 +198,11 @@ void GeometryEditor::mirror_z(List<StaticMesh::Vertex>& vertices) {
 }
 
 void GeometryEditor::translate(List<StaticMesh::Vertex>& vertices, const Vector3& offset) {
-    for (auto& vertex : vertices) {
-        vertex.pos += offset;
-    }
+    transform(vertices, Transform(offset));
 }
 
 void GeometryEditor::rotate(List<StaticMesh::Vertex>& vertices, const Quaternion& quat) {
-    for (auto& vertex : vertices) {
-        vertex.pos = quat.rotate_vector3(vertex.pos);
-        vertex.norm = quat.rotate_vector3(vertex.norm);
-    }
+    transform(vertices, Transform(Vector3::zero(), quat));
 }
 
 void GeometryEditor::scale(List<StaticMesh::Vertex>& vertices, const Vector3& factor) {
@@ -120,6 +211,248 @@ void GeometryEditor::scale(List<StaticMesh::Vertex>& vertices, const Vector3& fa
     }
 }
 
+static_assert(sizeof(StaticMesh::Vertex) == 32, "transform kernels expect 32-byte vertices");
+
+// vertices per parallel range of transform
+const static uint transform_grain = 16384;
+
+// row-major 3x3 matrices of transform, position is matrix * pos + offset, normal is normal_matrix * norm
+struct VertexTransform {
+    float matrix[3][3];
+    float normal_matrix[3][3];
+    float offset[3];
+    // normals have to be renormalized when transform is not rigid
+    bool normalize;
+
+    explicit VertexTransform(const Transform& transformation) {
+        const Vector3 axes[3] = {
+            transformation.rotation.rotate_vector3(Vector3(1.0f, 0.0f, 0.0f)),
+            transformation.rotation.rotate_vector3(Vector3(0.0f, 1.0f, 0.0f)),
+            transformation.rotation.rotate_vector3(Vector3(0.0f, 0.0f, 1.0f))};
+        const float scale[3] = {transformation.scale.x, transformation.scale.y, transformation.scale.z};
+
+        // inverse transpose of scale is taken as cofactors, so that flattening scale keeps usable normals
+        const float determinant = scale[0] * scale[1] * scale[2];
+        const float sign = determinant < 0.0f ? -1.0f : 1.0f;
+        const float cofactors[3] = {scale[1] * scale[2] * sign, scale[0] * scale[2] * sign, scale[0] * scale[1] * sign};
+
+        for (uint column = 0; column < 3; column++) {
+            const float axis[3] = {axes[column].x, axes[column].y, axes[column].z};
+            for (uint row = 0; row < 3; row++) {
+                matrix[row][column] = axis[row] * scale[column];
+                normal_matrix[row][column] = axis[row] * cofactors[column];
+            }
+        }
+
+        offset[0] = transformation.location.x;
+        offset[1] = transformation.location.y;
+        offset[2] = transformation.location.z;
+
+        normalize = Math::abs(scale[0]) != 1.0f || Math::abs(scale[1]) != 1.0f || Math::abs(scale[2]) != 1.0f;
+    }
+};
+
+static void transform_scalar(StaticMesh::Vertex* vertices, uint count, const VertexTransform& t) {
+    for (uint i = 0; i < count; i++) {
+        auto& vertex = vertices[i];
+        const Vector3 pos = vertex.pos;
+        const Vector3 norm = vertex.norm;
+
+        vertex.pos = Vector3(
+            t.matrix[0][0] * pos.x + t.matrix[0][1] * pos.y + t.matrix[0][2] * pos.z + t.offset[0],
+            t.matrix[1][0] * pos.x + t.matrix[1][1] * pos.y + t.matrix[1][2] * pos.z + t.offset[1],
+            t.matrix[2][0] * pos.x + t.matrix[2][1] * pos.y + t.matrix[2][2] * pos.z + t.offset[2]);
+
+        Vector3 normal(
+            t.normal_matrix[0][0] * norm.x + t.normal_matrix[0][1] * norm.y + t.normal_matrix[0][2] * norm.z,
+            t.normal_matrix[1][0] * norm.x + t.normal_matrix[1][1] * norm.y + t.normal_matrix[1][2] * norm.z,
+            t.normal_matrix[2][0] * norm.x + t.normal_matrix[2][1] * norm.y + t.normal_matrix[2][2] * norm.z);
+
+        if (t.normalize) {
+            const float length = Math::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+            if (length > KINDA_SMALL_NUMBER * KINDA_SMALL_NUMBER)
+                normal = normal / length;
+        }
+
+        vertex.norm = normal;
+    }
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+#if defined(_MSC_VER)
+#define TARGET_AVX
+#else
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+
+// vertex is read as two halves, [pos.x pos.y pos.z uv.x] and [uv.y norm.x norm.y norm.z]
+// column j of matrix goes to lanes 0-2 of low half, column j of normal matrix goes to lanes 1-3 of high half
+struct SimdColumns {
+    alignas(32) float position[3][8];
+    alignas(32) float normal[3][8];
+    alignas(32) float offset[8];
+    // keeps uv lanes untouched
+    alignas(32) float uv_mask[8];
+
+    explicit SimdColumns(const VertexTransform& t) {
+        memset(this, 0, sizeof(SimdColumns));
+        for (uint column = 0; column < 3; column++) {
+            for (uint row = 0; row < 3; row++) {
+                position[column][row] = t.matrix[row][column];
+                normal[column][5 + row] = t.normal_matrix[row][column];
+            }
+        }
+
+        offset[0] = t.offset[0];
+        offset[1] = t.offset[1];
+        offset[2] = t.offset[2];
+
+        const float all_bits = std::bit_cast<float>(~0u);
+        uv_mask[3] = all_bits;
+        uv_mask[4] = all_bits;
+    }
+};
+
+// normalizes lanes 1-3 of [uv.y norm.x norm.y norm.z], lane 0 is passed through
+FORCEINLINE static __m128 normalize_high_half(__m128 high, __m128 uv_lane) {
+    const __m128 normal = _mm_andnot_ps(uv_lane, high);
+    const __m128 squares = _mm_mul_ps(normal, normal);
+    // sum of lanes 1-3 into every lane, lane 0 is zero
+    __m128 sum = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    const __m128 length = _mm_sqrt_ps(sum);
+    const __m128 valid = _mm_cmpgt_ps(length, _mm_set1_ps(KINDA_SMALL_NUMBER * KINDA_SMALL_NUMBER));
+    const __m128 scaled = _mm_div_ps(normal, length);
+
+    return _mm_or_ps(_mm_and_ps(uv_lane, high), _mm_or_ps(_mm_and_ps(valid, scaled), _mm_andnot_ps(valid, normal)));
+}
+
+static void transform_sse(StaticMesh::Vertex* vertices, uint count, const VertexTransform& t) {
+    const SimdColumns columns(t);
+
+    const __m128 position_x = _mm_load_ps(columns.position[0]);
+    const __m128 position_y = _mm_load_ps(columns.position[1]);
+    const __m128 position_z = _mm_load_ps(columns.position[2]);
+    const __m128 normal_x = _mm_load_ps(columns.normal[0] + 4);
+    const __m128 normal_y = _mm_load_ps(columns.normal[1] + 4);
+    const __m128 normal_z = _mm_load_ps(columns.normal[2] + 4);
+    const __m128 offset = _mm_load_ps(columns.offset);
+    const __m128 low_uv_lane = _mm_load_ps(columns.uv_mask);
+    const __m128 high_uv_lane = _mm_load_ps(columns.uv_mask + 4);
+
+    for (uint i = 0; i < count; i++) {
+        float* data = reinterpret_cast<float*>(vertices + i);
+        const __m128 low = _mm_loadu_ps(data);
+        const __m128 high = _mm_loadu_ps(data + 4);
+
+        __m128 out_low = _mm_add_ps(offset, _mm_and_ps(low, low_uv_lane));
+        out_low = _mm_add_ps(out_low, _mm_mul_ps(position_x, _mm_set1_ps(data[0])));
+        out_low = _mm_add_ps(out_low, _mm_mul_ps(position_y, _mm_set1_ps(data[1])));
+        out_low = _mm_add_ps(out_low, _mm_mul_ps(position_z, _mm_set1_ps(data[2])));
+
+        __m128 out_high = _mm_and_ps(high, high_uv_lane);
+        out_high = _mm_add_ps(out_high, _mm_mul_ps(normal_x, _mm_set1_ps(data[5])));
+        out_high = _mm_add_ps(out_high, _mm_mul_ps(normal_y, _mm_set1_ps(data[6])));
+        out_high = _mm_add_ps(out_high, _mm_mul_ps(normal_z, _mm_set1_ps(data[7])));
+
+        if (t.normalize)
+            out_high = normalize_high_half(out_high, high_uv_lane);
+
+        _mm_storeu_ps(data, out_low);
+        _mm_storeu_ps(data + 4, out_high);
+    }
+}
+
+// whole vertex fits into one register, every column is applied to both halves at once
+TARGET_AVX static void transform_avx(StaticMesh::Vertex* vertices, uint count, const VertexTransform& t) {
+    const SimdColumns columns(t);
+
+    const __m256 position_x = _mm256_load_ps(columns.position[0]);
+    const __m256 position_y = _mm256_load_ps(columns.position[1]);
+    const __m256 position_z = _mm256_load_ps(columns.position[2]);
+    const __m256 normal_x = _mm256_load_ps(columns.normal[0]);
+    const __m256 normal_y = _mm256_load_ps(columns.normal[1]);
+    const __m256 normal_z = _mm256_load_ps(columns.normal[2]);
+    const __m256 offset = _mm256_load_ps(columns.offset);
+    const __m256 uv_lanes = _mm256_load_ps(columns.uv_mask);
+    const __m128 high_uv_lane = _mm_load_ps(columns.uv_mask + 4);
+
+    for (uint i = 0; i < count; i++) {
+        float* data = reinterpret_cast<float*>(vertices + i);
+        const __m256 vertex = _mm256_loadu_ps(data);
+
+        __m256 out = _mm256_add_ps(offset, _mm256_and_ps(vertex, uv_lanes));
+        out = _mm256_add_ps(out, _mm256_mul_ps(position_x, _mm256_broadcast_ss(data + 0)));
+        out = _mm256_add_ps(out, _mm256_mul_ps(position_y, _mm256_broadcast_ss(data + 1)));
+        out = _mm256_add_ps(out, _mm256_mul_ps(position_z, _mm256_broadcast_ss(data + 2)));
+        out = _mm256_add_ps(out, _mm256_mul_ps(normal_x, _mm256_broadcast_ss(data + 5)));
+        out = _mm256_add_ps(out, _mm256_mul_ps(normal_y, _mm256_broadcast_ss(data + 6)));
+        out = _mm256_add_ps(out, _mm256_mul_ps(normal_z, _mm256_broadcast_ss(data + 7)));
+
+        if (t.normalize) {
+            const __m128 high = normalize_high_half(_mm256_extractf128_ps(out, 1), high_uv_lane);
+            out = _mm256_insertf128_ps(out, high, 1);
+        }
+
+        _mm256_storeu_ps(data, out);
+    }
+
+    _mm256_zeroupper();
+}
+
+static bool cpu_supports_avx() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool os_saves_registers = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    // os must also preserve ymm registers on context switch
+    return os_saves_registers && avx && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+#endif
+
+GeometryEditor::SimdLevel GeometryEditor::get_simd_level() {
+#if defined(__SSE2__) || defined(_M_X64)
+    const static SimdLevel level = cpu_supports_avx() ? SimdLevel::AVX : SimdLevel::SSE;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+void GeometryEditor::transform(List<StaticMesh::Vertex>& vertices, const Transform& transformation) {
+    transform(vertices, transformation, get_simd_level());
+}
+
+void GeometryEditor::transform(List<StaticMesh::Vertex>& vertices, const Transform& transformation, SimdLevel level) {
+    const VertexTransform t(transformation);
+    if (level > get_simd_level())
+        level = get_simd_level();
+
+    ThreadPool::get().parallel_for(vertices.length(), [&](uint begin, uint end) {
+        StaticMesh::Vertex* range = vertices.get_data() + begin;
+        switch (level) {
+#if defined(__SSE2__) || defined(_M_X64)
+        case SimdLevel::AVX:
+            transform_avx(range, end - begin, t);
+            break;
+        case SimdLevel::SSE:
+            transform_sse(range, end - begin, t);
+            break;
+#endif
+        default:
+            transform_scalar(range, end - begin, t);
+            break;
+        }
+    }, transform_grain);
+}
+
 void GeometryEditor::move_to_center(List<StaticMesh::Vertex>& vertices) {
     Vector3 sum;
     for (const auto& vertex : vertices) {
@@ -222,62 +555,757 @@ void GeometryEditor::compute_faces(const List<StaticMesh::Vertex>& vertices, con
     }
 }
 
-void GeometryEditor::compute_normals(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices, List<Vector3>& out_normals, bool invert) {
-    out_normals.clear();
+// triangles per parallel range, smaller meshes are processed on calling thread
+const static uint normals_grain = 4096;
 
-    for (uint i = 0; i < indices.length() / 3; i++) {
-        auto normal = compute_normal(vertices[indices[i * 3 + 0]].pos, vertices[indices[i * 3 + 1]].pos, vertices[indices[i * 3 + 2]].pos);
-        if (invert)
-            normal *= -1;
-        out_normals.add(normal);
+// cross products (c - a) x (b - a) of triangles in [begin, end) from SoA positions, unit length unless area weighted
+static void compute_face_normals(const float* px, const float* py, const float* pz, const uint* indices, uint begin, uint end, bool normalize, float* nx, float* ny, float* nz) {
+    uint i = begin;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    // four triangles at once, positions are gathered into lanes
+    for (; i + 4 <= end; i += 4) {
+        const uint* t = indices + i * 3;
+        const __m128 ax = _mm_setr_ps(px[t[0]], px[t[3]], px[t[6]], px[t[9]]);
+        const __m128 ay = _mm_setr_ps(py[t[0]], py[t[3]], py[t[6]], py[t[9]]);
+        const __m128 az = _mm_setr_ps(pz[t[0]], pz[t[3]], pz[t[6]], pz[t[9]]);
+        const __m128 vx = _mm_sub_ps(_mm_setr_ps(px[t[1]], px[t[4]], px[t[7]], px[t[10]]), ax);
+        const __m128 vy = _mm_sub_ps(_mm_setr_ps(py[t[1]], py[t[4]], py[t[7]], py[t[10]]), ay);
+        const __m128 vz = _mm_sub_ps(_mm_setr_ps(pz[t[1]], pz[t[4]], pz[t[7]], pz[t[10]]), az);
+        const __m128 ux = _mm_sub_ps(_mm_setr_ps(px[t[2]], px[t[5]], px[t[8]], px[t[11]]), ax);
+        const __m128 uy = _mm_sub_ps(_mm_setr_ps(py[t[2]], py[t[5]], py[t[8]], py[t[11]]), ay);
+        const __m128 uz = _mm_sub_ps(_mm_setr_ps(pz[t[2]], pz[t[5]], pz[t[8]], pz[t[11]]), az);
+
+        __m128 cx = _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy));
+        __m128 cy = _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz));
+        __m128 cz = _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx));
+
+        if (normalize) {
+            const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)));
+            // degenerate triangles end up with zero normal and do not contribute
+            const __m128 valid = _mm_cmpgt_ps(length, _mm_set1_ps(KINDA_SMALL_NUMBER * KINDA_SMALL_NUMBER));
+            const __m128 inverse = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), length), valid);
+            cx = _mm_mul_ps(cx, inverse);
+            cy = _mm_mul_ps(cy, inverse);
+            cz = _mm_mul_ps(cz, inverse);
+        }
+
+        _mm_storeu_ps(nx + i, cx);
+        _mm_storeu_ps(ny + i, cy);
+        _mm_storeu_ps(nz + i, cz);
     }
-}
+#endif
 
-void GeometryEditor::compute_normals(List<StaticMesh::Vertex>& vertices, const List<uint>& indices, bool invert) {
-    List<List<Vector3>> vertex_normals = List<List<Vector3>>(vertices.length());
+    for (; i < end; i++) {
+        const uint* t = indices + i * 3;
+        const float vx = px[t[1]] - px[t[0]], vy = py[t[1]] - py[t[0]], vz = pz[t[1]] - pz[t[0]];
+        const float ux = px[t[2]] - px[t[0]], uy = py[t[2]] - py[t[0]], uz = pz[t[2]] - pz[t[0]];
 
-    for (uint i = 0; i < indices.length() / 3; i++) {
-        const uint i0 = indices[i * 3 + 0];
-        const uint i1 = indices[i * 3 + 1];
-        const uint i2 = indices[i * 3 + 2];
-        auto normal = compute_normal(vertices[i0].pos, vertices[i1].pos, vertices[i2].pos);
-        if (invert)
-            normal *= -1;
-        vertex_normals[i0].add(normal);
-        vertex_normals[i1].add(normal);
-        vertex_normals[i2].add(normal);
+        float cx = uy * vz - uz * vy;
+        float cy = uz * vx - ux * vz;
+        float cz = ux * vy - uy * vx;
+
+        if (normalize) {
+            const float length = Math::sqrt(cx * cx + cy * cy + cz * cz);
+            const float inverse = length > KINDA_SMALL_NUMBER * KINDA_SMALL_NUMBER ? 1.0f / length : 0.0f;
+            cx *= inverse;
+            cy *= inverse;
+            cz *= inverse;
+        }
+
+        nx[i] = cx;
+        ny[i] = cy;
+        nz[i] = cz;
     }
+}
+
+// angle between two edges leaving corner
+static float corner_angle(const Vector3& corner, const Vector3& a, const Vector3& b) {
+    const Vector3 edge_a = a - corner;
+    const Vector3 edge_b = b - corner;
+    const float length = edge_a.magnitude() * edge_b.magnitude();
+    if (length < KINDA_SMALL_NUMBER) return 0.0f;
+
+    return std::acos(Math::clamp(edge_a.dot_product(edge_b) / length, -1.0f, 1.0f));
+}
 
-    for (uint i = 0; i < indices.length(); i++) {
-        const uint index = indices[i];
+void GeometryEditor::compute_normals(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices, List<Vector3>& out_normals, bool invert) {
+    const uint triangle_count = indices.length() / 3;
+    out_normals = List<Vector3>(triangle_count);
 
-        Vector3 normal_sum;
-        for (auto norm : vertex_normals[index]) {
-            normal_sum += norm;
+    ThreadPool::get().parallel_for(triangle_count, [&](uint begin, uint end) {
+        for (uint i = begin; i < end; i++) {
+            auto normal = compute_normal(vertices[indices[i * 3 + 0]].pos, vertices[indices[i * 3 + 1]].pos, vertices[indices[i * 3 + 2]].pos);
+            if (invert)
+                normal *= -1;
+            out_normals[i] = normal;
         }
-        vertices[index].norm = (normal_sum / static_cast<float>(vertex_normals.length())).normalized();
+    }, normals_grain);
+}
+
+void GeometryEditor::compute_normals(List<StaticMesh::Vertex>& vertices, const List<uint>& indices, bool invert, NormalWeighting weighting) {
+    const uint vertex_count = vertices.length();
+    const uint triangle_count = indices.length() / 3;
+    const uint corner_count = triangle_count * 3;
+    if (triangle_count == 0) return;
+
+    auto& pool = ThreadPool::get();
+
+    // positions as separate streams, so that triangles can be processed in simd lanes
+    List<float> px(vertex_count);
+    List<float> py(vertex_count);
+    List<float> pz(vertex_count);
+    pool.parallel_for(vertex_count, [&](uint begin, uint end) {
+        for (uint i = begin; i < end; i++) {
+            px[i] = vertices[i].pos.x;
+            py[i] = vertices[i].pos.y;
+            pz[i] = vertices[i].pos.z;
+        }
+    }, normals_grain);
+
+    List<float> nx(triangle_count);
+    List<float> ny(triangle_count);
+    List<float> nz(triangle_count);
+    List<float> corner_weights(weighting == NormalWeighting::Angle ? corner_count : 0);
+    pool.parallel_for(triangle_count, [&](uint begin, uint end) {
+        compute_face_normals(px.get_data(), py.get_data(), pz.get_data(), indices.get_data(), begin, end, weighting != NormalWeighting::Area, nx.get_data(), ny.get_data(), nz.get_data());
+
+        if (weighting == NormalWeighting::Angle) {
+            for (uint i = begin; i < end; i++) {
+                const Vector3& a = vertices[indices[i * 3 + 0]].pos;
+                const Vector3& b = vertices[indices[i * 3 + 1]].pos;
+                const Vector3& c = vertices[indices[i * 3 + 2]].pos;
+                corner_weights[i * 3 + 0] = corner_angle(a, b, c);
+                corner_weights[i * 3 + 1] = corner_angle(b, c, a);
+                corner_weights[i * 3 + 2] = corner_angle(c, a, b);
+            }
+        }
+    }, normals_grain);
+
+    // corners of each vertex, so that vertices gather their normals without write conflicts
+    List<uint> corner_offsets(vertex_count + 1, 0);
+    for (uint i = 0; i < corner_count; i++) {
+        corner_offsets[indices[i] + 1]++;
+    }
+    for (uint i = 0; i < vertex_count; i++) {
+        corner_offsets[i + 1] += corner_offsets[i];
     }
+
+    List<uint> vertex_corners(corner_count);
+    List<uint> fill = List<uint>(corner_offsets.get_data(), vertex_count);
+    for (uint i = 0; i < corner_count; i++) {
+        vertex_corners[fill[indices[i]]++] = i;
+    }
+
+    const float sign = invert ? -1.0f : 1.0f;
+    pool.parallel_for(vertex_count, [&](uint begin, uint end) {
+        for (uint i = begin; i < end; i++) {
+            const uint corners_begin = corner_offsets[i];
+            const uint corners_end = corner_offsets[i + 1];
+            if (corners_begin == corners_end) continue;
+
+            float sum_x = 0.0f;
+            float sum_y = 0.0f;
+            float sum_z = 0.0f;
+            for (uint j = corners_begin; j < corners_end; j++) {
+                const uint corner = vertex_corners[j];
+                const uint triangle = corner / 3;
+                const float weight = weighting == NormalWeighting::Angle ? corner_weights[corner] : 1.0f;
+                sum_x += nx[triangle] * weight;
+                sum_y += ny[triangle] * weight;
+                sum_z += nz[triangle] * weight;
+            }
+
+            const float length = Math::sqrt(sum_x * sum_x + sum_y * sum_y + sum_z * sum_z);
+            if (length < KINDA_SMALL_NUMBER * KINDA_SMALL_NUMBER) continue;
+
+            const float scale = sign / length;
+            vertices[i].norm = Vector3(sum_x * scale, sum_y * scale, sum_z * scale);
+        }
+    }, normals_grain);
 }
 
 void GeometryEditor::remove_unused_vertices(List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
-    List<bool> referred = List<bool>(vertices.length(), false);
+    List<uint> remap = List<uint>(vertices.length(), removed_vertex);
 
     for (auto index : indices) {
-        referred[index] = true;
+        remap[index] = 0;
+    }
+
+    uint vertex_count = 0;
+    for (auto& slot : remap) {
+        if (slot != removed_vertex) {
+            slot = vertex_count++;
+        }
+    }
+
+    apply_vertex_remap(vertices, indices, remap, vertex_count);
+}
+
+// next vertex to fan around: most recently cached vertex with live triangles which will stay in cache
+static uint tipsify_next_vertex(const List<uint>& candidates, const List<uint>& live_triangles, const List<uint>& cache_time, uint time, uint cache_size, List<uint>& dead_end, uint& cursor) {
+    uint best_vertex = GeometryEditor::removed_vertex;
+    int best_priority = -1;
+    for (const auto vertex : candidates) {
+        if (live_triangles[vertex] == 0) continue;
+
+        int priority = 0;
+        if (time - cache_time[vertex] + 2 * live_triangles[vertex] <= cache_size) {
+            priority = static_cast<int>(time - cache_time[vertex]);
+        }
+
+        if (priority > best_priority) {
+            best_priority = priority;
+            best_vertex = vertex;
+        }
+    }
+
+    if (best_vertex != GeometryEditor::removed_vertex) return best_vertex;
+
+    // dead end, take recently emitted vertex or just any vertex with remaining triangles
+    while (dead_end.length() > 0) {
+        const uint vertex = dead_end.last();
+        dead_end.remove_at(dead_end.length() - 1);
+        if (live_triangles[vertex] > 0) return vertex;
+    }
+
+    while (cursor < live_triangles.length()) {
+        if (live_triangles[cursor] > 0) return cursor;
+        cursor++;
+    }
+
+    return GeometryEditor::removed_vertex;
+}
+
+void GeometryEditor::optimize_vertex_cache(List<uint>& indices, uint vertex_count, uint cache_size) {
+    const uint triangle_count = indices.length() / 3;
+    if (triangle_count == 0) return;
+
+    // vertex to triangle adjacency, packed in one list
+    List<uint> live_triangles = List<uint>(vertex_count, 0);
+    for (uint i = 0; i < triangle_count * 3; i++) {
+        live_triangles[indices[i]]++;
+    }
+
+    List<uint> adjacency_offsets(vertex_count + 1);
+    adjacency_offsets[0] = 0;
+    for (uint i = 0; i < vertex_count; i++) {
+        adjacency_offsets[i + 1] = adjacency_offsets[i] + live_triangles[i];
+    }
+
+    List<uint> adjacency(triangle_count * 3);
+    List<uint> adjacency_fill = List<uint>(adjacency_offsets.get_data(), vertex_count);
+    for (uint i = 0; i < triangle_count * 3; i++) {
+        adjacency[adjacency_fill[indices[i]]++] = i / 3;
+    }
+
+    List<uint> cache_time = List<uint>(vertex_count, 0);
+    List<bool> emitted = List<bool>(triangle_count, false);
+    List<uint> dead_end;
+    List<uint> candidates;
+    List<uint> result;
+
+    uint time = cache_size + 1;
+    uint cursor = 0;
+    uint fanning_vertex = tipsify_next_vertex(candidates, live_triangles, cache_time, time, cache_size, dead_end, cursor);
+
+    while (fanning_vertex != removed_vertex) {
+        candidates.clear();
+
+        for (uint i = adjacency_offsets[fanning_vertex]; i < adjacency_offsets[fanning_vertex + 1]; i++) {
+            const uint triangle = adjacency[i];
+            if (emitted[triangle]) continue;
+
+            for (uint j = 0; j < 3; j++) {
+                const uint vertex = indices[triangle * 3 + j];
+                result.add(vertex);
+                dead_end.add(vertex);
+                candidates.add(vertex);
+                live_triangles[vertex]--;
+
+                if (time - cache_time[vertex] > cache_size) {
+                    cache_time[vertex] = time++;
+                }
+            }
+
+            emitted[triangle] = true;
+        }
+
+        fanning_vertex = tipsify_next_vertex(candidates, live_triangles, cache_time, time, cache_size, dead_end, cursor);
+    }
+
+    // keep trailing indices of incomplete triangle, if any
+    for (uint i = triangle_count * 3; i < indices.length(); i++) {
+        result.add(indices[i]);
+    }
+
+    indices = std::move(result);
+}
+
+struct TriangleCluster {
+    uint start;
+    uint count;
+    float sort_key;
+};
+
+void GeometryEditor::optimize_overdraw(const List<StaticMesh::Vertex>& vertices, List<uint>& indices, uint cache_size) {
+    const uint triangle_count = indices.length() / 3;
+    if (triangle_count < 2) return;
+
+    // cluster ends where cache is fully flushed, so moving clusters around doesn't hurt cache efficiency much
+    List<TriangleCluster> clusters;
+    List<uint> cache_time = List<uint>(vertices.length(), 0);
+    uint time = cache_size + 1;
+    for (uint i = 0; i < triangle_count; i++) {
+        uint misses = 0;
+        for (uint j = 0; j < 3; j++) {
+            const uint vertex = indices[i * 3 + j];
+            if (time - cache_time[vertex] > cache_size) {
+                cache_time[vertex] = time++;
+                misses++;
+            }
+        }
+
+        if (i == 0 || misses == 3) {
+            clusters.add({i, 0, 0.0f});
+        }
+        clusters.last().count++;
+    }
+
+    if (clusters.length() < 2) return;
+
+    Vector3 mesh_center;
+    float mesh_area = 0.0f;
+    List<Vector3> cluster_centers(clusters.length());
+    List<Vector3> cluster_normals(clusters.length());
+    for (uint c = 0; c < clusters.length(); c++) {
+        Vector3 center;
+        Vector3 normal;
+        float area = 0.0f;
+        for (uint i = clusters[c].start; i < clusters[c].start + clusters[c].count; i++) {
+            const Vector3& a = vertices[indices[i * 3 + 0]].pos;
+            const Vector3& b = vertices[indices[i * 3 + 1]].pos;
+            const Vector3& d = vertices[indices[i * 3 + 2]].pos;
+            const Vector3 cross = (d - a).cross_product(b - a);
+            const float triangle_area = cross.magnitude();
+
+            center += (a + b + d) * (triangle_area / 3.0f);
+            normal += cross;
+            area += triangle_area;
+        }
+
+        mesh_center += center;
+        mesh_area += area;
+        cluster_centers[c] = area > 0.0f ? center / area : vertices[indices[clusters[c].start * 3]].pos;
+        cluster_normals[c] = normal.normalized();
+    }
+
+    if (mesh_area > 0.0f) {
+        mesh_center /= mesh_area;
+    }
+
+    // clusters which face away from the middle of the mesh are likely to occlude the rest, draw them first
+    for (uint c = 0; c < clusters.length(); c++) {
+        clusters[c].sort_key = (cluster_centers[c] - mesh_center).dot_product(cluster_normals[c]);
+    }
+
+    List<uint> order = List<uint>(clusters.length(), [](uint i) -> uint { return i; });
+    order.sort_predicate([&](uint a, uint b) -> bool {
+        return clusters[a].sort_key != clusters[b].sort_key ? clusters[a].sort_key > clusters[b].sort_key : a < b;
+    });
+
+    List<uint> result(triangle_count * 3);
+    uint written = 0;
+    for (const auto cluster_index : order) {
+        const auto& cluster = clusters[cluster_index];
+        memcpy(result.get_data() + written, indices.get_data() + cluster.start * 3, sizeof(uint) * cluster.count * 3);
+        written += cluster.count * 3;
+    }
+
+    for (uint i = triangle_count * 3; i < indices.length(); i++) {
+        result.add(indices[i]);
     }
 
+    indices = std::move(result);
+}
+
+void GeometryEditor::optimize_vertex_fetch(List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+    List<uint> remap = List<uint>(vertices.length(), removed_vertex);
+
+    uint vertex_count = 0;
+    for (const auto index : indices) {
+        if (remap[index] == removed_vertex) {
+            remap[index] = vertex_count++;
+        }
+    }
+
+    apply_vertex_remap(vertices, indices, remap, vertex_count);
+}
+
+GeometryEditor::CacheStatistics GeometryEditor::analyze_vertex_cache(const List<uint>& indices, uint vertex_count, uint cache_size) {
+    // vertex is in FIFO cache if it was pushed there during last cache_size pushes
+    List<uint> cache_time = List<uint>(vertex_count, 0);
+    List<bool> referenced = List<bool>(vertex_count, false);
+    uint time = cache_size + 1;
+    uint unique_vertices = 0;
+
+    CacheStatistics result = {0, 0.0f, 0.0f};
+    for (const auto index : indices) {
+        if (time - cache_time[index] > cache_size) {
+            cache_time[index] = time++;
+            result.vertices_transformed++;
+        }
+
+        if (!referenced[index]) {
+            referenced[index] = true;
+            unique_vertices++;
+        }
+    }
+
+    const uint triangle_count = indices.length() / 3;
+    result.acmr = triangle_count > 0 ? static_cast<float>(result.vertices_transformed) / static_cast<float>(triangle_count) : 0.0f;
+    result.atvr = unique_vertices > 0 ? static_cast<float>(result.vertices_transformed) / static_cast<float>(unique_vertices) : 0.0f;
+
+    return result;
+}
+
+// sum of squared distances to planes, weighted by triangle area
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    void add_plane(const Vector3& normal, float distance, float plane_weight) {
+        a00 += plane_weight * normal.x * normal.x;
+        a01 += plane_weight * normal.x * normal.y;
+        a02 += plane_weight * normal.x * normal.z;
+        a11 += plane_weight * normal.y * normal.y;
+        a12 += plane_weight * normal.y * normal.z;
+        a22 += plane_weight * normal.z * normal.z;
+        b0 += plane_weight * normal.x * distance;
+        b1 += plane_weight * normal.y * distance;
+        b2 += plane_weight * normal.z * distance;
+        c += plane_weight * distance * distance;
+        weight += plane_weight;
+    }
+
+    void add(const Quadric& other) {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // mean squared distance from point to planes
+    double evaluate(const Vector3& point) const {
+        const double x = point.x;
+        const double y = point.y;
+        const double z = point.z;
+        const double error = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0 ? Math::max(error, 0.0) / weight : 0.0;
+    }
+};
+
+enum class SimplifyPointKind : byte {
+    // interior point with continuous attributes, can collapse anywhere
+    Manifold,
+    // point on open edge, can only slide along it
+    Border,
+    // point with several wedges due to uv or normal discontinuity, can only slide along seam
+    Seam,
+    // non-manifold or border corner, stays in place
+    Locked
+};
+
+struct SimplifyCollapse {
+    uint from;
+    uint to;
+    double error;
+};
+
+FORCEINLINE uint64 simplify_key(uint a, uint b) {
+    return static_cast<uint64>(a) << 32 | b;
+}
+
+// border edges are weighted more so that silhouette of open meshes is kept
+const static float simplify_border_weight = 10.0f;
+
+float GeometryEditor::simplify(const List<StaticMesh::Vertex>& vertices, List<uint>& indices, uint target_index_count, float target_error) {
+    target_index_count -= target_index_count % 3;
+    if (indices.length() <= target_index_count || vertices.length() == 0) return 0.0f;
+
+    // vertices at same position are wedges of one point, collapses move whole points
+    List<uint> point_of;
+    const uint point_count = generate_vertex_remap(vertices, point_of, true);
+
+    List<Vector3> points(point_count);
+    List<uint> wedge_count(point_count, 0);
     for (uint i = 0; i < vertices.length(); i++) {
-        if (!referred[i]) {
-            vertices.remove_at(i);
-            referred.remove_at(i);
+        points[point_of[i]] = vertices[i].pos;
+        wedge_count[point_of[i]]++;
+    }
+
+    Vector3 bounds_min = points[0];
+    Vector3 bounds_max = points[0];
+    for (const auto& point : points) {
+        bounds_min = Vector3(Math::min(bounds_min.x, point.x), Math::min(bounds_min.y, point.y), Math::min(bounds_min.z, point.z));
+        bounds_max = Vector3(Math::max(bounds_max.x, point.x), Math::max(bounds_max.y, point.y), Math::max(bounds_max.z, point.z));
+    }
+    const Vector3 size = bounds_max - bounds_min;
+    const double scale = Math::max(Math::max(size.x, size.y), Math::max(size.z, KINDA_SMALL_NUMBER));
+    const double error_limit = static_cast<double>(target_error) * scale * static_cast<double>(target_error) * scale;
+
+    // classify points by directed edges, edge without opposite one is border
+    std::unordered_map<uint64, uint> edges;
+    for (uint i = 0; i < indices.length(); i += 3) {
+        for (uint e = 0; e < 3; e++) {
+            edges[simplify_key(point_of[indices[i + e]], point_of[indices[i + (e + 1) % 3]])]++;
+        }
+    }
+
+    List<SimplifyPointKind> kinds(point_count, SimplifyPointKind::Manifold);
+    List<uint> border_next(point_count, removed_vertex);
+    List<uint> border_prev(point_count, removed_vertex);
+    List<Quadric> quadrics(point_count);
+    for (uint i = 0; i < point_count; i++) {
+        if (wedge_count[i] > 1) kinds[i] = SimplifyPointKind::Seam;
+    }
+
+    for (uint i = 0; i < indices.length(); i += 3) {
+        const uint p0 = point_of[indices[i + 0]];
+        const uint p1 = point_of[indices[i + 1]];
+        const uint p2 = point_of[indices[i + 2]];
+
+        const Vector3 cross = (points[p1] - points[p0]).cross_product(points[p2] - points[p0]);
+        const float area = cross.magnitude();
+        if (area <= 0) continue;
+
+        const Vector3 normal = cross / area;
+        const float distance = -normal.dot_product(points[p0]);
+        quadrics[p0].add_plane(normal, distance, area);
+        quadrics[p1].add_plane(normal, distance, area);
+        quadrics[p2].add_plane(normal, distance, area);
+
+        const uint triangle[3] = {p0, p1, p2};
+        for (uint e = 0; e < 3; e++) {
+            const uint from = triangle[e];
+            const uint to = triangle[(e + 1) % 3];
+            if (from == to) continue;
+
+            if (edges[simplify_key(from, to)] > 1) {
+                kinds[from] = SimplifyPointKind::Locked;
+                kinds[to] = SimplifyPointKind::Locked;
+            }
 
-            for (uint j = 0; j < indices.length(); j++) {
-                if (indices[j] > i) {
-                    indices[j--]--;
+            if (edges.find(simplify_key(to, from)) != edges.end()) continue;
+
+            // plane through border edge, perpendicular to triangle
+            const Vector3 edge = points[to] - points[from];
+            const Vector3 edge_normal = edge.cross_product(normal).normalized();
+            const float edge_weight = edge.dot_product(edge) * simplify_border_weight;
+            quadrics[from].add_plane(edge_normal, -edge_normal.dot_product(points[from]), edge_weight);
+            quadrics[to].add_plane(edge_normal, -edge_normal.dot_product(points[from]), edge_weight);
+
+            // border point must have exactly one incoming and one outgoing border edge
+            if (border_next[from] != removed_vertex || border_prev[to] != removed_vertex) {
+                kinds[from] = SimplifyPointKind::Locked;
+                kinds[to] = SimplifyPointKind::Locked;
+            }
+
+            border_next[from] = to;
+            border_prev[to] = from;
+        }
+    }
+
+    for (uint i = 0; i < point_count; i++) {
+        if (kinds[i] == SimplifyPointKind::Locked) continue;
+
+        const bool has_next = border_next[i] != removed_vertex;
+        const bool has_prev = border_prev[i] != removed_vertex;
+        if (has_next != has_prev) {
+            kinds[i] = SimplifyPointKind::Locked;
+        } else if (has_next) {
+            kinds[i] = SimplifyPointKind::Border;
+        }
+    }
+
+    List<uint> result = indices;
+    double max_error = 0;
+
+    List<uint> collapse_target(vertices.length());
+    List<byte> locked(point_count);
+    List<uint> adjacency_offsets(point_count + 1);
+    List<uint> adjacency;
+    List<SimplifyCollapse> collapses;
+    std::unordered_map<uint64, uint> wedge_neighbours;
+
+    while (result.length() > target_index_count) {
+        const uint triangle_count = result.length() / 3;
+
+        // triangles around each point
+        adjacency_offsets = List<uint>(point_count + 1, 0);
+        for (uint i = 0; i < result.length(); i++) {
+            adjacency_offsets[point_of[result[i]] + 1]++;
+        }
+        for (uint i = 0; i < point_count; i++) {
+            adjacency_offsets[i + 1] += adjacency_offsets[i];
+        }
+        adjacency = List<uint>(result.length());
+        List<uint> fill = adjacency_offsets;
+        for (uint i = 0; i < result.length(); i++) {
+            adjacency[fill[point_of[result[i]]]++] = i / 3;
+        }
+
+        // wedge of point which shares edge with given vertex
+        wedge_neighbours.clear();
+        for (uint i = 0; i < result.length(); i += 3) {
+            for (uint a = 0; a < 3; a++) {
+                for (uint b = 0; b < 3; b++) {
+                    if (a != b) wedge_neighbours.emplace(simplify_key(result[i + a], point_of[result[i + b]]), result[i + b]);
+                }
+            }
+        }
+
+        const auto can_collapse = [&](uint from, uint to) {
+            switch (kinds[from]) {
+            case SimplifyPointKind::Manifold:
+                break;
+            case SimplifyPointKind::Border:
+                if (border_next[from] != to && border_prev[from] != to) return false;
+                break;
+            case SimplifyPointKind::Seam:
+                if (kinds[to] == SimplifyPointKind::Manifold) return false;
+                break;
+            default:
+                return false;
+            }
+
+            if (wedge_count[from] == 1) return true;
+
+            // every wedge must have matching wedge at target, so that seam moves as whole
+            for (uint a = adjacency_offsets[from]; a < adjacency_offsets[from + 1]; a++) {
+                const uint triangle = adjacency[a];
+                for (uint k = 0; k < 3; k++) {
+                    const uint vertex = result[triangle * 3 + k];
+                    if (point_of[vertex] == from && wedge_neighbours.find(simplify_key(vertex, to)) == wedge_neighbours.end()) return false;
+                }
+            }
+
+            return true;
+        };
+
+        collapses.clear();
+        for (uint i = 0; i < result.length(); i += 3) {
+            for (uint e = 0; e < 3; e++) {
+                const uint p0 = point_of[result[i + e]];
+                const uint p1 = point_of[result[i + (e + 1) % 3]];
+                if (p0 == p1) continue;
+
+                const double error01 = can_collapse(p0, p1) ? quadrics[p0].evaluate(points[p1]) : -1.0;
+                const double error10 = can_collapse(p1, p0) ? quadrics[p1].evaluate(points[p0]) : -1.0;
+                if (error01 >= 0 && (error10 < 0 || error01 <= error10)) {
+                    collapses.add({p0, p1, error01});
+                } else if (error10 >= 0) {
+                    collapses.add({p1, p0, error10});
                 }
             }
         }
+
+        collapses.sort_predicate([](const SimplifyCollapse& a, const SimplifyCollapse& b) { return a.error < b.error; });
+
+        for (uint i = 0; i < collapse_target.length(); i++) {
+            collapse_target[i] = i;
+        }
+        locked = List<byte>(point_count, 0);
+
+        const uint triangles_to_remove = triangle_count - target_index_count / 3;
+        uint triangles_removed = 0;
+        uint collapse_count = 0;
+        for (const auto& collapse : collapses) {
+            if (collapse.error > error_limit || triangles_removed >= triangles_to_remove) break;
+            if (locked[collapse.from] || locked[collapse.to]) continue;
+
+            // moving point must not flip any of remaining triangles
+            bool flips = false;
+            uint removes = 0;
+            for (uint a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1] && !flips; a++) {
+                const uint triangle = adjacency[a];
+                const uint p[3] = {point_of[result[triangle * 3 + 0]], point_of[result[triangle * 3 + 1]], point_of[result[triangle * 3 + 2]]};
+                if (p[0] == collapse.to || p[1] == collapse.to || p[2] == collapse.to) {
+                    removes++;
+                    continue;
+                }
+
+                const Vector3 before = (points[p[1]] - points[p[0]]).cross_product(points[p[2]] - points[p[0]]);
+                const Vector3 moved[3] = {
+                    points[p[0] == collapse.from ? collapse.to : p[0]],
+                    points[p[1] == collapse.from ? collapse.to : p[1]],
+                    points[p[2] == collapse.from ? collapse.to : p[2]]};
+                const Vector3 after = (moved[1] - moved[0]).cross_product(moved[2] - moved[0]);
+                flips = before.dot_product(after) <= 0;
+            }
+
+            if (flips) continue;
+
+            for (uint a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; a++) {
+                const uint triangle = adjacency[a];
+                for (uint k = 0; k < 3; k++) {
+                    const uint vertex = result[triangle * 3 + k];
+                    const uint point = point_of[vertex];
+                    locked[point] = 1;
+
+                    // matching wedge always exists, can_collapse checked it
+                    if (point == collapse.from) {
+                        const auto found = wedge_neighbours.find(simplify_key(vertex, collapse.to));
+                        if (found != wedge_neighbours.end()) collapse_target[vertex] = found->second;
+                    }
+                }
+            }
+
+            // border loop skips removed point
+            if (kinds[collapse.from] == SimplifyPointKind::Border) {
+                if (border_next[collapse.from] == collapse.to) {
+                    border_next[border_prev[collapse.from]] = collapse.to;
+                    border_prev[collapse.to] = border_prev[collapse.from];
+                } else {
+                    border_prev[border_next[collapse.from]] = collapse.to;
+                    border_next[collapse.to] = border_next[collapse.from];
+                }
+            }
+
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            max_error = Math::max(max_error, collapse.error);
+            triangles_removed += removes;
+            collapse_count++;
+        }
+
+        if (collapse_count == 0) break;
+
+        // drop triangles that became degenerate
+        uint write = 0;
+        for (uint i = 0; i < result.length(); i += 3) {
+            const uint i0 = collapse_target[result[i + 0]];
+            const uint i1 = collapse_target[result[i + 1]];
+            const uint i2 = collapse_target[result[i + 2]];
+            if (point_of[i0] == point_of[i1] || point_of[i1] == point_of[i2] || point_of[i0] == point_of[i2]) continue;
+
+            result[write++] = i0;
+            result[write++] = i1;
+            result[write++] = i2;
+        }
+        result.resize(write);
     }
+
+    indices = result;
+    return static_cast<float>(Math::sqrt(static_cast<float>(max_error)) / scale);
 }
 
 Shared<StaticMesh> GeometryEditor::get_unit_cube() {
@@ -368,3 +1396,87 @@ Shared<StaticMesh> GeometryEditor::get_unit_cube() {
 
     return result;
 }
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::weld(float epsilon) {
+    return add([epsilon](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        optimize(vertices, indices, epsilon);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::weld_positions(float epsilon) {
+    return add([epsilon](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        optimize_collision(vertices, indices, epsilon);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::remove_unused_vertices() {
+    return add([](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::remove_unused_vertices(vertices, indices);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::compute_normals(bool invert, NormalWeighting weighting) {
+    return add([invert, weighting](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::compute_normals(vertices, indices, invert, weighting);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::optimize_vertex_cache(uint cache_size) {
+    return add([cache_size](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::optimize_vertex_cache(indices, vertices.length(), cache_size);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::optimize_overdraw(uint cache_size) {
+    return add([cache_size](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::optimize_overdraw(vertices, indices, cache_size);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::optimize_vertex_fetch() {
+    return add([](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::optimize_vertex_fetch(vertices, indices);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::simplify(float ratio, float target_error) {
+    return add([ratio, target_error](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::simplify(vertices, indices, static_cast<uint>(indices.length() * ratio), target_error);
+        GeometryEditor::remove_unused_vertices(vertices, indices);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::translate(const Vector3& offset) {
+    return add([offset](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::translate(vertices, offset);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::rotate(const Quaternion& quat) {
+    return add([quat](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::rotate(vertices, quat);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::scale(const Vector3& factor) {
+    return add([factor](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::scale(vertices, factor);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::transform(const Transform& transformation) {
+    return add([transformation](List<StaticMesh::Vertex>& vertices, List<uint>& indices) {
+        GeometryEditor::transform(vertices, transformation);
+    });
+}
+
+GeometryEditor::Pipeline& GeometryEditor::Pipeline::add(const Step& step) {
+    steps_.add(step);
+    return *this;
+}
+
+void GeometryEditor::Pipeline::run(List<StaticMesh::Vertex>& vertices, List<uint>& indices) const {
+    for (const auto& step : steps_) {
+        step(vertices, indices);
+    }
+}
@@ -0,0 +1,299 @@
+#include "hexa_engine/HexChunk.h"
+
+#include "hexa_engine/DynamicMesh.h"
+#include "hexa_engine/Game.h"
+#include "hexa_engine/ThreadPool.h"
+
+#include <base_lib/Assert.h>
+#include <base_lib/Logger.h>
+#include <cmath>
+
+// axial offsets of lateral neighbours, in order of sides
+const static int hex_neighbours[6][2] = {{1, 0}, {0, 1}, {-1, 1}, {-1, 0}, {0, -1}, {1, -1}};
+
+// part of apothem within which vertex is considered lying on side
+const static float hex_side_tolerance = 0.001f;
+
+const static uint unmapped_vertex = static_cast<uint>(-1);
+
+// appended to chunk names, mesh names must be unique while old mesh of recreated chunk may still be alive
+static uint next_chunk_id = 0;
+
+HexTileSet::HexTileSet(float apothem, float height)
+    : apothem_(apothem)
+    , height_(height)
+{
+    // empty tile
+    tiles_.add(TileType());
+    tiles_[0].opaque = false;
+}
+
+byte16 HexTileSet::add_tile(const List<StaticMesh::SubMesh>& sub_meshes, const List<Shared<Material>>& materials, bool opaque)
+{
+    if (!Check(tiles_.length() <= 0xffff, "Hex Tile Set", "Too many tiles")) return 0;
+
+    Vector3 side_normals[6];
+    for (uint i = 0; i < 6; i++)
+    {
+        const float angle = i * 3.14159265f / 3.0f;
+        side_normals[i] = Vector3(std::cos(angle), std::sin(angle), 0.0f);
+    }
+
+    const float tolerance = apothem_ * hex_side_tolerance;
+    const auto get_point_sides = [&](const Vector3& pos) -> uint {
+        uint sides = 0;
+        for (uint i = 0; i < 6; i++)
+        {
+            if (Math::abs(pos.x * side_normals[i].x + pos.y * side_normals[i].y - apothem_) <= tolerance) sides |= 1 << i;
+        }
+        if (Math::abs(pos.z - height_) <= tolerance) sides |= 1 << side_top;
+        if (Math::abs(pos.z) <= tolerance) sides |= 1 << side_bottom;
+        return sides;
+    };
+
+    TileType tile;
+    tile.opaque = opaque;
+
+    for (uint i = 0; i < sub_meshes.length(); i++)
+    {
+        const auto& sub_mesh = sub_meshes[i];
+        const Shared<Material> material = i < materials.length() ? materials[i] : nullptr;
+
+        uint material_index = 0;
+        while (material_index < materials_.length() && materials_[material_index] != material) material_index++;
+        if (material_index == materials_.length())
+        {
+            materials_.add(material);
+        }
+
+        // triangle belongs to side only if all of its corners lie on it
+        List<uint> remaps[side_count];
+        Piece pieces[side_count];
+        for (uint t = 0; t + 2 < sub_mesh.indices.length(); t += 3)
+        {
+            const uint corners[3] = {sub_mesh.indices[t], sub_mesh.indices[t + 1], sub_mesh.indices[t + 2]};
+            const uint common = get_point_sides(sub_mesh.vertices[corners[0]].pos) & get_point_sides(sub_mesh.vertices[corners[1]].pos) & get_point_sides(sub_mesh.vertices[corners[2]].pos);
+
+            uint side = side_inner;
+            for (uint s = 0; s < side_inner; s++)
+            {
+                if (common & (1 << s))
+                {
+                    side = s;
+                    break;
+                }
+            }
+
+            auto& piece = pieces[side];
+            auto& remap = remaps[side];
+            if (remap.length() == 0)
+            {
+                remap = List<uint>(sub_mesh.vertices.length(), unmapped_vertex);
+            }
+
+            for (const auto corner : corners)
+            {
+                if (remap[corner] == unmapped_vertex)
+                {
+                    remap[corner] = piece.vertices.length();
+                    piece.vertices.add(sub_mesh.vertices[corner]);
+                }
+                piece.indices.add(remap[corner]);
+            }
+        }
+
+        for (uint s = 0; s < side_count; s++)
+        {
+            if (pieces[s].indices.length() == 0) continue;
+
+            pieces[s].material = material_index;
+            tile.sides[s].add(pieces[s]);
+        }
+    }
+
+    tiles_.add(tile);
+    return static_cast<byte16>(tiles_.length() - 1);
+}
+
+Vector3 HexTileSet::get_tile_position(int x, int y, int z) const
+{
+    // neighbours along x are at 0 degrees, along y at 60 degrees, both two apothems away
+    return Vector3((x + y * 0.5f) * apothem_ * 2.0f, y * 0.8660254f * apothem_ * 2.0f, z * height_);
+}
+
+HexChunk::HexChunk(const String& name, const Shared<const HexTileSet>& tile_set, uint size_x, uint size_y, uint size_z)
+    : name_(String::format("%s#%u", name.c(), next_chunk_id++))
+    , tile_set_(tile_set)
+    , size_x_(size_x)
+    , size_y_(size_y)
+    , size_z_(size_z)
+    , tiles_(size_x * size_y * size_z, 0)
+    , layers_(size_z)
+    , dirty_layers_(size_z, true)
+{
+}
+
+byte16 HexChunk::get_tile(uint x, uint y, uint z) const
+{
+    return tiles_[get_index(x, y, z)];
+}
+
+void HexChunk::set_tile(uint x, uint y, uint z, byte16 tile)
+{
+    auto& slot = tiles_[get_index(x, y, z)];
+    if (slot == tile) return;
+
+    slot = tile;
+
+    // lateral neighbours are in the same layer, vertical ones are in adjacent layers
+    dirty_layers_[z] = true;
+    if (z > 0) dirty_layers_[z - 1] = true;
+    if (z + 1 < size_z_) dirty_layers_[z + 1] = true;
+}
+
+void HexChunk::update()
+{
+    if (building_) return;
+
+    List<uint> layers;
+    for (uint z = 0; z < size_z_; z++)
+    {
+        if (dirty_layers_[z])
+        {
+            layers.add(z);
+            dirty_layers_[z] = false;
+        }
+    }
+
+    if (layers.length() == 0) return;
+
+    building_ = true;
+
+    // worker reads copy of tiles, layers_ are not touched by main thread until build is applied
+    const auto self = shared_from_this();
+    const auto tiles = MakeShared<List<byte16>>(tiles_);
+    ThreadPool::get().enqueue([self, tiles, layers]() {
+        const auto& tile_set = *self->tile_set_;
+        const uint material_count = tile_set.materials_.length();
+
+        auto geometry = MakeShared<List<LayerGeometry>>(layers.length());
+        ThreadPool::get().parallel_for(layers.length(), [&](uint begin, uint end) {
+            for (uint i = begin; i < end; i++)
+            {
+                build_layer(tile_set, *tiles, self->size_x_, self->size_y_, self->size_z_, layers[i], (*geometry)[i]);
+            }
+        });
+
+        // merge all layers bottom to top, so that change in a layer leaves geometry below it unchanged for partial upload
+        auto merged = MakeShared<List<StaticMesh::SubMesh>>(material_count);
+        for (uint z = 0, changed = 0; z < self->size_z_; z++)
+        {
+            const LayerGeometry* layer = &self->layers_[z];
+            if (changed < layers.length() && layers[changed] == z)
+            {
+                layer = &(*geometry)[changed++];
+            }
+
+            for (uint m = 0; m < layer->length(); m++)
+            {
+                (*merged)[m].add((*layer)[m].vertices, (*layer)[m].indices);
+            }
+        }
+
+        Game::call_on_main_thread([self, layers, geometry, merged]() {
+            self->apply(layers, *geometry, *merged);
+        }, MainThreadPriority::Low);
+    });
+}
+
+void HexChunk::build_layer(const HexTileSet& tile_set, const List<byte16>& tiles, uint size_x, uint size_y, uint size_z, uint z, LayerGeometry& out_geometry)
+{
+    out_geometry = LayerGeometry(tile_set.materials_.length());
+
+    const auto get_neighbour = [&](int x, int y, int neighbour_z) -> byte16 {
+        // outside of chunk is treated as empty, so chunk borders stay closed
+        if (x < 0 || y < 0 || neighbour_z < 0 || x >= (int)size_x || y >= (int)size_y || neighbour_z >= (int)size_z) return 0;
+        return tiles[x + size_x * (y + size_y * neighbour_z)];
+    };
+
+    for (uint y = 0; y < size_y; y++)
+    {
+        for (uint x = 0; x < size_x; x++)
+        {
+            const byte16 id = tiles[x + size_x * (y + size_y * z)];
+            if (id == 0 || id >= tile_set.tiles_.length()) continue;
+
+            const auto& tile = tile_set.tiles_[id];
+            const Vector3 offset = tile_set.get_tile_position(x, y, z);
+
+            for (uint side = 0; side < HexTileSet::side_count; side++)
+            {
+                if (tile.sides[side].length() == 0) continue;
+
+                if (side != HexTileSet::side_inner)
+                {
+                    byte16 neighbour;
+                    if (side < 6)
+                        neighbour = get_neighbour(x + hex_neighbours[side][0], y + hex_neighbours[side][1], z);
+                    else
+                        neighbour = get_neighbour(x, y, side == HexTileSet::side_top ? z + 1 : (int)z - 1);
+
+                    if (neighbour != 0 && neighbour < tile_set.tiles_.length() && (tile_set.tiles_[neighbour].opaque || neighbour == id)) continue;
+                }
+
+                for (const auto& piece : tile.sides[side])
+                {
+                    auto& target = out_geometry[piece.material];
+                    const uint base = target.vertices.length();
+
+                    for (auto vertex : piece.vertices)
+                    {
+                        vertex.pos += offset;
+                        target.vertices.add(vertex);
+                    }
+                    for (const auto index : piece.indices)
+                    {
+                        target.indices.add(base + index);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void HexChunk::apply(const List<uint>& layers, const List<LayerGeometry>& geometry, const List<StaticMesh::SubMesh>& merged)
+{
+    for (uint i = 0; i < layers.length(); i++)
+    {
+        layers_[layers[i]] = geometry[i];
+    }
+
+    if (!mesh_)
+    {
+        mesh_ = DynamicMesh::create(name_, merged.length());
+        if (!mesh_)
+        {
+            // geometry is kept, layers are built again on next update
+            print_error("Hex Chunk", "Failed to create mesh %s", name_.c());
+            for (const auto layer : layers)
+            {
+                dirty_layers_[layer] = true;
+            }
+
+            building_ = false;
+            return;
+        }
+    }
+
+    for (uint m = 0; m < merged.length(); m++)
+    {
+        mesh_->set_sub_mesh(m, merged[m].vertices, merged[m].indices);
+    }
+
+    building_ = false;
+
+    if (on_rebuilt_)
+    {
+        on_rebuilt_();
+    }
+}
@@ -0,0 +1,486 @@
+#include "hexa_engine/InstancedMeshSet.h"
+
+#include "hexa_engine/Game.h"
+#include "hexa_engine/Material.h"
+#include "hexa_engine/Shader.h"
+#include "hexa_engine/StaticMesh.h"
+#include "hexa_engine/VertexQuantization.h"
+#include "hexa_engine/World.h"
+#include "hexa_engine/WorldCells.h"
+
+#include <OgreInstanceBatch.h>
+#include <OgreInstanceManager.h>
+#include <OgreInstancedEntity.h>
+#include <OgreMesh.h>
+#include <OgreSceneManager.h>
+#include <base_lib/Assert.h>
+#include <base_lib/Logger.h>
+#include <base_lib/Math.h>
+#include <bit>
+#include <cmath>
+
+// instances per hardware batch inside one cell
+const static uint instanced_set_batch_size = 1024;
+
+static uint next_set_id = 0;
+
+static void set_batches_visible(Ogre::InstanceManager* manager, bool visible)
+{
+    auto materials = manager->getInstanceBatchMapIterator();
+    while (materials.hasMoreElements())
+    {
+        auto batches = manager->getInstanceBatchIterator(materials.peekNextKey());
+        materials.moveNext();
+
+        while (batches.hasMoreElements())
+        {
+            batches.getNext()->setVisible(visible);
+        }
+    }
+}
+
+InstancedMeshSet::InstancedMeshSet(World* world, const Shared<StaticMesh>& mesh, const List<Shared<Material>>& materials)
+    : world_(world)
+    , mesh_(mesh)
+    , materials_(materials)
+    , sub_mesh_count_(mesh->ogre_mesh_->getNumSubMeshes())
+    , parameter_count_(InstanceParams::COUNT)
+    , id_(next_set_id++)
+{
+    materials_.resize(sub_mesh_count_);
+
+    // compact buffers can not be read by material without decode code, instances would come out garbled
+    const uint format_features = VertexQuantization::get_shader_features(mesh->get_vertex_format());
+    for (uint i = 0; i < sub_mesh_count_; i++)
+    {
+        const auto& material = materials_[i] ? materials_[i] : Game::get_basic_material();
+        if (format_features && !(material->get_supported_features() & format_features))
+        {
+            print_warning("Instanced Mesh Set", "Material of slot %i has no %s feature required by mesh %s", i, ShaderFeatures::get_name(std::countr_zero(format_features)).c(), mesh->name_.c());
+        }
+    }
+}
+
+InstancedMeshSet::~InstancedMeshSet()
+{
+    clear();
+    release();
+}
+
+uint InstancedMeshSet::add(const Transform& transform)
+{
+    const uint index = transforms_.length();
+
+    transforms_.add(transform);
+    instance_cells_.add(WorldCells::get_key(transform.location));
+    entities_.resize(entities_.length() + sub_mesh_count_);
+    for (uint i = 0; i < parameter_count_; i++)
+    {
+        parameters_.add(InstanceParams::get_default(i));
+    }
+    pending_flags_.add(false);
+
+    mark_pending(index);
+
+    return index;
+}
+
+void InstancedMeshSet::add_many(const List<Transform>& transforms)
+{
+    const uint first = transforms_.length();
+
+    transforms_.resize(first + transforms.length());
+    instance_cells_.resize(first + transforms.length());
+    entities_.resize((first + transforms.length()) * sub_mesh_count_);
+    parameters_.resize((first + transforms.length()) * parameter_count_);
+    pending_flags_.resize(first + transforms.length(), false);
+
+    for (uint i = 0; i < transforms.length(); i++)
+    {
+        for (uint j = 0; j < parameter_count_; j++)
+        {
+            parameters_[(first + i) * parameter_count_ + j] = InstanceParams::get_default(j);
+        }
+
+        transforms_[first + i] = transforms[i];
+        instance_cells_[first + i] = WorldCells::get_key(transforms[i].location);
+        mark_pending(first + i);
+    }
+}
+
+void InstancedMeshSet::remove(uint index)
+{
+    if (!Check(index < transforms_.length(), "Instanced Mesh Set", "Instance %i is out of range", index)) return;
+
+    retire_entities(index);
+
+    const uint last = transforms_.length() - 1;
+    if (index != last)
+    {
+        transforms_[index] = transforms_[last];
+        instance_cells_[index] = instance_cells_[last];
+        for (uint i = 0; i < sub_mesh_count_; i++)
+        {
+            entities_[index * sub_mesh_count_ + i] = entities_[last * sub_mesh_count_ + i];
+        }
+
+        for (uint i = 0; i < parameter_count_; i++)
+        {
+            parameters_[index * parameter_count_ + i] = parameters_[last * parameter_count_ + i];
+        }
+
+        // entities moved along with the instance, pending change has to follow it too
+        pending_flags_[index] = false;
+        if (pending_flags_[last])
+        {
+            mark_pending(index);
+        }
+    }
+
+    transforms_.remove_at(last);
+    instance_cells_.remove_at(last);
+    entities_.resize(last * sub_mesh_count_);
+    parameters_.resize(last * parameter_count_);
+    pending_flags_.remove_at(last);
+}
+
+void InstancedMeshSet::update(uint index, const Transform& transform)
+{
+    if (!Check(index < transforms_.length(), "Instanced Mesh Set", "Instance %i is out of range", index)) return;
+
+    transforms_[index] = transform;
+    mark_pending(index);
+}
+
+void InstancedMeshSet::update_many(uint first, const List<Transform>& transforms)
+{
+    if (!Check(first + transforms.length() <= transforms_.length(), "Instanced Mesh Set", "Instance range is out of range")) return;
+
+    for (uint i = 0; i < transforms.length(); i++)
+    {
+        update(first + i, transforms[i]);
+    }
+}
+
+void InstancedMeshSet::clear()
+{
+    for (uint i = 0; i < transforms_.length(); i++)
+    {
+        retire_entities(i);
+    }
+
+    transforms_.clear();
+    instance_cells_.clear();
+    entities_.clear();
+    parameters_.clear();
+    pending_flags_.clear();
+    pending_.clear();
+}
+
+void InstancedMeshSet::set_parameter(uint index, uint parameter, const Quaternion& value)
+{
+    if (!Check(index < transforms_.length(), "Instanced Mesh Set", "Instance %i is out of range", index)) return;
+    if (!Check(parameter < parameter_count_, "Instanced Mesh Set", "Parameter %i is out of range", parameter)) return;
+
+    parameters_[index * parameter_count_ + parameter] = value;
+    mark_pending(index);
+}
+
+void InstancedMeshSet::set_tint(uint index, const Color& tint)
+{
+    Quaternion value;
+    value.x = tint.r / 255.0f;
+    value.y = tint.g / 255.0f;
+    value.z = tint.b / 255.0f;
+    value.w = tint.a / 255.0f;
+    set_parameter(index, InstanceParams::TINT, value);
+}
+
+void InstancedMeshSet::set_variation(uint index, uint variation)
+{
+    Quaternion value = InstanceParams::get_default(InstanceParams::VARIATION);
+    value.x = static_cast<float>(variation);
+    set_parameter(index, InstanceParams::VARIATION, value);
+}
+
+uint InstancedMeshSet::get_visible_cell_count() const
+{
+    uint result = 0;
+    for (const auto& cell : cells_)
+    {
+        if (cell.value.visible && cell.value.count > 0) result++;
+    }
+
+    return result;
+}
+
+InstancedMeshSet::Cell& InstancedMeshSet::get_or_create_cell(std::uint64_t key)
+{
+    auto& cell = cells_[key];
+    if (cell.managers.length() == 0)
+    {
+        for (uint i = 0; i < sub_mesh_count_; i++)
+        {
+            cell.managers.add(world_->create_instance_manager(String::format("instanced_set_%u_%llu_%u", id_, static_cast<unsigned long long>(key), i), mesh_, i, instanced_set_batch_size));
+        }
+    }
+
+    return cell;
+}
+
+void InstancedMeshSet::create_entities(uint index)
+{
+    const auto key = instance_cells_[index];
+    auto& cell = get_or_create_cell(key);
+
+    if (cell.count == 0)
+    {
+        cell.origin = WorldCells::get_origin(transforms_[index].location);
+    }
+
+    const uint features = ShaderFeatures::INSTANCING | VertexQuantization::get_shader_features(mesh_->get_vertex_format());
+    for (uint i = 0; i < sub_mesh_count_; i++)
+    {
+        const auto& material = materials_[i] ? materials_[i] : Game::get_basic_material();
+        auto entity = cell.managers[i]->createInstancedEntity(material->get_ogre_material(features));
+
+        // quantization box is per mesh and batch only holds this mesh
+        if (mesh_->get_vertex_format() == VertexFormat::Quantized)
+        {
+            entity->_getOwner()->setCustomParameter(VertexQuantization::center_parameter, Ogre::Vector4(cast_object<Ogre::Vector3>(mesh_->get_quantization_center()), 0.0f));
+            entity->_getOwner()->setCustomParameter(VertexQuantization::extents_parameter, Ogre::Vector4(cast_object<Ogre::Vector3>(mesh_->get_quantization_extents()), 0.0f));
+        }
+        if (i > 0)
+        {
+            entities_[index * sub_mesh_count_]->shareTransformWith(entity);
+        }
+
+        entities_[index * sub_mesh_count_ + i] = entity;
+    }
+
+    cell.count++;
+    cell.dirty = true;
+
+    apply_transform(index);
+    apply_parameters(index);
+}
+
+void InstancedMeshSet::destroy_entities(uint index)
+{
+    for (uint i = 0; i < sub_mesh_count_; i++)
+    {
+        auto& entity = entities_[index * sub_mesh_count_ + i];
+        if (entity)
+        {
+            world_->manager_->destroyInstancedEntity(entity);
+            entity = nullptr;
+        }
+    }
+
+    if (auto cell = cells_.find(instance_cells_[index]))
+    {
+        cell->count--;
+        cell->dirty = true;
+        cell->fragmented = true;
+    }
+}
+
+void InstancedMeshSet::retire_entities(uint index)
+{
+    if (!entities_[index * sub_mesh_count_]) return;
+
+    for (uint i = 0; i < sub_mesh_count_; i++)
+    {
+        auto& entity = entities_[index * sub_mesh_count_ + i];
+        retired_entities_.add(entity);
+        entity = nullptr;
+    }
+
+    retired_cells_.add(instance_cells_[index]);
+}
+
+void InstancedMeshSet::mark_pending(uint index)
+{
+    // headless game keeps only transforms and parameters
+    if (!world_ || Game::is_headless() || pending_flags_[index]) return;
+
+    pending_flags_[index] = true;
+    pending_.add(index);
+}
+
+void InstancedMeshSet::sync_instance(uint index)
+{
+    const auto key = WorldCells::get_key(transforms_[index].location);
+    if (entities_[index * sub_mesh_count_] && key != instance_cells_[index])
+    {
+        // batches belong to cell, so instance moves into batch of other cell
+        destroy_entities(index);
+    }
+
+    if (!entities_[index * sub_mesh_count_])
+    {
+        instance_cells_[index] = key;
+        create_entities(index);
+        return;
+    }
+
+    apply_transform(index);
+    apply_parameters(index);
+    if (auto cell = cells_.find(key))
+    {
+        cell->dirty = true;
+    }
+}
+
+void InstancedMeshSet::apply_transform(uint index)
+{
+    // entities are not attached to scene nodes, each one carries own transform
+    const auto& transform = transforms_[index];
+    auto entity = entities_[index * sub_mesh_count_];
+    if (!entity) return;
+
+    entity->setPosition(cast_object<Ogre::Vector3>(transform.location), false);
+    entity->setOrientation(Ogre::Quaternion(transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z), false);
+    entity->setScale(cast_object<Ogre::Vector3>(transform.scale), true);
+}
+
+void InstancedMeshSet::apply_parameters(uint index)
+{
+    for (uint i = 0; i < sub_mesh_count_; i++)
+    {
+        auto entity = entities_[index * sub_mesh_count_ + i];
+        if (!entity) continue;
+
+        for (uint j = 0; j < parameter_count_; j++)
+        {
+            entity->setCustomParam(j, cast_object<Ogre::Vector4>(parameters_[index * parameter_count_ + j]));
+        }
+    }
+}
+
+void InstancedMeshSet::flush(const Vector3* camera_location)
+{
+    if (!world_) return;
+
+    for (uint i = 0; i < retired_entities_.length(); i++)
+    {
+        world_->manager_->destroyInstancedEntity(retired_entities_[i]);
+    }
+    retired_entities_.clear();
+
+    for (const auto& key : retired_cells_)
+    {
+        if (auto cell = cells_.find(key))
+        {
+            cell->count--;
+            cell->dirty = true;
+            cell->fragmented = true;
+        }
+    }
+    retired_cells_.clear();
+
+    for (const auto index : pending_)
+    {
+        // instance may have been removed after it was marked
+        if (index < transforms_.length() && pending_flags_[index])
+        {
+            pending_flags_[index] = false;
+            sync_instance(index);
+        }
+    }
+    pending_.clear();
+
+    // instances may stick out of their cell by the size of the mesh
+    const float margin = mesh_->ogre_mesh_->getBoundingSphereRadius();
+    List<std::uint64_t> empty_cells;
+
+    for (auto& entry : cells_)
+    {
+        auto& cell = entry.value;
+
+        if (cell.count == 0)
+        {
+            for (auto manager : cell.managers)
+            {
+                world_->manager_->destroyInstanceManager(manager);
+            }
+
+            empty_cells.add(entry.key);
+            continue;
+        }
+
+        bool visible = cell.visible;
+        if (camera_location && cull_distance_ > 0.0f)
+        {
+            const Vector3 nearest(
+                Math::clamp(camera_location->x, cell.origin.x - margin, cell.origin.x + WorldCells::cell_size + margin),
+                Math::clamp(camera_location->y, cell.origin.y - margin, cell.origin.y + WorldCells::cell_size + margin),
+                Math::clamp(camera_location->z, cell.origin.z - margin, cell.origin.z + WorldCells::cell_size + margin));
+            visible = (nearest - *camera_location).magnitude() <= cull_distance_;
+        }
+        else
+        {
+            visible = true;
+        }
+
+        if (cell.dirty)
+        {
+            for (auto manager : cell.managers)
+            {
+                // removed instances leave holes in batches, packing them back keeps batch count low
+                if (cell.fragmented)
+                {
+                    manager->defragmentBatches(false);
+                }
+
+                // static batches are not rewritten every frame, this uploads all of them at once
+                manager->setBatchesAsStaticAndUpdate(true);
+
+                // new batches may have been created
+                set_batches_visible(manager, visible);
+            }
+
+            cell.dirty = false;
+            cell.fragmented = false;
+            cell.visible = visible;
+        }
+        else if (visible != cell.visible)
+        {
+            for (auto manager : cell.managers)
+            {
+                set_batches_visible(manager, visible);
+            }
+
+            cell.visible = visible;
+        }
+    }
+
+    for (const auto& key : empty_cells)
+    {
+        cells_.remove(key);
+    }
+}
+
+void InstancedMeshSet::release()
+{
+    if (!world_) return;
+
+    if (world_->manager_)
+    {
+        for (const auto& cell : cells_)
+        {
+            for (auto manager : cell.value.managers)
+            {
+                world_->manager_->destroyInstanceManager(manager);
+            }
+        }
+    }
+
+    // entities were destroyed with their managers
+    cells_.clear();
+    entities_.clear();
+    retired_entities_.clear();
+    retired_cells_.clear();
+    pending_.clear();
+    world_ = nullptr;
+}
@@ -0,0 +1,109 @@
+#include "hexa_engine/MainThreadQueue.h"
+
+#include <chrono>
+
+MainThreadTask::MainThreadTask(MainThreadTask&& other) noexcept
+    : ops_(other.ops_)
+{
+    if (ops_)
+    {
+        ops_->move(other.storage_, storage_);
+        other.ops_ = nullptr;
+    }
+}
+
+MainThreadTask& MainThreadTask::operator=(MainThreadTask&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (ops_)
+        {
+            ops_->destroy(storage_);
+        }
+
+        ops_ = other.ops_;
+        if (ops_)
+        {
+            ops_->move(other.storage_, storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    return *this;
+}
+
+MainThreadTask::~MainThreadTask()
+{
+    if (ops_)
+    {
+        ops_->destroy(storage_);
+    }
+}
+
+void MainThreadTask::operator()()
+{
+    ops_->invoke(storage_);
+}
+
+void MainThreadQueue::post(MainThreadTask&& task, MainThreadPriority priority)
+{
+    std::lock_guard lock(mutex_);
+    lanes_[static_cast<uint>(priority)].posted.push_back(std::move(task));
+}
+
+uint MainThreadQueue::run(double budget)
+{
+    // take everything posted so far, calls posted while running wait for next frame
+    std::vector<MainThreadTask> taken[lane_count];
+    {
+        std::lock_guard lock(mutex_);
+        for (uint i = 0; i < lane_count; i++)
+        {
+            taken[i].swap(lanes_[i].posted);
+        }
+    }
+
+    for (uint i = 0; i < lane_count; i++)
+    {
+        for (auto& task : taken[i])
+        {
+            lanes_[i].ready.push_back(std::move(task));
+        }
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(budget));
+
+    uint count = 0;
+    for (auto& lane : lanes_)
+    {
+        bool first = true;
+        while (!lane.ready.empty())
+        {
+            // one call per lane is always allowed, otherwise low priority work would never run while higher lanes are busy
+            if (!first && budget > 0.0 && Clock::now() >= deadline) break;
+
+            auto task = std::move(lane.ready.front());
+            lane.ready.pop_front();
+            task();
+
+            first = false;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+uint MainThreadQueue::get_pending_count()
+{
+    std::lock_guard lock(mutex_);
+
+    size_t result = 0;
+    for (const auto& lane : lanes_)
+    {
+        result += lane.posted.size() + lane.ready.size();
+    }
+
+    return static_cast<uint>(result);
+}
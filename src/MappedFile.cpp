@@ -0,0 +1,59 @@
+#include "hexa_engine/MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+#else
+    if (data_) munmap(const_cast<byte*>(data_), size_);
+#endif
+}
+
+Shared<MappedFile> MappedFile::open(const Path& path)
+{
+    Shared<MappedFile> result = Shared<MappedFile>(new MappedFile());
+
+#ifdef _WIN32
+    const HANDLE file = CreateFileA(path.get_absolute_string().c(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+    result->file_ = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) return nullptr;
+    result->size_ = static_cast<size_t>(size.QuadPart);
+
+    result->mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!result->mapping_) return nullptr;
+
+    result->data_ = static_cast<const byte*>(MapViewOfFile(result->mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!result->data_) return nullptr;
+#else
+    const int file = ::open(path.get_absolute_string().c(), O_RDONLY);
+    if (file < 0) return nullptr;
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        close(file);
+        return nullptr;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) return nullptr;
+
+    result->data_ = static_cast<const byte*>(data);
+    result->size_ = static_cast<size_t>(file_stat.st_size);
+#endif
+
+    return result;
+}
@@ -2,13 +2,29 @@
 
 #include "hexa_engine/Game.h"
 #include "hexa_engine/Module.h"
+#include "hexa_engine/Shader.h"
 #include "hexa_engine/Texture.h"
 
 #include <OgreMaterial.h>
 #include <OgreTechnique.h>
+#include <OgreTextureUnitState.h>
+
+static void bind_texture(Ogre::TextureUnitState* unit, const Shared<Texture>& texture) {
+    unit->setTexture(texture ? texture->ogre_texture_ : Game::get_uv_test_texture()->ogre_texture_);
+}
+
+Quaternion InstanceParams::get_default(uint parameter) {
+    Quaternion result;
+    const float value = parameter == TINT ? 1.0f : 0.0f;
+    result.x = value;
+    result.y = value;
+    result.z = value;
+    result.w = value;
+    return result;
+}
 
 uint Material::get_textures_count() const {
-    return ogre_material_->getTechnique(0)->getPass(0)->getNumTextureUnitStates();
+    return textures_.length();
 }
 
 Shared<Texture> Material::get_texture(uint index) const {
@@ -22,5 +38,82 @@ void Material::set_texture(const Shared<Texture>& texture, uint index) {
 
     textures_[index] = texture;
 
-    ogre_material_->getTechnique(0)->getPass(0)->getTextureUnitState(index)->setTexture(texture ? Game::get_uv_test_texture()->ogre_texture_ : texture->ogre_texture_);
+    bind_texture(ogre_material_->getTechnique(0)->getPass(0)->getTextureUnitState(index), texture);
+
+    // feature and texture variants are copies of base material and have to follow it, except units replaced by instances
+    for (const auto& variant : variants_) {
+        bind_texture(variant.value->getTechnique(0)->getPass(0)->getTextureUnitState(index), texture);
+    }
+
+    for (const auto& variant : texture_variants_) {
+        if (variant.value.textures.contains(index)) continue;
+
+        bind_texture(variant.value.material->getTechnique(0)->getPass(0)->getTextureUnitState(index), texture);
+    }
+}
+
+uint Material::get_supported_features() const {
+    return (vertex_shader_ ? vertex_shader_->get_features() : 0) | (fragment_shader_ ? fragment_shader_->get_features() : 0);
+}
+
+bool Material::is_instanced() const {
+    return get_supported_features() & ShaderFeatures::INSTANCING;
+}
+
+uint Material::get_variant_features(uint features) const {
+    return (features & get_supported_features()) | features_;
+}
+
+Shared<Ogre::Material> Material::get_ogre_material(uint features) {
+    features = get_variant_features(features);
+    if (features == features_) return ogre_material_;
+
+    if (const auto variant = variants_.find(features)) {
+        return *variant;
+    }
+
+    const auto vertex_program = vertex_shader_->get_program(features);
+    const auto fragment_program = fragment_shader_->get_program(features);
+    if (!vertex_program || !fragment_program) {
+        // compile error is already reported, rendering without feature is better than not rendering at all
+        variants_[features] = ogre_material_;
+        return ogre_material_;
+    }
+
+    Shared<Ogre::Material> variant = ogre_material_->clone(String::format("%s@%x", ogre_material_->getName().c_str(), features).c(), ogre_material_->getGroup());
+    const auto pass = variant->getTechnique(0)->getPass(0);
+    pass->setGpuProgram(Ogre::GPT_VERTEX_PROGRAM, vertex_program);
+    pass->setGpuProgram(Ogre::GPT_FRAGMENT_PROGRAM, fragment_program);
+    variant->load();
+
+    variants_[features] = variant;
+    return variant;
+}
+
+Shared<Ogre::Material> Material::get_texture_variant(const Map<uint, Shared<Texture>>& textures, uint features) {
+    features = get_variant_features(features);
+    const auto source = get_ogre_material(features);
+    if (!source) return nullptr;
+
+    String key = String::format("%x", features);
+    for (const auto& texture : textures) {
+        key += String::format(":%u=%s", texture.key, texture.value ? texture.value->ogre_texture_->getName().c_str() : "");
+    }
+
+    if (const auto variant = texture_variants_.find(key)) {
+        return variant->material;
+    }
+
+    // passes, programs and shader constants stay as in source, only texture units differ
+    Shared<Ogre::Material> variant = source->clone(String::format("%s#%u", source->getName().c_str(), texture_variants_.size()).c(), source->getGroup());
+    const auto pass = variant->getTechnique(0)->getPass(0);
+    for (const auto& texture : textures) {
+        if (texture.key >= pass->getNumTextureUnitStates()) continue;
+
+        bind_texture(pass->getTextureUnitState(texture.key), texture.value);
+    }
+    variant->load();
+
+    texture_variants_[key] = {variant, textures};
+    return variant;
 }
@@ -0,0 +1,73 @@
+#include "hexa_engine/MaterialInstance.h"
+
+#include <base_lib/Assert.h>
+
+MaterialInstance::MaterialInstance(const Shared<Material>& parent)
+    : parent_(parent) {
+    if (!Check(parent_ != nullptr, "Material", "Material instance requires parent")) return;
+
+    if (const auto parent_instance = cast<MaterialInstance>(parent_)) {
+        parent_ = parent_instance->parent_;
+        texture_overrides_ = parent_instance->texture_overrides_;
+        parameters_ = parent_instance->parameters_;
+    }
+
+    id_ = parent_->id_;
+    vertex_shader_ = parent_->vertex_shader_;
+    fragment_shader_ = parent_->fragment_shader_;
+    features_ = parent_->features_;
+    update_ogre_materials();
+}
+
+uint MaterialInstance::get_textures_count() const {
+    return parent_ ? parent_->get_textures_count() : 0;
+}
+
+Shared<Texture> MaterialInstance::get_texture(uint index) const {
+    if (const auto texture = texture_overrides_.find(index)) return *texture;
+
+    return parent_ ? parent_->get_texture(index) : nullptr;
+}
+
+void MaterialInstance::set_texture(const Shared<Texture>& texture, uint index) {
+    if (!parent_ || index >= get_textures_count()) return;
+
+    texture_overrides_[index] = texture;
+    update_ogre_materials();
+}
+
+void MaterialInstance::reset_texture(uint index) {
+    if (!texture_overrides_.contains(index)) return;
+
+    texture_overrides_.remove(index);
+    update_ogre_materials();
+}
+
+bool MaterialInstance::get_parameter(uint index, Quaternion& out_value) const {
+    if (const auto value = parameters_.find(index)) {
+        out_value = *value;
+        return true;
+    }
+
+    return false;
+}
+
+void MaterialInstance::set_parameter(uint index, const Quaternion& value) {
+    parameters_[index] = value;
+}
+
+void MaterialInstance::reset_parameter(uint index) {
+    parameters_.remove(index);
+}
+
+void MaterialInstance::update_ogre_materials() {
+    // textures are not copied, parent may change them later
+    ogre_material_ = get_ogre_material();
+}
+
+Shared<Ogre::Material> MaterialInstance::get_ogre_material(uint features) {
+    // variants live in parent, so that instances with same overrides share them
+    if (texture_overrides_.size() == 0) return parent_->get_ogre_material(features);
+
+    return parent_->get_texture_variant(texture_overrides_, features);
+}
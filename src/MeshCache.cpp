@@ -0,0 +1,117 @@
+#include "hexa_engine/MeshCache.h"
+
+bool MeshLoad::is_done() const
+{
+    std::lock_guard lock(mutex_);
+    return done_;
+}
+
+Shared<StaticMesh> MeshLoad::get_mesh() const
+{
+    std::lock_guard lock(mutex_);
+    return mesh_;
+}
+
+void MeshLoad::then(const Callback& callback)
+{
+    std::unique_lock lock(mutex_);
+    if (!done_)
+    {
+        callbacks_.add(callback);
+        return;
+    }
+
+    const auto mesh = mesh_;
+    lock.unlock();
+
+    callback(mesh);
+}
+
+Shared<StaticMesh> MeshLoad::wait() const
+{
+    std::unique_lock lock(mutex_);
+    done_condition_.wait(lock, [this]() { return done_; });
+    return mesh_;
+}
+
+void MeshLoad::prepare(const Upload& upload)
+{
+    {
+        std::lock_guard lock(mutex_);
+        upload_ = upload;
+    }
+    done_condition_.notify_all();
+}
+
+Shared<StaticMesh> MeshLoad::complete()
+{
+    std::unique_lock lock(mutex_);
+    done_condition_.wait(lock, [this]() { return done_ || upload_; });
+    if (done_) return mesh_;
+
+    // taken under lock, so that upload runs once even if both sync and async load get here
+    const Upload upload = std::move(upload_);
+    upload_ = nullptr;
+    lock.unlock();
+
+    finish(upload());
+    return get_mesh();
+}
+
+void MeshLoad::finish(const Shared<StaticMesh>& mesh)
+{
+    List<Callback> callbacks;
+    {
+        std::lock_guard lock(mutex_);
+        if (done_) return;
+
+        done_ = true;
+        mesh_ = mesh;
+        callbacks = callbacks_;
+        callbacks_.clear();
+    }
+    done_condition_.notify_all();
+
+    for (const auto& callback : callbacks)
+    {
+        callback(mesh);
+    }
+}
+
+Shared<MeshLoad> MeshCache::find(const String& key) const
+{
+    std::lock_guard lock(mutex_);
+    if (const auto found = loads_.find(key))
+    {
+        return *found;
+    }
+
+    return nullptr;
+}
+
+Shared<MeshLoad> MeshCache::find_or_add(const String& key, bool& out_created)
+{
+    std::lock_guard lock(mutex_);
+    if (const auto found = loads_.find(key))
+    {
+        out_created = false;
+        return *found;
+    }
+
+    out_created = true;
+    const auto load = MakeShared<MeshLoad>();
+    loads_[key] = load;
+    return load;
+}
+
+void MeshCache::remove(const String& key)
+{
+    std::lock_guard lock(mutex_);
+    loads_.remove(key);
+}
+
+void MeshCache::clear()
+{
+    std::lock_guard lock(mutex_);
+    loads_.clear();
+}
@@ -3,21 +3,44 @@
 #include "hexa_engine/Entity.h"
 #include "hexa_engine/Game.h"
 #include "hexa_engine/Material.h"
+#include "hexa_engine/MaterialInstance.h"
+#include "hexa_engine/Shader.h"
 #include "hexa_engine/StaticMesh.h"
+#include "hexa_engine/VertexQuantization.h"
 #include "hexa_engine/World.h"
 #include "hexa_engine/physics/Collision.h"
 
 #include <OgreEntity.h>
+#include <OgreInstanceBatch.h>
 #include <OgreInstancedEntity.h>
 #include <OgreMaterialManager.h>
 #include <OgreMesh.h>
 #include <OgreSceneManager.h>
 #include <OgreSceneNode.h>
 #include <OgreSubEntity.h>
+#include <base_lib/Assert.h>
+#include <base_lib/Logger.h>
+#include <bit>
 #include <reactphysics3d/body/RigidBody.h>
 #include <reactphysics3d/collision/Collider.h>
 #include <reactphysics3d/engine/PhysicsWorld.h>
 
+// ogre objects are not touched while pipelined tick runs, change is delayed until frame is published
+template<typename F>
+static void run_render_command(const MeshComponent* component, F&& func)
+{
+    if (const auto owner = component->get_owner())
+    {
+        if (const auto world = owner->get_world())
+        {
+            world->run_render_command(std::forward<F>(func));
+            return;
+        }
+    }
+
+    func();
+}
+
 MeshComponent::MeshComponent(const Shared<StaticMesh>& mesh, const List<Shared<Material>>& materials)
     : mesh_(mesh)
     , materials_(materials)
@@ -70,6 +93,7 @@ void MeshComponent::on_destroy()
                 destroy_mesh(owner, world);
             }
 
+            world->forget_body(rigid_body_);
             world->physics_world_->destroyRigidBody(rigid_body_);
         }
     }
@@ -140,32 +164,54 @@ void MeshComponent::set_material(const Shared<Material>& material, uint material
 
         materials_[material_slot] = material;
 
-        if (mesh_->instanced_)
+        if (Game::is_headless())
+            return;
+
+        run_render_command(this, [this, self = shared_from_this(), material_slot]() {
+            apply_material(material_slot);
+        });
+    }
+}
+
+void MeshComponent::apply_material(uint slot)
+{
+    if (!spawned_mesh_ || slot >= spawned_mesh_->ogre_mesh_->getNumSubMeshes())
+        return;
+
+    if (spawned_mesh_->instanced_)
+    {
+        auto old_entity = ogre_instanced_entities_[slot];
+
+        // batch is bound to ogre material, materials sharing it only differ in parameters and entity can stay
+        if (old_entity->_getOwner()->getMaterial() == get_valid_ogre_material(slot, ShaderFeatures::INSTANCING))
         {
-            auto manager = ogre_instanced_entities_[material_slot]->_getManager();
-            auto owner = ogre_instanced_entities_[material_slot]->getParentSceneNode();
+            apply_material_parameters(slot);
+            return;
+        }
 
-            owner->detachObject(ogre_instanced_entities_[material_slot]);
-            manager->destroyInstancedEntity(ogre_instanced_entities_[material_slot]);
+        auto manager = old_entity->_getManager();
+        auto node = old_entity->getParentSceneNode();
 
-            ogre_instanced_entities_[material_slot] = cached_instance_managers_[material_slot]->createInstancedEntity(get_valid_material(material_slot)->ogre_material_);
-            owner->attachObject(ogre_instanced_entities_[material_slot]);
+        node->detachObject(old_entity);
+        manager->destroyInstancedEntity(old_entity);
+        ogre_instanced_entities_[slot] = nullptr;
 
-            if (material_slot == 0)
+        create_instanced_entity(slot, node);
+    }
+    else
+    {
+        ogre_entity_->getSubEntity(slot)->setMaterial(get_valid_ogre_material(slot));
+        apply_material_parameters(slot);
+
+        if (static_batched_)
+        {
+            if (const auto owner = get_owner())
             {
-                for (uint i = 1; i < mesh_->ogre_mesh_->getNumSubMeshes(); i++)
+                if (const auto world = owner->get_world())
                 {
-                    ogre_instanced_entities_[0]->shareTransformWith(ogre_instanced_entities_[i]);
+                    world->mark_static_batch_dirty(this);
                 }
             }
-            else
-            {
-                ogre_instanced_entities_[0]->shareTransformWith(ogre_instanced_entities_[material_slot]);
-            }
-        }
-        else
-        {
-            ogre_entity_->getSubEntity(material_slot)->setMaterial(get_valid_material(material_slot)->ogre_material_);
         }
     }
 }
@@ -182,31 +228,67 @@ Shared<Material> MeshComponent::get_material(uint material_slot) const
 
 void MeshComponent::set_material_parameter(Quaternion value, uint material_slot, uint parameter_index)
 {
-    return;
     if (mesh_ && material_slot < mesh_->ogre_mesh_->getNumSubMeshes())
     {
-        if (mesh_->instanced_)
-        {
-            ogre_instanced_entities_[material_slot]->setCustomParam(parameter_index, cast_object<Ogre::Vector4>(value));
-        }
-        else
+        if (mesh_->instanced_ && !Check(parameter_index < InstanceParams::COUNT, "Mesh Component", "Instance parameter %i is out of range", parameter_index))
+            return;
+
+        if (material_parameters_.length() <= material_slot)
         {
-            ogre_entity_->getSubEntity(material_slot)->setCustomParameter(parameter_index, cast_object<Ogre::Vector4>(value));
+            material_parameters_.resize(material_slot + 1);
         }
+
+        material_parameters_[material_slot][parameter_index] = value;
+
+        if (Game::is_headless())
+            return;
+
+        run_render_command(this, [this, self = shared_from_this(), material_slot]() {
+            apply_material_parameters(material_slot);
+        });
     }
 }
 
+void MeshComponent::set_material_variant(uint variant, uint material_slot)
+{
+    Quaternion value;
+    value.x = static_cast<float>(variant);
+    value.y = 0.0f;
+    value.z = 0.0f;
+    value.w = 0.0f;
+    set_material_parameter(value, material_slot, InstanceParams::VARIATION);
+}
+
 void MeshComponent::set_body_type(PhysicalBodyType body_type)
 {
     if (body_type_ == body_type)
         return;
 
+    const bool was_static = body_type_ == PhysicalBodyType::Static;
     body_type_ = body_type;
 
     if (rigid_body_)
     {
         rigid_body_->setType((reactphysics3d::BodyType)body_type);
     }
+
+    if (static_batching_ && was_static != (body_type_ == PhysicalBodyType::Static))
+    {
+        respawn_mesh();
+    }
+}
+
+void MeshComponent::set_static_batching(bool state)
+{
+    if (static_batching_ == state)
+        return;
+
+    static_batching_ = state;
+
+    if (body_type_ == PhysicalBodyType::Static)
+    {
+        respawn_mesh();
+    }
 }
 
 void MeshComponent::set_visibility(bool state)
@@ -218,57 +300,124 @@ void MeshComponent::set_visibility(bool state)
 
     if (mesh_)
     {
-        update_visibility();
+        run_render_command(this, [this, self = shared_from_this()]() {
+            update_visibility();
+        });
     }
 }
 
 void MeshComponent::spawn_mesh(const Shared<Entity>& owner, const Shared<World>& world)
 {
-    if (mesh_->instanced_)
+    for (auto& collision : mesh_->collisions_)
     {
-        cached_instance_managers_ = world->get_or_create_instance_managers(mesh_, 10000, 0);
+        rigid_body_->addCollider(collision.collision->get_collider_shape(), reactphysics3d::Transform(cast_object<reactphysics3d::Vector3>(collision.location), cast_object<reactphysics3d::Quaternion>(collision.rotation)));
+    }
+
+    // headless game only simulates, nothing to draw
+    if (Game::is_headless())
+        return;
 
-        for (uint i = 0; i < mesh_->ogre_mesh_->getNumSubMeshes(); i++)
+    world->run_render_command([this, self = shared_from_this(), owner, world, mesh = mesh_]() {
+        spawn_render_objects(owner, world, mesh);
+    });
+}
+
+void MeshComponent::spawn_render_objects(const Shared<Entity>& owner, const Shared<World>& world, const Shared<StaticMesh>& mesh)
+{
+    spawned_mesh_ = mesh;
+
+    if (mesh->instanced_)
+    {
+        cached_instance_managers_ = world->acquire_instance_managers(mesh);
+        ogre_instanced_entities_ = List<Ogre::InstancedEntity*>(mesh->ogre_mesh_->getNumSubMeshes(), nullptr);
+
+        for (uint i = 0; i < mesh->ogre_mesh_->getNumSubMeshes(); i++)
         {
-            auto ent = cached_instance_managers_[i]->createInstancedEntity(get_valid_material(i)->ogre_material_);
-            if (i > 0)
-                ogre_instanced_entities_[0]->shareTransformWith(ent);
-            owner->scene_node_->attachObject(ent);
-            ogre_instanced_entities_.add(ent);
+            create_instanced_entity(i, owner->scene_node_);
         }
     }
     else
     {
-        ogre_entity_ = world->manager_->createEntity(mesh_->name_.c());
+        ogre_entity_ = world->manager_->createEntity(mesh->name_.c());
 
-        for (uint i = 0; i < materials_.length(); i++)
+        for (uint i = 0; i < ogre_entity_->getNumSubEntities(); i++)
         {
-            ogre_entity_->getSubEntity(i)->setMaterial(get_valid_material(i)->ogre_material_);
+            ogre_entity_->getSubEntity(i)->setMaterial(get_valid_ogre_material(i));
+            apply_material_parameters(i);
         }
 
-        owner->scene_node_->attachObject(ogre_entity_);
+        static_batched_ = static_batching_ && body_type_ == PhysicalBodyType::Static;
+
+        // static geometry rebuilds buffers assuming float3 positions and normals, compact ones would be broken
+        if (static_batched_ && mesh->get_vertex_format() != VertexFormat::Full)
+        {
+            print_warning("Mesh Component", "Mesh %s is not batched as static batching supports only full vertex format", mesh->name_.c());
+            static_batched_ = false;
+        }
+        if (static_batched_)
+        {
+            if (is_visible_)
+            {
+                world->add_static_batch_member(this, owner->get_transform());
+            }
+        }
+        else
+        {
+            owner->scene_node_->attachObject(ogre_entity_);
+        }
     }
 
-    if (!is_visible_)
+    if (!is_visible_ && !static_batched_)
     {
         update_visibility();
     }
+}
 
-    for (auto& collision : mesh_->collisions_)
+void MeshComponent::respawn_mesh()
+{
+    if (!mesh_ || !rigid_body_)
+        return;
+
+    if (const auto owner = get_owner())
     {
-        rigid_body_->addCollider(collision.collision->get_collider_shape(), reactphysics3d::Transform(cast_object<reactphysics3d::Vector3>(collision.location), cast_object<reactphysics3d::Quaternion>(collision.rotation)));
+        if (const auto world = owner->get_world())
+        {
+            destroy_mesh(owner, world);
+            spawn_mesh(owner, world);
+        }
     }
 }
 
 void MeshComponent::update_visibility()
 {
-    if (mesh_->instanced_)
+    if (!spawned_mesh_)
+        return;
+
+    if (spawned_mesh_->instanced_)
     {
-        for (uint i = 0; i < mesh_->ogre_mesh_->getNumSubMeshes(); i++)
+        for (uint i = 0; i < ogre_instanced_entities_.length(); i++)
         {
             ogre_instanced_entities_[i]->setInUse(is_visible_);
         }
     }
+    else if (static_batched_)
+    {
+        // hidden member is just left out of its batch
+        if (const auto owner = get_owner())
+        {
+            if (const auto world = owner->get_world())
+            {
+                if (is_visible_)
+                {
+                    world->add_static_batch_member(this, owner->get_transform());
+                }
+                else
+                {
+                    world->remove_static_batch_member(this);
+                }
+            }
+        }
+    }
     else
     {
         for (uint i = 0; i < ogre_entity_->getNumSubEntities(); i++)
@@ -280,7 +429,25 @@ void MeshComponent::update_visibility()
 
 void MeshComponent::destroy_mesh(const Shared<Entity>& owner, const Shared<World>& world)
 {
-    if (mesh_->instanced_)
+    while (rigid_body_->getNbColliders())
+    {
+        rigid_body_->removeCollider(rigid_body_->getCollider(0));
+    }
+
+    if (Game::is_headless())
+        return;
+
+    world->run_render_command([this, self = shared_from_this(), owner, world]() {
+        destroy_render_objects(owner, world);
+    });
+}
+
+void MeshComponent::destroy_render_objects(const Shared<Entity>& owner, const Shared<World>& world)
+{
+    if (!spawned_mesh_)
+        return;
+
+    if (spawned_mesh_->instanced_)
     {
         for (auto& instanced_entity : ogre_instanced_entities_)
         {
@@ -289,21 +456,125 @@ void MeshComponent::destroy_mesh(const Shared<Entity>& owner, const Shared<World
         }
 
         ogre_instanced_entities_.clear();
+        world->release_instance_managers(spawned_mesh_, cached_instance_managers_);
         cached_instance_managers_.clear();
     }
     else
     {
-        owner->scene_node_->detachObject(ogre_entity_);
+        if (static_batched_)
+        {
+            world->remove_static_batch_member(this);
+            static_batched_ = false;
+        }
+        else
+        {
+            owner->scene_node_->detachObject(ogre_entity_);
+        }
+
         world->manager_->destroyEntity(ogre_entity_);
+        ogre_entity_ = nullptr;
     }
 
-    while (rigid_body_->getNbColliders())
+    spawned_mesh_ = nullptr;
+}
+
+Shared<Material> MeshComponent::get_valid_material(uint slot)
+{
+    // materials may already belong to mesh which is not spawned yet
+    return slot < materials_.length() && materials_[slot] ? materials_[slot] : Game::get_basic_material();
+}
+
+Shared<Ogre::Material> MeshComponent::get_valid_ogre_material(uint slot, uint features)
+{
+    const auto material = get_valid_material(slot);
+
+    // compact buffers can not be read by material without decode code, mesh would come out garbled
+    const uint format_features = VertexQuantization::get_shader_features(spawned_mesh_->get_vertex_format());
+    if (format_features && !(material->get_supported_features() & format_features))
     {
-        rigid_body_->removeCollider(rigid_body_->getCollider(0));
+        print_warning("Mesh Component", "Material of slot %i has no %s feature required by mesh %s", slot, ShaderFeatures::get_name(std::countr_zero(format_features)).c(), spawned_mesh_->name_.c());
+    }
+
+    return material->get_ogre_material(features | format_features);
+}
+
+void MeshComponent::create_instanced_entity(uint slot, Ogre::SceneNode* node)
+{
+    auto entity = cached_instance_managers_[slot]->createInstancedEntity(get_valid_ogre_material(slot, ShaderFeatures::INSTANCING));
+    ogre_instanced_entities_[slot] = entity;
+
+    // all sub-meshes follow transform of first one
+    if (slot == 0)
+    {
+        for (uint i = 1; i < ogre_instanced_entities_.length(); i++)
+        {
+            if (ogre_instanced_entities_[i])
+                entity->shareTransformWith(ogre_instanced_entities_[i]);
+        }
     }
+    else if (ogre_instanced_entities_[0])
+    {
+        ogre_instanced_entities_[0]->shareTransformWith(entity);
+    }
+
+    node->attachObject(entity);
+
+    if (!is_visible_)
+        entity->setInUse(false);
+
+    apply_material_parameters(slot);
 }
 
-Shared<Material> MeshComponent::get_valid_material(uint slot)
+void MeshComponent::apply_material_parameters(uint slot)
 {
-    return materials_[slot] ? materials_[slot] : Game::get_basic_material();
+    if (!spawned_mesh_ || slot >= spawned_mesh_->ogre_mesh_->getNumSubMeshes())
+        return;
+
+    // quantization box is per mesh, for instances it goes to batch which only holds that mesh
+    if (spawned_mesh_->get_vertex_format() == VertexFormat::Quantized)
+    {
+        Ogre::Renderable* renderable = spawned_mesh_->instanced_ ? static_cast<Ogre::Renderable*>(ogre_instanced_entities_[slot]->_getOwner()) : ogre_entity_->getSubEntity(slot);
+        renderable->setCustomParameter(VertexQuantization::center_parameter, Ogre::Vector4(cast_object<Ogre::Vector3>(spawned_mesh_->get_quantization_center()), 0.0f));
+        renderable->setCustomParameter(VertexQuantization::extents_parameter, Ogre::Vector4(cast_object<Ogre::Vector3>(spawned_mesh_->get_quantization_extents()), 0.0f));
+    }
+
+    const auto apply = [this, slot](uint index, const Quaternion& value)
+    {
+        if (spawned_mesh_->instanced_)
+        {
+            if (index < InstanceParams::COUNT)
+            {
+                ogre_instanced_entities_[slot]->setCustomParam(index, cast_object<Ogre::Vector4>(value));
+            }
+        }
+        else
+        {
+            ogre_entity_->getSubEntity(slot)->setCustomParameter(index, cast_object<Ogre::Vector4>(value));
+        }
+    };
+
+    // instance parameters are reset, so that nothing is left from previous material
+    if (spawned_mesh_->instanced_)
+    {
+        for (uint i = 0; i < InstanceParams::COUNT; i++)
+        {
+            apply(i, InstanceParams::get_default(i));
+        }
+    }
+
+    if (const auto instance = cast<MaterialInstance>(get_valid_material(slot)))
+    {
+        for (const auto& parameter : instance->parameters_)
+        {
+            apply(parameter.key, parameter.value);
+        }
+    }
+
+    if (slot < material_parameters_.length())
+    {
+        for (const auto& parameter : material_parameters_[slot])
+        {
+            apply(parameter.key, parameter.value);
+        }
+    }
 }
@@ -4,15 +4,19 @@
 #include "hexa_engine/Game.h"
 #include "hexa_engine/Material.h"
 #include "hexa_engine/Shader.h"
+#include "hexa_engine/ShaderCache.h"
 #include "hexa_engine/Texture.h"
+#include "hexa_engine/ThreadPool.h"
 
 #include <OgreGpuProgramManager.h>
+#include <OgreHighLevelGpuProgramManager.h>
 #include <OgreMaterial.h>
 #include <OgreMaterialManager.h>
 #include <OgreResourceGroupManager.h>
 #include <OgreTechnique.h>
 #include <OgreTextureManager.h>
 #include <base_lib/Logger.h>
+#include <chrono>
 
 const static Map<Name, Ogre::GpuProgramParameters::AutoConstantType> shader_param_types = {
     {"world_matrix", Ogre::GpuProgramParameters::AutoConstantType::ACT_WORLD_MATRIX},
@@ -164,10 +168,6 @@ const static Map<String, Ogre::TextureFilterOptions> texture_filters = {
     {"anisotropic", Ogre::TextureFilterOptions::TFO_ANISOTROPIC}
 };
 
-FORCEINLINE Name name_instancing(const Name& name) {
-    return Name(name.to_string() + "_instancing");
-}
-
 Module::Module(const Name& module_name)
     : module_name(module_name) {
 }
@@ -183,10 +183,17 @@ Shared<Texture> Module::load_texture(const Name& name) {
         return nullptr;
     }
 
-    if (const auto slot = textures_.find_or_default(name)) {
+    const auto slot = textures_.find_or_default(name);
+    if (slot && slot->is_loaded()) {
         return slot;
     }
 
+    if (slot && !slot->is_failed()) {
+        // worker is decoding it already, its result is uploaded right away instead of decoding it again
+        verbose("Texture", "Texture %s is requested while loading asynchronously, waiting for it", asset_id.to_string().c());
+        return slot->complete_load() ? slot : nullptr;
+    }
+
     if (Game::get_instance()->get_stage() != GameStage::Loading) {
         print_warning("Texture", "Loading outside of loading stage is not recommended: %s", asset_id.to_string().c());
     }
@@ -198,9 +205,18 @@ Shared<Texture> Module::load_texture(const Name& name) {
         return nullptr;
     }
 
-    const Shared<Ogre::FileStreamDataStream> stream = MakeShared<Ogre::FileStreamDataStream>(new std::ifstream(path.get_absolute_string().c()));
     Ogre::Image image;
-    image.load(stream, path.extension.c());
+
+    if (slot) {
+        // asynchronous load failed earlier, retried in place so that materials bound to placeholder get it
+        if (!Texture::decode_file(path, true, image)) return nullptr;
+
+        slot->upload_image(image);
+        return slot;
+    }
+
+    if (!Texture::decode_file(path, false, image)) return nullptr;
+
     const auto ogre_texture = Ogre::TextureManager::getSingleton().loadImage(name.c(), module_name.c(), image, Ogre::TEX_TYPE_2D, Ogre::MIP_DEFAULT, 1, false, Ogre::PF_R8G8B8A8);
 
     Shared<Texture> result = MakeSharedInternal(Texture);
@@ -212,6 +228,64 @@ Shared<Texture> Module::load_texture(const Name& name) {
     return result;
 }
 
+Shared<Texture> Module::load_texture_async(const Name& name) {
+    const ModuleAssetID asset_id(module_name, name);
+
+    if (!name.is_valid()) {
+        print_error("Texture", "Invalid name, unable to load: %s", asset_id.to_string().c());
+        return nullptr;
+    }
+
+    const auto slot = textures_.find_or_default(name);
+    if (slot && !slot->is_failed()) {
+        return slot;
+    }
+
+    const auto path =  (get_textures_path() + asset_id.asset_name.c()).with_extension("png");
+
+    if (!path.exists()) {
+        print_error("Texture", "Does not present on disk, unable to load: %s", asset_id.to_string().c());
+        return nullptr;
+    }
+
+    if (slot) {
+        // failed load is retried in place, so that materials bound to placeholder get it
+        Texture::load_file_async(slot, path);
+        return slot;
+    }
+
+    // texture of its own rather than engine white one, so that it can be bound right away and filled in place later
+    Color white = Color::white();
+    const Ogre::Image placeholder(Ogre::PF_R8G8B8A8, 1, 1, 1, (byte*)&white, false);
+
+    Shared<Texture> result = MakeSharedInternal(Texture);
+    result->ogre_texture_ = Ogre::TextureManager::getSingleton().loadImage(name.c(), module_name.c(), placeholder, Ogre::TEX_TYPE_2D, 0, 1, false, Ogre::PF_R8G8B8A8);
+    result->id_ = asset_id;
+
+    textures_[name] = result;
+
+    Texture::load_file_async(result, path);
+
+    return result;
+}
+
+List<Shared<Texture>> Module::load_textures_async(const String& directory) {
+    List<Shared<Texture>> result;
+
+    const auto directory_path = get_textures_path() + directory;
+    if (!directory_path.exists()) return result;
+
+    for (const auto& path : directory_path.list()) {
+        if (path.get_type() != EPathType::Regular || path.extension != ".png") continue;
+
+        if (const auto texture = load_texture_async(Name(directory + "/" + path.filename))) {
+            result.add(texture);
+        }
+    }
+
+    return result;
+}
+
 Shared<Texture> Module::create_texture(const Array2D<Color>& pixels, const Name& name) {
     const ModuleAssetID asset_id(module_name, name);
 
@@ -282,61 +356,70 @@ Shared<Material> Module::load_material(const Name& name) {
     }
 
     const auto vertex_program = vertex_program_name.get_module_reference()->load_shader_program(vertex_program_name.asset_name);
-
-    if (!vertex_program->is_valid()) {
+    if (!vertex_program) {
         print_error("Material", "Vertex program failed to load: %s", asset_id.to_string().c());
         return nullptr;
     }
 
     const auto fragment_program = fragment_program_name.get_module_reference()->load_shader_program(fragment_program_name.asset_name);
-    if (!fragment_program->is_valid()) {
+    if (!fragment_program) {
         print_error("Material", "Fragment program failed to load: %s", asset_id.to_string().c());
         return nullptr;
     }
 
-    Shared<Ogre::Material> ogre_material = nullptr;
-    Shared<Ogre::Material> ogre_material_instancing = nullptr;
+    // features material always renders with, variants with more of them are made when mesh asks for it
+    const uint features = ShaderFeatures::from_names(material_json.get_array("features").convert<String>()) & (vertex_program->get_features() | fragment_program->get_features());
 
-    for (uint i = 0; i < (vertex_program->has_instanced() || fragment_program->has_instanced() ? 2 : 1); i++) {
-        const bool inst_pass = i == 1;
+    const auto vertex_gpu_program = vertex_program->get_program(features);
+    const auto fragment_gpu_program = fragment_program->get_program(features);
+    if (!vertex_gpu_program || !fragment_gpu_program) {
+        print_error("Material", "Shader programs failed to compile: %s", asset_id.to_string().c());
+        return nullptr;
+    }
 
-        auto& mat = inst_pass ? ogre_material_instancing : ogre_material;
-        mat = Ogre::MaterialManager::getSingleton().create(
-            inst_pass ? name_instancing(name).c() : name.c(),
-            module_name.c());
-        const auto technique = mat->createTechnique();
-        const auto pass = technique->createPass();
+    Shared<Ogre::Material> ogre_material = Ogre::MaterialManager::getSingleton().create(name.c(), module_name.c());
+    const auto technique = ogre_material->createTechnique();
+    const auto pass = technique->createPass();
 
-        pass->setGpuProgram(Ogre::GPT_VERTEX_PROGRAM, inst_pass ? vertex_program->regular_ : vertex_program->try_get_instanced());
-        pass->setGpuProgram(Ogre::GPT_FRAGMENT_PROGRAM, inst_pass ? fragment_program->regular_ : fragment_program->try_get_instanced());
+    pass->setGpuProgram(Ogre::GPT_VERTEX_PROGRAM, vertex_gpu_program);
+    pass->setGpuProgram(Ogre::GPT_FRAGMENT_PROGRAM, fragment_gpu_program);
 
-        for (const auto& texture : material_json.get_array("textures")) {
-            if (texture.get_type() == Compound::Type::Object) {
-                const auto texture_data = texture.get_object();
+    // one entry per texture unit, null where unit has no default texture
+    List<Shared<Texture>> textures;
+    for (const auto& texture : material_json.get_array("textures")) {
+        if (texture.get_type() == Compound::Type::Object) {
+            const auto texture_data = texture.get_object();
 
-                auto unit_state = pass->createTextureUnitState();
+            auto unit_state = pass->createTextureUnitState();
+            Shared<Texture> unit_texture;
 
-                if (const auto param_default = texture_data.find("default")) {
-                    const auto default_id = ModuleAssetID(param_default->get_string(), module_name);
-                    if (const auto default_texture = default_id.get_module_reference()->load_texture(default_id.asset_name)) {
-                        unit_state->setTexture(default_texture->ogre_texture_);
-                    }
+            if (const auto param_default = texture_data.find("default")) {
+                const auto default_id = ModuleAssetID(param_default->get_string(), module_name);
+                // unit is bound to placeholder until texture is uploaded, so materials don't wait for decoding
+                if (const auto default_texture = default_id.get_module_reference()->load_texture_async(default_id.asset_name)) {
+                    unit_state->setTexture(default_texture->ogre_texture_);
+                    unit_texture = default_texture;
                 }
+            }
 
-                if (const auto param_filtering = texture_data.find("filtering")) {
+            textures.add(unit_texture);
 
-                    const auto filter = texture_filters.find_or_default(param_filtering->get_string(), Ogre::TextureFilterOptions::TFO_NONE);
-                    unit_state->setTextureFiltering(filter);
-                }
+            if (const auto param_filtering = texture_data.find("filtering")) {
+
+                const auto filter = texture_filters.find_or_default(param_filtering->get_string(), Ogre::TextureFilterOptions::TFO_NONE);
+                unit_state->setTextureFiltering(filter);
             }
         }
-
-        mat->load();
     }
 
+    ogre_material->load();
+
     Shared<Material> result = MakeSharedInternal(Material);
     result->ogre_material_ = ogre_material;
-    result->ogre_material_instancing_ = ogre_material_instancing;
+    result->vertex_shader_ = vertex_program;
+    result->fragment_shader_ = fragment_program;
+    result->features_ = features;
+    result->textures_ = textures;
     result->id_ = asset_id;
 
     materials_[name] = result;
@@ -359,6 +442,12 @@ Shared<Material> Module::clone_material(const Shared<Material>& material, const
     
     auto result = MakeSharedInternal(Material);
     result->ogre_material_ = material->ogre_material_->clone(new_id.asset_name.c(), new_id.module_name.c());
+    result->vertex_shader_ = material->vertex_shader_;
+    result->fragment_shader_ = material->fragment_shader_;
+    result->features_ = material->features_;
+    for (uint i = 0; i < material->get_textures_count(); i++) {
+        result->textures_.add(material->get_texture(i));
+    }
     result->id_ = new_id;
 
     materials_[new_id.asset_name] = result;
@@ -448,50 +537,94 @@ Shared<Shader> Module::load_shader_program(const Name& name) {
     const static List<String> entry_points = {"vert", "frag"};
     const static List<String> syntax_codes = {"vs_2_0", "ps_2_0"};
 
-    const bool instancing = program_json.get_bool("instancing");
-
-    Shared<Ogre::GpuProgram> programs[2] = {nullptr, nullptr};
-
-    for (uint i = 0; i < (instancing ? 2 : 1); i++) {
-        const bool inst_pass = i == 1;
-
-        const auto program = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(inst_pass
-                                                                                                ? name_instancing(name).c()
-                                                                                                : name.c(),
-                                                                                            module_name.c(), "hlsl",
-                                                                                            Ogre::GpuProgramType(program_type_index));
-        programs[i] = program;
-        program->setSource(File::read_file(source_path).c());
-        program->setParameter("entry_point", entry_points[program_type_index].c());
-        program->setParameter("target", syntax_codes[program_type_index].c());
-
-        List<String> defines = program_json.get_array("defines").convert<String>().without("");
-        if (inst_pass) defines.add("INSTANCING");
-        if (defines.length() > 0) program->setParameter("preprocessor_defines", String::join(defines, " ").c());
-
-        auto& params = program->getDefaultParameters();
-        for (const auto& param : program_json.get_object(inst_pass ? "instancing_params" : "params")) {
+    // nothing is compiled here, programs are made per feature set on first use
+    auto result = MakeSharedInternal(Shader);
+    result->id_ = asset_id;
+    result->source_ = File::read_file(source_path);
+    result->type_ = program_type_index;
+    result->entry_point_ = entry_points[program_type_index];
+    result->target_ = syntax_codes[program_type_index];
+    result->defines_ = program_json.get_array("defines").convert<String>().without("");
+    result->features_ = ShaderFeatures::from_names(program_json.get_array("features").convert<String>());
+
+    // older descriptions only have instancing flag
+    if (program_json.get_bool("instancing")) result->features_ |= ShaderFeatures::INSTANCING;
+
+    const auto read_params = [&](const String& key, Map<String, uint>& out_params) {
+        for (const auto& param : program_json.get_object(key)) {
             const auto param_type_name = param->value.get_string();
             if (const auto param_type = shader_param_types.find(Name(param_type_name))) {
-                params->setNamedAutoConstant(param->key.c(), *param_type);
+                out_params[param->key] = static_cast<uint>(*param_type);
             } else {
                 print_warning("Shader Program", "Parameter %s has invalid type: %s", param->key.c(), asset_id.to_string().c(), param_type_name.c());
             }
         }
+    };
 
-        program->load();
+    read_params("params", result->params_);
+    for (uint i = 0; i < ShaderFeatures::COUNT; i++) {
+        if (result->features_ & (1 << i)) read_params(ShaderFeatures::get_name(i) + "_params", result->feature_params_[i]);
+    }
 
-        if (program->hasCompileError()) {
-            print_error("Shader Program", "Failed to create: %s", program->getName().c_str());
+    shader_[name] = result;
+
+    return result;
+}
+
+void Module::warm_shader_programs() {
+    struct WarmProgram
+    {
+        Shared<Shader> shader;
+        uint features;
+        Shared<Ogre::HighLevelGpuProgram> program;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
 
-            for (const auto& prog : programs) Ogre::HighLevelGpuProgramManager::getSingleton().remove(prog);
+    List<WarmProgram> created;
+    for (const auto& usage : ShaderCache::get_usage()) {
+        if (usage.shader.module_name != module_name) continue;
 
-            return nullptr;
+        const auto shader = load_shader_program(usage.shader.asset_name);
+        if (!shader) continue;
+
+        // description may have dropped some features since usage was recorded
+        const uint features = usage.features & shader->get_features();
+        if (shader->has_program(features)) continue;
+
+        bool duplicate = false;
+        for (const auto& other : created) {
+            duplicate |= other.shader == shader && other.features == features;
         }
+        if (duplicate) continue;
+
+        created.add({shader, features, shader->create_program(features)});
     }
 
-    auto result = MakeSharedInternal(Shader, programs[0], programs[1]);
-    shader_[name] = result;
-    
-    return result;
+    List<Shared<Ogre::HighLevelGpuProgram>> misses;
+    for (const auto& entry : created) {
+        if (!ShaderCache::lookup(entry.program)) {
+            misses.add(entry.program);
+        }
+    }
+
+#if OGRE_THREAD_SUPPORT
+    // preparing compiles microcode, ogre supports it off main thread only when built with thread support
+    ThreadPool::get().parallel_for(misses.length(), [&misses](uint begin, uint end) {
+        for (uint i = begin; i < end; i++) {
+            misses[i]->prepare();
+        }
+    });
+#endif
+
+    for (const auto& entry : created) {
+        entry.shader->finish_program(entry.features, entry.program);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ShaderCache::add_compile_time(seconds);
+
+    if (created.length() > 0) {
+        verbose("Shader Program", "Warmed %u programs of %s in %.2fs, %u compiled", created.length(), module_name.c(), seconds, misses.length());
+    }
 }
@@ -0,0 +1,438 @@
+#include "hexa_engine/ObjImporter.h"
+
+#include "hexa_engine/GeometryEditor.h"
+#include "hexa_engine/MappedFile.h"
+#include "hexa_engine/ThreadPool.h"
+
+#include <atomic>
+#include <base_lib/Logger.h>
+#include <base_lib/Math.h>
+#include <charconv>
+
+// chunks smaller than this are not worth separate task
+const static size_t min_chunk_size = 1 << 20;
+const static int32 no_index = std::numeric_limits<int32>::min();
+
+// corner indices are zero-based, relative ones came from negative indices and are counted from chunk start
+struct ObjCorner
+{
+    int32 position;
+    int32 uv;
+    int32 normal;
+    byte relative;
+};
+
+enum ObjRelativeFlags : byte
+{
+    ObjRelativePosition = 1 << 0,
+    ObjRelativeUV = 1 << 1,
+    ObjRelativeNormal = 1 << 2
+};
+
+struct ObjGroupEvent
+{
+    // first face after event
+    uint face;
+    // usemtl if true, o or g otherwise
+    bool material;
+    String name;
+};
+
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+
+    List<Vector3> positions;
+    List<Vector2> uvs;
+    List<Vector3> normals;
+    List<ObjCorner> corners;
+    // first corner of each face, last entry is total corner count
+    List<uint> face_starts;
+    List<ObjGroupEvent> events;
+
+    uint position_offset = 0;
+    uint uv_offset = 0;
+    uint normal_offset = 0;
+};
+
+// contiguous faces of one chunk that go into one sub-mesh
+struct ObjSegment
+{
+    uint chunk;
+    uint face_begin;
+    uint face_end;
+    uint sub_mesh;
+    uint vertex_offset;
+    uint index_offset;
+};
+
+FORCEINLINE bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+FORCEINLINE const char* skip_spaces(const char* ptr, const char* end)
+{
+    while (ptr < end && is_space(*ptr)) ptr++;
+    return ptr;
+}
+
+FORCEINLINE bool parse_float(const char*& ptr, const char* end, float& out)
+{
+    ptr = skip_spaces(ptr, end);
+    if (ptr < end && *ptr == '+') ptr++;
+
+    const auto result = std::from_chars(ptr, end, out);
+    if (result.ec != std::errc()) return false;
+
+    ptr = result.ptr;
+    return true;
+}
+
+FORCEINLINE bool parse_index(const char*& ptr, const char* end, int32& out)
+{
+    const auto result = std::from_chars(ptr, end, out);
+    if (result.ec != std::errc() || out == 0) return false;
+
+    ptr = result.ptr;
+    return true;
+}
+
+// turn obj index into zero-based one, negative indices are relative to count of elements parsed so far
+FORCEINLINE void resolve_index(int32& index, uint local_count, byte& relative, byte flag)
+{
+    if (index > 0)
+    {
+        index -= 1;
+    }
+    else
+    {
+        index += local_count;
+        relative |= flag;
+    }
+}
+
+static String parse_name(const char* ptr, const char* end)
+{
+    ptr = skip_spaces(ptr, end);
+    while (end > ptr && is_space(*(end - 1))) end--;
+
+    return ptr == end ? String("unnamed") : String(std::string(ptr, end));
+}
+
+FORCEINLINE bool starts_with_keyword(const char* ptr, const char* end, const char* keyword, uint length)
+{
+    return (size_t)(end - ptr) > length && memcmp(ptr, keyword, length) == 0 && is_space(ptr[length]);
+}
+
+static void parse_face(const char* ptr, const char* end, ObjChunk& chunk)
+{
+    const uint first_corner = chunk.corners.length();
+    while (true)
+    {
+        ptr = skip_spaces(ptr, end);
+        if (ptr >= end) break;
+
+        ObjCorner corner = {no_index, no_index, no_index, 0};
+        if (!parse_index(ptr, end, corner.position)) break;
+        resolve_index(corner.position, chunk.positions.length(), corner.relative, ObjRelativePosition);
+
+        if (ptr < end && *ptr == '/')
+        {
+            ptr++;
+            if (ptr < end && *ptr != '/')
+            {
+                if (!parse_index(ptr, end, corner.uv)) break;
+                resolve_index(corner.uv, chunk.uvs.length(), corner.relative, ObjRelativeUV);
+            }
+
+            if (ptr < end && *ptr == '/')
+            {
+                ptr++;
+                if (!parse_index(ptr, end, corner.normal)) break;
+                resolve_index(corner.normal, chunk.normals.length(), corner.relative, ObjRelativeNormal);
+            }
+        }
+
+        chunk.corners.add(corner);
+    }
+
+    // points and lines are not geometry
+    if (chunk.corners.length() - first_corner < 3)
+    {
+        chunk.corners.resize(first_corner);
+        return;
+    }
+
+    chunk.face_starts.add(first_corner);
+}
+
+static void parse_chunk(ObjChunk& chunk)
+{
+    const char* ptr = chunk.begin;
+    while (ptr < chunk.end)
+    {
+        const char* line_end = static_cast<const char*>(memchr(ptr, '\n', chunk.end - ptr));
+        if (!line_end) line_end = chunk.end;
+
+        const char* line = skip_spaces(ptr, line_end);
+        ptr = line_end + 1;
+
+        if (line + 1 >= line_end) continue;
+
+        if (line[0] == 'v')
+        {
+            if (is_space(line[1]))
+            {
+                Vector3 position;
+                const char* cursor = line + 1;
+                if (parse_float(cursor, line_end, position.x) && parse_float(cursor, line_end, position.y) && parse_float(cursor, line_end, position.z))
+                {
+                    chunk.positions.add(position);
+                }
+            }
+            else if (line[1] == 't' && starts_with_keyword(line, line_end, "vt", 2))
+            {
+                Vector2 uv;
+                const char* cursor = line + 2;
+                if (parse_float(cursor, line_end, uv.x) && parse_float(cursor, line_end, uv.y))
+                {
+                    chunk.uvs.add(uv);
+                }
+            }
+            else if (line[1] == 'n' && starts_with_keyword(line, line_end, "vn", 2))
+            {
+                Vector3 normal;
+                const char* cursor = line + 2;
+                if (parse_float(cursor, line_end, normal.x) && parse_float(cursor, line_end, normal.y) && parse_float(cursor, line_end, normal.z))
+                {
+                    chunk.normals.add(normal);
+                }
+            }
+        }
+        else if (line[0] == 'f' && is_space(line[1]))
+        {
+            parse_face(line + 1, line_end, chunk);
+        }
+        else if ((line[0] == 'o' || line[0] == 'g') && is_space(line[1]))
+        {
+            chunk.events.add({chunk.face_starts.length(), false, parse_name(line + 1, line_end)});
+        }
+        else if (line[0] == 'u' && starts_with_keyword(line, line_end, "usemtl", 6))
+        {
+            chunk.events.add({chunk.face_starts.length(), true, parse_name(line + 6, line_end)});
+        }
+    }
+
+    chunk.face_starts.add(chunk.corners.length());
+}
+
+template<typename T>
+FORCEINLINE bool fetch(const List<T>& global, int32 index, T& out)
+{
+    if (index < 0 || (uint)index >= global.length()) return false;
+
+    out = global[index];
+    return true;
+}
+
+bool ObjImporter::import(const Path& path, List<StaticMesh::SubMesh>& out_sub_meshes)
+{
+    const auto file = MappedFile::open(path);
+    if (!file) return false;
+
+    const char* data = reinterpret_cast<const char*>(file->get_data());
+    const size_t size = file->get_size();
+
+    ThreadPool& pool = ThreadPool::get();
+
+    // line-aligned chunks
+    const size_t max_chunks = (pool.get_worker_count() + 1) * 4;
+    const size_t chunk_count_hint = Math::max<size_t>(Math::min<size_t>(size / min_chunk_size, max_chunks), 1);
+    List<ObjChunk> chunks;
+    const char* chunk_begin = data;
+    for (size_t i = 1; i <= chunk_count_hint && chunk_begin < data + size; i++)
+    {
+        const char* chunk_end = i == chunk_count_hint ? data + size : data + size * i / chunk_count_hint;
+        if (chunk_end <= chunk_begin) continue;
+
+        const char* line_end = static_cast<const char*>(memchr(chunk_end - 1, '\n', data + size - (chunk_end - 1)));
+        chunk_end = line_end ? line_end + 1 : data + size;
+
+        ObjChunk chunk;
+        chunk.begin = chunk_begin;
+        chunk.end = chunk_end;
+        chunks.add(chunk);
+
+        chunk_begin = chunk_end;
+    }
+
+    pool.parallel_for(chunks.length(), [&chunks](uint begin, uint end) {
+        for (uint i = begin; i < end; i++)
+        {
+            parse_chunk(chunks[i]);
+        }
+    });
+
+    // global element arrays, chunk offsets make relative indices absolute
+    List<Vector3> positions;
+    List<Vector2> uvs;
+    List<Vector3> normals;
+    for (auto& chunk : chunks)
+    {
+        chunk.position_offset = positions.length();
+        chunk.uv_offset = uvs.length();
+        chunk.normal_offset = normals.length();
+
+        positions.add_many(chunk.positions);
+        uvs.add_many(chunk.uvs);
+        normals.add_many(chunk.normals);
+    }
+
+    // walk groups in file order and assign face ranges to sub-meshes
+    List<StaticMesh::SubMesh>& sub_meshes = out_sub_meshes;
+    sub_meshes = List<StaticMesh::SubMesh>();
+    List<ObjSegment> segments;
+    String group_name = "unnamed";
+    uint material_split = 1;
+    bool sub_mesh_open = false;
+    uint sub_mesh_corners = 0;
+    uint sub_mesh_indices = 0;
+
+    const auto close_sub_mesh = [&]() {
+        if (!sub_mesh_open) return;
+
+        sub_meshes.last().vertices = List<StaticMesh::Vertex>(sub_mesh_corners);
+        sub_meshes.last().indices = List<uint>(sub_mesh_indices);
+        sub_mesh_open = false;
+    };
+
+    for (uint c = 0; c < chunks.length(); c++)
+    {
+        const auto& chunk = chunks[c];
+        const auto add_faces = [&](uint face_begin, uint face_end) {
+            if (face_begin == face_end) return;
+
+            if (!sub_mesh_open)
+            {
+                sub_meshes.add(StaticMesh::SubMesh(material_split == 1 ? group_name : String::format("%s_%u", group_name.c(), material_split), {}, {}));
+                sub_mesh_open = true;
+                sub_mesh_corners = 0;
+                sub_mesh_indices = 0;
+            }
+
+            segments.add({c, face_begin, face_end, sub_meshes.length() - 1, sub_mesh_corners, sub_mesh_indices});
+
+            const uint corners = chunk.face_starts[face_end] - chunk.face_starts[face_begin];
+            sub_mesh_corners += corners;
+            sub_mesh_indices += (corners - 2 * (face_end - face_begin)) * 3;
+        };
+
+        uint face = 0;
+        for (const auto& event : chunk.events)
+        {
+            add_faces(face, event.face);
+            face = event.face;
+
+            if (event.material)
+            {
+                // same group with different material becomes separate sub-mesh
+                if (sub_mesh_open)
+                {
+                    close_sub_mesh();
+                    material_split++;
+                }
+            }
+            else
+            {
+                close_sub_mesh();
+                group_name = event.name;
+                material_split = 1;
+            }
+        }
+
+        add_faces(face, chunk.face_starts.length() - 1);
+    }
+
+    close_sub_mesh();
+
+    if (sub_meshes.length() == 0) return false;
+
+    // each segment writes into its own range of sub-mesh buffers
+    std::atomic<bool> bad_index = false;
+    pool.parallel_for(segments.length(), [&](uint begin, uint end) {
+        for (uint s = begin; s < end; s++)
+        {
+            const auto& segment = segments[s];
+            const auto& chunk = chunks[segment.chunk];
+            auto& sub_mesh = sub_meshes[segment.sub_mesh];
+
+            uint vertex = segment.vertex_offset;
+            uint index = segment.index_offset;
+            for (uint f = segment.face_begin; f < segment.face_end; f++)
+            {
+                const uint first_corner = chunk.face_starts[f];
+                const uint corner_count = chunk.face_starts[f + 1] - first_corner;
+                const uint first_vertex = vertex;
+
+                bool has_normals = true;
+                for (uint k = 0; k < corner_count; k++)
+                {
+                    const auto& corner = chunk.corners[first_corner + k];
+                    auto& out = sub_mesh.vertices[vertex++];
+
+                    const int32 position = corner.position + (corner.relative & ObjRelativePosition ? chunk.position_offset : 0);
+                    if (!fetch(positions, position, out.pos))
+                    {
+                        out.pos = Vector3::zero();
+                        bad_index = true;
+                    }
+
+                    out.uv = Vector2();
+                    if (corner.uv != no_index)
+                    {
+                        const int32 uv = corner.uv + (corner.relative & ObjRelativeUV ? chunk.uv_offset : 0);
+                        if (!fetch(uvs, uv, out.uv)) bad_index = true;
+                    }
+
+                    out.norm = Vector3::zero();
+                    if (corner.normal != no_index)
+                    {
+                        const int32 normal = corner.normal + (corner.relative & ObjRelativeNormal ? chunk.normal_offset : 0);
+                        if (!fetch(normals, normal, out.norm)) bad_index = true;
+                    }
+                    else
+                    {
+                        has_normals = false;
+                    }
+                }
+
+                // faces without normals get flat normal
+                if (!has_normals)
+                {
+                    const Vector3 face_normal = GeometryEditor::compute_normal(sub_mesh.vertices[first_vertex].pos, sub_mesh.vertices[first_vertex + 1].pos, sub_mesh.vertices[first_vertex + 2].pos);
+                    for (uint k = first_vertex; k < vertex; k++)
+                    {
+                        sub_mesh.vertices[k].norm = face_normal;
+                    }
+                }
+
+                // polygons are triangulated as fan
+                for (uint k = 1; k + 1 < corner_count; k++)
+                {
+                    sub_mesh.indices[index++] = first_vertex;
+                    sub_mesh.indices[index++] = first_vertex + k;
+                    sub_mesh.indices[index++] = first_vertex + k + 1;
+                }
+            }
+        }
+    });
+
+    if (bad_index)
+    {
+        print_warning("Obj Importer", "Mesh %s refers to missing vertex data, zeroes are used instead", path.get_absolute_string().c());
+    }
+
+    return true;
+}
@@ -2,6 +2,8 @@
 
 #include "hexa_engine/Texture.h"
 
+#include <OgreDefaultHardwareBufferManager.h>
+
 OgreApp::OgreApp(const String& name)
     : OgreBites::ApplicationContext(name.c())
 {
@@ -19,6 +21,17 @@ void OgreApp::setup()
     on_setup();
 }
 
+void OgreApp::init_headless()
+{
+    // no plugins and config, so nothing asks for render system
+    mRoot = OGRE_NEW Ogre::Root("", "", "");
+
+    // meshes still need vertex and index buffers, these ones live in system memory
+    headless_buffer_manager_ = MakeShared<Ogre::DefaultHardwareBufferManager>();
+
+    on_setup();
+}
+
 void OgreApp::load()
 {
     ui_ = MakeShared<OgreBites::TrayManager>("UI", getRenderWindow(), this);
@@ -34,6 +47,15 @@ void OgreApp::close()
         ui_ = nullptr;
     }
 
+    if (headless_buffer_manager_)
+    {
+        // resources are unloaded by root, so buffer manager goes after it
+        OGRE_DELETE mRoot;
+        mRoot = nullptr;
+        headless_buffer_manager_ = nullptr;
+        return;
+    }
+
     closeApp();
 }
 
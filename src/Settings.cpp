@@ -5,7 +5,8 @@
 void Settings::read_settings(const Compound::Object& compound)
 {
     const auto graphics = compound.get_object("graphics");
-    fps_limit = Math::clamp(graphics.get_int32("fps cap", 60), 1, 10000);
+    // 0 turns limiter off
+    fps_limit = Math::clamp(graphics.get_int32("fps_cap", 60), 0, 10000);
 
     const auto audio = compound.get_object("audio");
     audio_general = Math::clamp(audio.get_float("general", 1.0f), 0.0f, 1.0f);
@@ -1,24 +1,132 @@
 #include "hexa_engine/Shader.h"
 
-Shader::Shader()
-    : regular_(nullptr)
-    , instanced_(nullptr)
-{}
+#include "hexa_engine/ShaderCache.h"
+#include "hexa_engine/VertexQuantization.h"
 
-Shader::Shader(Shared<Ogre::GpuProgram> regular)
-    : regular_(regular)
-    , instanced_(nullptr)
-{}
+#include <OgreHighLevelGpuProgramManager.h>
+#include <base_lib/Logger.h>
+#include <chrono>
+
+const static char* feature_names[ShaderFeatures::COUNT] = {"instancing", "skinning", "alpha_test", "fog", "compact_vertex", "quantized_vertex"};
+const static char* feature_defines[ShaderFeatures::COUNT] = {"INSTANCING", "SKINNING", "ALPHA_TEST", "FOG", "COMPACT_VERTEX", "QUANTIZED_VERTEX"};
+
+String ShaderFeatures::get_name(uint index)
+{
+    return index < COUNT ? feature_names[index] : "";
+}
+
+uint ShaderFeatures::from_names(const List<String>& names)
+{
+    uint result = 0;
+    for (const auto& name : names)
+    {
+        bool found = false;
+        for (uint i = 0; i < COUNT; i++)
+        {
+            if (name == feature_names[i])
+            {
+                result |= 1 << i;
+                found = true;
+                break;
+            }
+        }
 
-Shader::Shader(Shared<Ogre::GpuProgram> regular, Shared<Ogre::GpuProgram> instanced)
-    : regular_(regular)
-    , instanced_(instanced)
+        if (!found) print_warning("Shader Program", "Unknown feature: %s", name.c());
+    }
+
+    return result;
+}
+
+Shader::Shader()
 {}
 
 Shader::operator bool() const { return is_valid(); }
 
-bool Shader::is_valid() const { return regular_ != nullptr; }
+bool Shader::is_valid() const { return id_.is_valid(); }
+
+bool Shader::has_program(uint features) const { return programs_.contains(features & features_); }
+
+Shared<Ogre::GpuProgram> Shader::get_program(uint features)
+{
+    features &= features_;
+
+    if (const auto program = programs_.find(features)) return *program;
+    if (failed_features_.contains(features)) return nullptr;
+
+    const auto program = create_program(features);
+    ShaderCache::lookup(program);
+
+    const auto start = std::chrono::steady_clock::now();
+    auto result = finish_program(features, program);
+    ShaderCache::add_compile_time(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    return result;
+}
+
+Shared<Ogre::HighLevelGpuProgram> Shader::create_program(uint features) const
+{
+    // base program keeps plain name, so that it can still be found by it
+    const String name = features == 0 ? id_.asset_name.to_string() : String::format("%s#%x", id_.asset_name.c(), features);
+
+    const auto program = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(name.c(), id_.module_name.c(), "hlsl", Ogre::GpuProgramType(type_));
+    // decode functions are defined ahead of program code, so that it only has to call them
+    if (features & (ShaderFeatures::COMPACT_VERTEX | ShaderFeatures::QUANTIZED_VERTEX))
+    {
+        program->setSource((VertexQuantization::get_shader_source() + source_).c());
+    }
+    else
+    {
+        program->setSource(source_.c());
+    }
+    program->setParameter("entry_point", entry_point_.c());
+    program->setParameter("target", target_.c());
+
+    List<String> defines = defines_;
+    for (uint i = 0; i < ShaderFeatures::COUNT; i++)
+    {
+        if (features & (1 << i)) defines.add(feature_defines[i]);
+    }
+    if (defines.length() > 0) program->setParameter("preprocessor_defines", String::join(defines, " ").c());
+
+    auto& params = program->getDefaultParameters();
+    const auto set_params = [&params](const Map<String, uint>& source)
+    {
+        for (const auto& param : source)
+        {
+            params->setNamedAutoConstant(param.key.c(), static_cast<Ogre::GpuProgramParameters::AutoConstantType>(param.value));
+        }
+    };
+
+    set_params(features & ShaderFeatures::INSTANCING ? feature_params_[0] : params_);
+    for (uint i = 1; i < ShaderFeatures::COUNT; i++)
+    {
+        if (features & (1 << i)) set_params(feature_params_[i]);
+    }
+
+    // bounds are per mesh, MeshComponent and InstancedMeshSet put them into renderable custom parameters
+    if (features & ShaderFeatures::QUANTIZED_VERTEX)
+    {
+        params->setNamedAutoConstant("quantization_center", Ogre::GpuProgramParameters::ACT_CUSTOM, VertexQuantization::center_parameter);
+        params->setNamedAutoConstant("quantization_extents", Ogre::GpuProgramParameters::ACT_CUSTOM, VertexQuantization::extents_parameter);
+    }
+
+    return program;
+}
+
+Shared<Ogre::GpuProgram> Shader::finish_program(uint features, const Shared<Ogre::HighLevelGpuProgram>& program)
+{
+    program->load();
+
+    if (program->hasCompileError())
+    {
+        print_error("Shader Program", "Failed to create: %s", program->getName().c_str());
+        Ogre::HighLevelGpuProgramManager::getSingleton().remove(program);
+        failed_features_.add(features);
+        return nullptr;
+    }
 
-bool Shader::has_instanced() const { return instanced_ != nullptr; }
+    programs_[features] = program;
+    ShaderCache::record_usage(id_, features);
 
-Shared<Ogre::GpuProgram> Shader::try_get_instanced() const { return instanced_ ? instanced_ : regular_; }
+    return program;
+}
@@ -0,0 +1,153 @@
+#include "hexa_engine/ShaderCache.h"
+
+#include <OgreGpuProgramManager.h>
+#include <OgreHighLevelGpuProgram.h>
+#include <OgreRenderSystem.h>
+#include <OgreRoot.h>
+#include <base_lib/Logger.h>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// bump when anything outside of hashed program state changes, like compilation targets
+const static uint shader_cache_version = 1;
+
+static String get_cache_file_name()
+{
+    std::string render_system = Ogre::Root::getSingleton().getRenderSystem()->getName();
+    for (auto& character : render_system)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(character))) character = '_';
+    }
+
+    return String::format("shaders_%s_v%u.cache", render_system.c_str(), shader_cache_version);
+}
+
+// write next to destination and swap, so that interrupted write never leaves broken file
+template<typename F>
+static void write_file_safe(const Path& path, F&& write)
+{
+    const std::filesystem::path fs_path = path.get_absolute_string().std();
+    std::filesystem::path temp_path = fs_path;
+    temp_path += ".tmp";
+
+    write(temp_path);
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, fs_path, error);
+    if (error)
+    {
+        print_warning("Shader Cache", "Failed to write %s", path.get_absolute_string().c());
+    }
+}
+
+void ShaderCache::load(const Path& directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory.get_absolute_string().std(), error);
+
+    loaded_ = true;
+    usage_path_ = directory + "shader_usage.txt";
+    if (usage_path_.exists())
+    {
+        // one "module:shader features" per line
+        std::ifstream file(usage_path_.get_absolute_string().std());
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream line_stream(line);
+            std::string id;
+            uint features;
+            if (!(line_stream >> id >> features)) continue;
+
+            const ModuleAssetID shader(String(id.c_str()));
+            if (shader.is_valid()) usage_.add({shader, features});
+        }
+    }
+
+    auto& manager = Ogre::GpuProgramManager::getSingleton();
+    if (!manager.canGetCompiledShaderBuffer())
+    {
+        verbose("Shader Cache", "Render system can't return compiled shaders, cache is disabled");
+        return;
+    }
+
+    enabled_ = true;
+    manager.setSaveMicrocodesToCache(true);
+
+    path_ = directory + get_cache_file_name();
+    if (!path_.exists()) return;
+
+    const Shared<Ogre::FileStreamDataStream> stream = MakeShared<Ogre::FileStreamDataStream>(new std::ifstream(path_.get_absolute_string().c(), std::ios::in | std::ios::binary));
+    manager.loadMicrocodeCache(stream);
+
+    verbose("Shader Cache", "Loaded %s", path_.get_absolute_string().c());
+}
+
+void ShaderCache::save()
+{
+    if (loaded_ && usage_dirty_)
+    {
+        write_file_safe(usage_path_, [](const std::filesystem::path& temp_path) {
+            std::ofstream file(temp_path, std::ios::out | std::ios::trunc);
+            for (const auto& usage : usage_)
+            {
+                file << usage.shader.to_string().std() << " " << usage.features << "\n";
+            }
+        });
+
+        usage_dirty_ = false;
+    }
+
+    auto& manager = Ogre::GpuProgramManager::getSingleton();
+    if (!enabled_ || !manager.isCacheDirty()) return;
+
+    write_file_safe(path_, [&manager](const std::filesystem::path& temp_path) {
+        const Shared<Ogre::FileStreamDataStream> stream = MakeShared<Ogre::FileStreamDataStream>(new std::fstream(temp_path, std::ios::out | std::ios::binary | std::ios::trunc));
+        manager.saveMicrocodeCache(stream);
+        stream->close();
+    });
+}
+
+bool ShaderCache::lookup(const Shared<Ogre::HighLevelGpuProgram>& program)
+{
+    const bool hit = enabled_ && Ogre::GpuProgramManager::getSingleton().isMicrocodeAvailableInCache(program->_getHash());
+    if (hit)
+    {
+        hits_++;
+    }
+    else
+    {
+        misses_++;
+    }
+
+    return hit;
+}
+
+void ShaderCache::add_compile_time(double seconds)
+{
+    compile_time_ += seconds;
+}
+
+void ShaderCache::record_usage(const ModuleAssetID& shader, uint features)
+{
+    for (const auto& usage : usage_)
+    {
+        if (usage.shader == shader && usage.features == features) return;
+    }
+
+    usage_.add({shader, features});
+    usage_dirty_ = true;
+}
+
+void ShaderCache::report()
+{
+    if (hits_ + misses_ == 0) return;
+
+    verbose("Shader Cache", "%u programs loaded from cache, %u compiled, %.2fs spent loading programs", hits_, misses_, compile_time_);
+
+    hits_ = 0;
+    misses_ = 0;
+    compile_time_ = 0.0;
+}
@@ -1,22 +1,34 @@
 ﻿#include "hexa_engine/StaticMesh.h"
 
+#include "hexa_engine/ContentHash.h"
 #include "hexa_engine/Game.h"
 #include "hexa_engine/GeometryEditor.h"
+#include "hexa_engine/MappedFile.h"
+#include "hexa_engine/MeshCache.h"
+#include "hexa_engine/ObjImporter.h"
+#include "hexa_engine/ThreadPool.h"
+#include "hexa_engine/VertexQuantization.h"
 #include "hexa_engine/physics/BoxCollision.h"
 #include "hexa_engine/physics/ConcaveMeshCollision.h"
 #include "hexa_engine/physics/ConvexMeshCollision.h"
 #include "hexa_engine/physics/SphereCollision.h"
 
-#include <OBJ_Loader.h>
+#include <OgreDistanceLodStrategy.h>
 #include <OgreHardwareBufferManager.h>
 #include <OgreMesh.h>
 #include <OgreMeshManager.h>
 #include <OgreResourceGroupManager.h>
 #include <OgreSubMesh.h>
 #include <OgreVertexIndexData.h>
+#include <atomic>
 #include <base_lib/Assert.h>
 #include <base_lib/File.h>
 #include <base_lib/performance.h>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
 
 struct Bounds
 {
@@ -37,6 +49,40 @@ struct Bounds
     FORCEINLINE Vector3 get_extents() const { return (max - min) * 0.5f; };
 };
 
+// cooked mesh which may live either in lists or in mapped cache file
+struct StaticMesh::CookedMeshView
+{
+    const Vertex* vertices;
+    uint vertex_count;
+    const uint* indices;
+    uint index_count;
+    const CookedSubMesh* sub_meshes;
+    uint sub_mesh_count;
+    const float* lod_distances;
+    uint lod_level_count;
+    const CookedSubMesh* lod_sub_meshes;
+    Vector3 bounds_min;
+    Vector3 bounds_max;
+
+    const CookedCollision* collisions;
+    uint collision_count;
+    const Vector3* collision_positions;
+    const uint* collision_indices;
+    const CookedFace* collision_faces;
+
+    static CookedMeshView of(const CookedMesh& cooked)
+    {
+        return {
+            cooked.vertices.get_data(), cooked.vertices.length(),
+            cooked.indices.get_data(), cooked.indices.length(),
+            cooked.sub_meshes.get_data(), cooked.sub_meshes.length(),
+            cooked.lod_distances.get_data(), cooked.lod_distances.length(), cooked.lod_sub_meshes.get_data(),
+            cooked.bounds_min, cooked.bounds_max,
+            cooked.collisions.get_data(), cooked.collisions.length(),
+            cooked.collision_positions.get_data(), cooked.collision_indices.get_data(), cooked.collision_faces.get_data()};
+    }
+};
+
 Shared<StaticMesh> StaticMesh::empty = MakeShared<StaticMesh>("Empty Mesh");
 
 StaticMesh::SubMesh::SubMesh(const String& name, const List<Vertex>& vertices, const List<uint>& indices)
@@ -68,61 +114,158 @@ void StaticMesh::SubMesh::add(const List<Vertex>& new_vertices, const List<uint>
 
 StaticMesh::StaticMesh(const String& name)
     : instanced_(false)
+    , name_(name)
+    , vertex_format_(VertexFormat::Full)
+{
+}
+
+StaticMesh::~StaticMesh()
 {
+    if (ogre_mesh_ && Ogre::MeshManager::getSingletonPtr() && Ogre::MeshManager::getSingleton().getByHandle(ogre_mesh_->getHandle()))
+    {
+        Ogre::MeshManager::getSingleton().remove(ogre_mesh_->getHandle());
+    }
+}
+
+Shared<Ogre::Mesh> StaticMesh::create_ogre_mesh(const String& name)
+{
+    auto& manager = Ogre::MeshManager::getSingleton();
+
+    // entities find mesh by name, replacing one which is still alive would swap geometry under them
+    if (!Check(!manager.getByName(name.c(), Ogre::RGN_DEFAULT), "Mesh", "Mesh with name %s already exists", name.c()))
+        return nullptr;
+
+    return manager.createManual(name.c(), Ogre::RGN_DEFAULT);
 }
 
-Shared<StaticMesh> StaticMesh::construct(const String& name, const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode, bool compute_normals)
+Shared<StaticMesh> StaticMesh::construct(const String& name, const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode, bool compute_normals, bool optimize, VertexFormat vertex_format, const MeshLodSettings& lod)
 {
-    const auto result = create(name, sub_meshes, collision_mode, compute_normals);
+    const auto result = create(name, sub_meshes, collision_mode, compute_normals, optimize, vertex_format, lod);
 
     verbose("Mesh", "Constructed mesh %s", name.c());
 
     return result;
 }
 
-Shared<StaticMesh> StaticMesh::load_file_obj(const Path& path, AutoCollisionMode collision_mode)
+// cpu side result of loading mesh file, ready for upload
+struct StaticMesh::PreparedMesh
+{
+    // either view points into mapped cache file or into cooked
+    Shared<MappedFile> cooked_file;
+    CookedMesh cooked;
+    CookedMeshView view;
+};
+
+MeshLoad::Upload StaticMesh::make_upload(const String& key, const Shared<PreparedMesh>& prepared, VertexFormat vertex_format)
+{
+    return [key, prepared, vertex_format]() -> Shared<StaticMesh>
+    {
+        // mesh is named by cache key, so that loads of one file with different settings don't clash
+        const Shared<StaticMesh> result = prepared ? upload(key, prepared->view, vertex_format) : nullptr;
+        if (!result)
+        {
+            Game::instance_->meshes_.remove(key);
+        }
+
+        return result;
+    };
+}
+
+String StaticMesh::get_load_key(const Path& path, AutoCollisionMode collision_mode, VertexFormat vertex_format, const MeshLodSettings& lod)
+{
+    // files with same name in different folders are different meshes, so are loads of one file with different settings
+    return String::format("%s?collision=%u&format=%u&lod=%u,%g,%g,%g",
+        path.get_absolute_string().c(), static_cast<uint>(collision_mode), static_cast<uint>(vertex_format),
+        lod.level_count, lod.reduction, lod.distance, lod.collision_reduction);
+}
+
+Shared<StaticMesh> StaticMesh::load_file_obj(const Path& path, AutoCollisionMode collision_mode, VertexFormat vertex_format, const MeshLodSettings& lod)
 {
-    if (const auto found = Game::instance_->meshes_.find(path.get_absolute_string()))
+    const String key = get_load_key(path, collision_mode, vertex_format, lod);
+
+    bool created;
+    const auto load = Game::instance_->meshes_.find_or_add(key, created);
+    if (!created)
     {
-        return *found;
+        if (load->is_done())
+            return load->get_mesh();
+
+        // worker is reading or cooking it already, its result is uploaded right away instead of cooking it again
+        verbose("Mesh", "Mesh %s is requested while loading asynchronously, waiting for it", key.c());
+        return load->complete();
     }
 
+    const auto prepared = prepare_file_obj(path, collision_mode, lod);
+    load->prepare(make_upload(key, prepared, vertex_format));
+
+    return load->complete();
+}
+
+Shared<MeshLoad> StaticMesh::load_async(const Path& path, AutoCollisionMode collision_mode, VertexFormat vertex_format, const MeshLodSettings& lod)
+{
+    const String key = get_load_key(path, collision_mode, vertex_format, lod);
+
+    bool created;
+    const auto load = Game::instance_->meshes_.find_or_add(key, created);
+    if (!created)
+        return load;
+
+    const MeshLodSettings lod_copy = lod;
+    ThreadPool::get().enqueue([path, key, collision_mode, vertex_format, lod_copy, load]() {
+        const auto prepared = prepare_file_obj(path, collision_mode, lod_copy);
+        load->prepare(make_upload(key, prepared, vertex_format));
+
+        // ogre buffers can be created only on main thread, synchronous load of the same path may upload it sooner
+        Game::call_on_main_thread([load]() {
+            load->complete();
+        }, MainThreadPriority::Low);
+    });
+
+    return load;
+}
+
+Shared<StaticMesh::PreparedMesh> StaticMesh::prepare_file_obj(const Path& path, AutoCollisionMode collision_mode, const MeshLodSettings& lod)
+{
     if (!Check(path.exists(), "Mesh Loader", "Mesh does not exists %s", path.get_absolute_string().c()))
         return nullptr;
 
-    Shared<objl::Loader> loader = MakeShared<objl::Loader>();
-    if (!Check(loader->LoadFile(path.get_absolute().to_string().std()), "Mesh Loader", "Unknown error on loading mesh %s", path.get_absolute_string().c()))
-        return nullptr;
-    if (!Check(loader->LoadedVertices.size() > 0, "Mesh Loader", "Number of vertices is 0 in mesh %s", path.get_absolute_string().c()))
-        return nullptr;
-    if (!Check(loader->LoadedIndices.size() > 0, "Mesh Loader", "Number of indices is 0 in mesh %s", path.get_absolute_string().c()))
-        return nullptr;
+    const auto result = MakeShared<PreparedMesh>();
+    const Path cooked_path = path.with_extension("hmesh");
 
-    List<SubMesh> sub_meshes(loader->LoadedMeshes.size());
-    for (uint i = 0; i < sub_meshes.length(); i++)
+    if (map_cooked(path, cooked_path, collision_mode, lod, result->cooked_file, result->view))
     {
-        auto& sub_mesh = sub_meshes[i];
-        const auto src_sub_mesh = loader->LoadedMeshes[i];
-        sub_mesh.name = src_sub_mesh.MeshName;
-        sub_mesh.vertices = List<Vertex>(src_sub_mesh.Vertices.size());
-        for (uint j = 0; j < src_sub_mesh.Vertices.size(); j++)
+        verbose("Mesh", "Loaded cooked mesh %s", path.get_absolute_string().c());
+
+        return result;
+    }
+
+    List<SubMesh> sub_meshes;
+    if (!Check(ObjImporter::import(path, sub_meshes), "Mesh Loader", "Failed to import mesh %s", path.get_absolute_string().c()))
+        return nullptr;
+
+    GeometryEditor::Pipeline pipeline;
+    pipeline.weld().transform(Transform(Vector3::zero(), Quaternion::from_axis_angle(Vector3::forward(), 90), Vector3(100.0f, 100.0f, 100.0f)));
+
+    ThreadPool::get().parallel_for(sub_meshes.length(), [&sub_meshes, &pipeline](uint begin, uint end) {
+        for (uint i = begin; i < end; i++)
         {
-            const auto& vert = src_sub_mesh.Vertices[j];
-            sub_mesh.vertices[j] = Vertex{
-                cast_object<Vector3>(vert.Position) * 100,
-                Vector2(vert.TextureCoordinate.X, 1 - vert.TextureCoordinate.Y),
-                cast_object<Vector3>(vert.Normal)};
-        }
+            auto& sub_mesh = sub_meshes[i];
+            for (auto& vert : sub_mesh.vertices)
+            {
+                vert.uv.y = 1 - vert.uv.y;
+            }
 
-        sub_mesh.indices = src_sub_mesh.Indices;
+            pipeline.run(sub_mesh.vertices, sub_mesh.indices);
+        }
+    });
 
-        GeometryEditor::optimize(sub_mesh.vertices, sub_mesh.indices);
-        GeometryEditor::rotate(sub_mesh.vertices, Quaternion::from_axis_angle(Vector3::forward(), 90));
+    result->cooked = cook(sub_meshes, collision_mode, false, true, lod);
+    if (!save_cooked(result->cooked, path, cooked_path, collision_mode, lod))
+    {
+        print_warning("Mesh Loader", "Failed to write cooked mesh %s", cooked_path.get_absolute_string().c());
     }
 
-    Shared<StaticMesh> result = create(path.filename + path.extension, sub_meshes, collision_mode, false);
-
-    Game::instance_->meshes_[path.get_absolute_string()] = result;
+    result->view = CookedMeshView::of(result->cooked);
     verbose("Mesh", "Loaded mesh %s", path.get_absolute_string().c());
 
     return result;
@@ -145,7 +288,30 @@ Vector3 StaticMesh::get_bounds_half_size() const
 
 bool StaticMesh::is_empty() const
 {
-    return ogre_mesh_->sharedVertexData->vertexCount == 0;
+    if (ogre_mesh_->sharedVertexData) return ogre_mesh_->sharedVertexData->vertexCount == 0;
+
+    // dynamic meshes keep vertices per sub-mesh
+    for (const auto sub : ogre_mesh_->getSubMeshes())
+    {
+        if (sub->vertexData && sub->vertexData->vertexCount > 0) return false;
+    }
+
+    return true;
+}
+
+VertexFormat StaticMesh::get_vertex_format() const
+{
+    return vertex_format_;
+}
+
+Vector3 StaticMesh::get_quantization_center() const
+{
+    return quantization_center_;
+}
+
+Vector3 StaticMesh::get_quantization_extents() const
+{
+    return quantization_extents_;
 }
 
 void StaticMesh::make_instanced()
@@ -160,48 +326,98 @@ struct TriangleNormal
     Vector3 normal;
 };
 
-Shared<StaticMesh> StaticMesh::create(const String& name, const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode, bool compute_normals)
+Shared<StaticMesh> StaticMesh::create(const String& name, const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode, bool compute_normals, bool optimize, VertexFormat vertex_format, const MeshLodSettings& lod)
 {
-    Shared<StaticMesh> result = MakeShared<StaticMesh>(name);
+    const CookedMesh cooked = cook(sub_meshes, collision_mode, compute_normals, optimize, lod);
 
-    result->ogre_mesh_ = Ogre::MeshManager::getSingleton().createManual(name.c(), Ogre::RGN_DEFAULT);
+    return upload(name, CookedMeshView::of(cooked), vertex_format);
+}
 
-    result->ogre_mesh_->sharedVertexData = new Ogre::VertexData();
+FORCEINLINE void add_cooked_convex(StaticMesh::CookedMesh& cooked, const Vector3& location, const List<StaticMesh::Vertex>& vertices, const List<uint>& indices)
+{
+    List<Vector3> positions;
+    List<uint> face_indices;
+    List<GeometryEditor::Face> faces;
+    ConvexMeshCollision::cook(vertices, indices, positions, face_indices, faces);
+
+    StaticMesh::CookedCollision collision = {StaticMesh::CookedCollision::Type::ConvexMesh, location, Quaternion()};
+    collision.position_start = cooked.collision_positions.length();
+    collision.position_count = positions.length();
+    collision.index_start = cooked.collision_indices.length();
+    collision.index_count = face_indices.length();
+    collision.face_start = cooked.collision_faces.length();
+    collision.face_count = faces.length();
+
+    cooked.collision_positions.add_many(positions);
+    cooked.collision_indices.add_many(face_indices);
+    for (const auto& face : faces)
+    {
+        cooked.collision_faces.add({face.size, face.index});
+    }
 
-    Ogre::VertexDeclaration* decl = result->ogre_mesh_->sharedVertexData->vertexDeclaration;
-    Ogre::VertexBufferBinding* bind = result->ogre_mesh_->sharedVertexData->vertexBufferBinding;
+    cooked.collisions.add(collision);
+}
 
-    size_t offset = 0;
-    decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
-    offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-    decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0);
-    offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
-    decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
-    offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-
-    uint visible_vertex_count = 0;
-    uint visible_index_count = 0;
-    for (const auto& sub_mesh : sub_meshes)
-    {
-        if (!sub_mesh.name.starts_with("SPHERE_") &&
-            !sub_mesh.name.starts_with("BOX_") &&
-            !sub_mesh.name.starts_with("CONVEX_"))
+StaticMesh::CookedMesh StaticMesh::cook(const List<SubMesh>& sub_meshes, AutoCollisionMode collision_mode, bool compute_normals, bool optimize, const MeshLodSettings& lod)
+{
+    CookedMesh result;
+
+    GeometryEditor::Pipeline gpu_pipeline;
+    gpu_pipeline.optimize_vertex_cache().optimize_overdraw().optimize_vertex_fetch();
+
+    std::atomic<uint> transformed_before = 0;
+    std::atomic<uint> transformed_after = 0;
+    std::atomic<uint> optimized_triangles = 0;
+    std::atomic<uint> optimized_vertices = 0;
+
+    // visible sub-meshes are independent, so heavy processing runs in parallel
+    List<SubMesh> processed(sub_meshes.length());
+    // simplified indices of each sub-mesh, lod.level_count per sub-mesh
+    List<List<uint>> lods(sub_meshes.length() * lod.level_count);
+    ThreadPool::get().parallel_for(sub_meshes.length(), [&](uint begin, uint end) {
+        for (uint i = begin; i < end; i++)
         {
-            visible_vertex_count += sub_mesh.vertices.length();
-            visible_index_count += sub_mesh.indices.length();
-        }
-    }
+            const auto& sub_mesh = sub_meshes[i];
+            if (sub_mesh.name.starts_with("SPHERE_") || sub_mesh.name.starts_with("BOX_") || sub_mesh.name.starts_with("CONVEX_")) continue;
 
-    List<Vertex> vertices_copy(visible_vertex_count);
-    List<uint> indices_copy(visible_index_count);
+            processed[i].vertices = sub_mesh.vertices;
+            processed[i].indices = sub_mesh.indices;
+            auto& vertices = processed[i].vertices;
+            auto& indices = processed[i].indices;
 
-    uint vci = 0;
-    uint ici = 0;
+            if (compute_normals)
+            {
+                GeometryEditor::compute_normals(vertices, indices, true);
+            }
+
+            if (optimize)
+            {
+                transformed_before += GeometryEditor::analyze_vertex_cache(indices, vertices.length()).vertices_transformed;
+                gpu_pipeline.run(vertices, indices);
+                transformed_after += GeometryEditor::analyze_vertex_cache(indices, vertices.length()).vertices_transformed;
+                optimized_triangles += indices.length() / 3;
+                optimized_vertices += vertices.length();
+            }
+
+            // each level is simplified from previous one, so that levels stay similar
+            for (uint level = 0; level < lod.level_count; level++)
+            {
+                auto& lod_indices = lods[i * lod.level_count + level];
+                lod_indices = level == 0 ? indices : lods[i * lod.level_count + level - 1];
+
+                GeometryEditor::simplify(vertices, lod_indices, static_cast<uint>(lod_indices.length() * lod.reduction));
+                GeometryEditor::optimize_vertex_cache(lod_indices, vertices.length());
+            }
+        }
+    });
+
+    List<uint> visible_sub_meshes;
+    List<uint> visible_vertex_offsets;
 
-    uint vertex_offset = 0;
     Bounds visual_bounds;
-    for (const auto& sub_mesh : sub_meshes)
+    for (uint sub_mesh_index = 0; sub_mesh_index < sub_meshes.length(); sub_mesh_index++)
     {
+        const auto& sub_mesh = sub_meshes[sub_mesh_index];
         if (sub_mesh.name.starts_with("SPHERE_")) // Sphere collision
         {
             if (collision_mode == AutoCollisionMode::Default)
@@ -212,7 +428,7 @@ Shared<StaticMesh> StaticMesh::create(const String& name, const List<SubMesh>& s
                     sub_bounds.add(cast_object<Vector3>(vert.pos));
                 }
 
-                result->collisions_.add({sub_bounds.get_center(), Quaternion(), MakeShared<SphereCollision>(sub_bounds.get_extents().get_min_axis())});
+                result.collisions.add({CookedCollision::Type::Sphere, sub_bounds.get_center(), Quaternion(), Vector3(sub_bounds.get_extents().get_min_axis(), 0, 0)});
             }
         }
         else if (sub_mesh.name.starts_with("BOX_")) // Box collision
@@ -309,7 +525,7 @@ Shared<StaticMesh> StaticMesh::create(const String& name, const List<SubMesh>& s
                             2);
                     Vector3 box_center = (triangles[0].center + triangles[1].center + triangles[2].center + triangles[3].center + triangles[4].center + triangles[5].center + triangles[6].center + triangles[7].center + triangles[8].center + triangles[9].center + triangles[10].center + triangles[11].center) / 12.f;
 
-                    result->collisions_.add({box_center, box_rotation, MakeShared<BoxCollision>(box_size)});
+                    result.collisions.add({CookedCollision::Type::Box, box_center, box_rotation, box_size});
                 }
                 else
                 {
@@ -338,68 +554,439 @@ Shared<StaticMesh> StaticMesh::create(const String& name, const List<SubMesh>& s
                     }
                 }
 
-                result->collisions_.add({sub_mesh_center, Quaternion(), MakeShared<ConvexMeshCollision>(vertices, sub_mesh.indices)});
+                add_cooked_convex(result, sub_mesh_center, vertices, sub_mesh.indices);
             }
         }
         else // Visible mesh
         {
-            auto vertices = sub_mesh.vertices;
+            const auto& vertices = processed[sub_mesh_index].vertices;
+            const auto& indices = processed[sub_mesh_index].indices;
 
-            if (compute_normals)
+            for (uint i = 0; i < vertices.length(); i++)
             {
-                GeometryEditor::compute_normals(vertices, sub_mesh.indices, true);
+                visual_bounds.add(vertices[i].pos);
             }
 
-            memcpy(vertices_copy.get_data() + vci, vertices.get_data(), sizeof(Vertex) * vertices.length());
-            vci += vertices.length();
+            const uint vertex_offset = result.vertices.length();
+            visible_sub_meshes.add(sub_mesh_index);
+            visible_vertex_offsets.add(vertex_offset);
+            result.sub_meshes.add({result.indices.length(), indices.length()});
+            for (const auto index : indices)
+            {
+                result.indices.add(index + vertex_offset);
+            }
 
-            for (uint i = 0; i < vertices.length(); i++)
+            result.vertices.add_many(vertices);
+        }
+    }
+
+    if (optimized_triangles > 0)
+    {
+        verbose("Mesh", "Optimized for vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+                (float)transformed_before / (float)optimized_triangles, (float)transformed_after / (float)optimized_triangles,
+                (float)transformed_before / (float)optimized_vertices, (float)transformed_after / (float)optimized_vertices);
+    }
+
+    if (collision_mode == AutoCollisionMode::Complex || collision_mode == AutoCollisionMode::Convex)
+    {
+        List<Vertex> collision_vertices = result.vertices;
+        List<uint> collision_indices = result.indices;
+        if (lod.collision_reduction < 1.0f)
+        {
+            // collision has no seams, so simplifier can work on welded positions only
+            GeometryEditor::optimize_collision(collision_vertices, collision_indices);
+            GeometryEditor::simplify(collision_vertices, collision_indices, static_cast<uint>(collision_indices.length() * lod.collision_reduction));
+            GeometryEditor::remove_unused_vertices(collision_vertices, collision_indices);
+        }
+
+        if (collision_mode == AutoCollisionMode::Complex)
+        {
+            CookedCollision collision = {CookedCollision::Type::ConcaveMesh, Vector3::zero(), Quaternion()};
+            collision.position_start = result.collision_positions.length();
+            collision.position_count = collision_vertices.length();
+            collision.index_start = result.collision_indices.length();
+            collision.index_count = collision_indices.length();
+
+            for (const auto& vertex : collision_vertices)
             {
-                visual_bounds.add(vertices[i].pos);
+                result.collision_positions.add(vertex.pos);
             }
+            result.collision_indices.add_many(collision_indices);
+
+            result.collisions.add(collision);
+        }
+        else
+        {
+            add_cooked_convex(result, Vector3::zero(), collision_vertices, collision_indices);
+        }
+    }
 
-            Ogre::HardwareIndexBufferSharedPtr ibuf = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(Ogre::HardwareIndexBuffer::IT_32BIT, sub_mesh.indices.length(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-            List<uint> indices_buff(sub_mesh.indices.get_data(), sub_mesh.indices.length());
-            for (uint i = 0; i < sub_mesh.indices.length(); i++)
+    for (uint level = 0; level < lod.level_count; level++)
+    {
+        result.lod_distances.add(lod.distance * static_cast<float>(1u << level));
+        for (uint i = 0; i < visible_sub_meshes.length(); i++)
+        {
+            const auto& lod_indices = lods[visible_sub_meshes[i] * lod.level_count + level];
+            result.lod_sub_meshes.add({result.indices.length(), lod_indices.length()});
+            for (const auto index : lod_indices)
             {
-                indices_buff[i] = sub_mesh.indices[i] + vertex_offset;
+                result.indices.add(index + visible_vertex_offsets[i]);
             }
+        }
+    }
+
+    result.bounds_min = visual_bounds.min;
+    result.bounds_max = visual_bounds.max;
+
+    return result;
+}
+
+Shared<StaticMesh> StaticMesh::upload(const String& name, const CookedMeshView& cooked, VertexFormat vertex_format)
+{
+    Shared<StaticMesh> result = MakeShared<StaticMesh>(name);
+    result->vertex_format_ = vertex_format;
+    result->quantization_center_ = (cooked.bounds_min + cooked.bounds_max) * 0.5f;
+    result->quantization_extents_ = VertexQuantization::get_safe_extents(cooked.bounds_min, cooked.bounds_max);
+
+    result->ogre_mesh_ = create_ogre_mesh(name);
+    if (!result->ogre_mesh_)
+        return nullptr;
+
+    result->ogre_mesh_->sharedVertexData = new Ogre::VertexData();
+
+    Ogre::VertexDeclaration* decl = result->ogre_mesh_->sharedVertexData->vertexDeclaration;
+    Ogre::VertexBufferBinding* bind = result->ogre_mesh_->sharedVertexData->vertexBufferBinding;
+
+    Ogre::VertexElementType position_type = Ogre::VET_FLOAT3;
+    Ogre::VertexElementType uv_type = Ogre::VET_FLOAT2;
+    Ogre::VertexElementType normal_type = Ogre::VET_FLOAT3;
+    if (vertex_format != VertexFormat::Full)
+    {
+        position_type = vertex_format == VertexFormat::Quantized ? Ogre::VET_SHORT4_NORM : Ogre::VET_FLOAT3;
+        uv_type = Ogre::VET_HALF2;
+        normal_type = Ogre::VET_SHORT2_NORM;
+    }
+
+    size_t offset = 0;
+    decl->addElement(0, offset, position_type, Ogre::VES_POSITION);
+    offset += Ogre::VertexElement::getTypeSize(position_type);
+    decl->addElement(0, offset, uv_type, Ogre::VES_TEXTURE_COORDINATES, 0);
+    offset += Ogre::VertexElement::getTypeSize(uv_type);
+    decl->addElement(0, offset, normal_type, Ogre::VES_NORMAL);
+    offset += Ogre::VertexElement::getTypeSize(normal_type);
+
+    result->ogre_mesh_->sharedVertexData->vertexCount = cooked.vertex_count;
+
+    Ogre::HardwareVertexBufferSharedPtr vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(offset, cooked.vertex_count, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+    if (vertex_format == VertexFormat::Full)
+    {
+        vbuf->writeData(0, sizeof(Vertex) * cooked.vertex_count, cooked.vertices);
+    }
+    else
+    {
+        List<byte> encoded(static_cast<uint>(offset) * cooked.vertex_count);
+        VertexQuantization::encode(cooked.vertices, cooked.vertex_count, vertex_format, cooked.bounds_min, cooked.bounds_max, encoded.get_data());
+        vbuf->writeData(0, encoded.length(), encoded.get_data());
+    }
+    bind->setBinding(0, vbuf);
 
-            if (collision_mode == AutoCollisionMode::Complex || collision_mode == AutoCollisionMode::Convex)
+    // all sub-meshes share one index buffer, each one draws its own range
+    if (cooked.index_count > 0)
+    {
+        Ogre::HardwareIndexBufferSharedPtr ibuf;
+        // 16-bit indices are enough for most of meshes, tiles especially
+        if (cooked.vertex_count <= 0x10000)
+        {
+            List<byte16> short_indices(cooked.index_count);
+            for (uint i = 0; i < cooked.index_count; i++)
             {
-                memcpy(indices_copy.get_data() + ici, indices_buff.get_data(), sizeof(uint) * indices_buff.length());
-                ici += indices_buff.length();
+                short_indices[i] = static_cast<byte16>(cooked.indices[i]);
             }
 
-            ibuf->writeData(0, sizeof(uint) * indices_buff.length(), indices_buff.get_data(), false);
+            ibuf = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(Ogre::HardwareIndexBuffer::IT_16BIT, cooked.index_count, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            ibuf->writeData(0, sizeof(byte16) * cooked.index_count, short_indices.get_data(), false);
+        }
+        else
+        {
+            ibuf = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(Ogre::HardwareIndexBuffer::IT_32BIT, cooked.index_count, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            ibuf->writeData(0, sizeof(uint) * cooked.index_count, cooked.indices, false);
+        }
 
+        for (uint i = 0; i < cooked.sub_mesh_count; i++)
+        {
             auto sub = result->ogre_mesh_->createSubMesh();
             sub->useSharedVertices = true;
             sub->indexData->indexBuffer = ibuf;
-            sub->indexData->indexCount = sub_mesh.indices.length();
-            sub->indexData->indexStart = 0;
+            sub->indexData->indexCount = cooked.sub_meshes[i].index_count;
+            sub->indexData->indexStart = cooked.sub_meshes[i].index_start;
+        }
+
+        // simplified levels draw other ranges of the same buffers, ogre picks them by camera distance
+        if (cooked.lod_level_count > 0 && cooked.sub_mesh_count > 0)
+        {
+            Ogre::LodStrategy* strategy = Ogre::DistanceLodBoxStrategy::getSingletonPtr();
+            result->ogre_mesh_->setLodStrategy(strategy);
+            result->ogre_mesh_->_setLodInfo(static_cast<unsigned short>(cooked.lod_level_count + 1));
+
+            for (uint level = 0; level <= cooked.lod_level_count; level++)
+            {
+                Ogre::MeshLodUsage usage;
+                usage.userValue = level == 0 ? 0.0f : cooked.lod_distances[level - 1];
+                usage.value = level == 0 ? strategy->getBaseValue() : strategy->transformUserValue(usage.userValue);
+                usage.manualMesh = nullptr;
+                usage.edgeData = nullptr;
+                result->ogre_mesh_->_setLodUsage(static_cast<unsigned short>(level), usage);
+            }
+
+            for (uint level = 1; level <= cooked.lod_level_count; level++)
+            {
+                for (uint i = 0; i < cooked.sub_mesh_count; i++)
+                {
+                    const auto& range = cooked.lod_sub_meshes[(level - 1) * cooked.sub_mesh_count + i];
 
-            vertex_offset += vertices.length();
+                    auto index_data = OGRE_NEW Ogre::IndexData();
+                    index_data->indexBuffer = ibuf;
+                    index_data->indexStart = range.index_start;
+                    index_data->indexCount = range.index_count;
+                    result->ogre_mesh_->_setSubMeshLodFaceList(static_cast<unsigned short>(i), static_cast<unsigned short>(level), index_data);
+                }
+            }
         }
     }
 
-    result->ogre_mesh_->sharedVertexData->vertexCount = vertices_copy.length();
+    for (uint i = 0; i < cooked.collision_count; i++)
+    {
+        const auto& collision = cooked.collisions[i];
+        const List<Vector3> positions = List<Vector3>(cooked.collision_positions + collision.position_start, collision.position_count);
+        const List<uint> indices = List<uint>(cooked.collision_indices + collision.index_start, collision.index_count);
 
-    Ogre::HardwareVertexBufferSharedPtr vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(offset, vertices_copy.length(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-    vbuf->writeData(0, sizeof(Vertex) * vertices_copy.length(), vertices_copy.get_data());
-    bind->setBinding(0, vbuf);
+        switch (collision.type)
+        {
+        case CookedCollision::Type::Sphere:
+            result->collisions_.add({collision.location, collision.rotation, MakeShared<SphereCollision>(collision.extent.x)});
+            break;
+        case CookedCollision::Type::Box:
+            result->collisions_.add({collision.location, collision.rotation, MakeShared<BoxCollision>(collision.extent)});
+            break;
+        case CookedCollision::Type::ConvexMesh:
+        {
+            List<GeometryEditor::Face> faces(collision.face_count);
+            for (uint j = 0; j < collision.face_count; j++)
+            {
+                faces[j] = {cooked.collision_faces[collision.face_start + j].size, cooked.collision_faces[collision.face_start + j].index};
+            }
+
+            result->collisions_.add({collision.location, collision.rotation, MakeShared<ConvexMeshCollision>(positions, indices, faces)});
+            break;
+        }
+        case CookedCollision::Type::ConcaveMesh:
+            result->collisions_.add({collision.location, collision.rotation, MakeShared<ConcaveMeshCollision>(positions, indices)});
+            break;
+        }
+    }
+
+    result->ogre_mesh_->_setBounds(Ogre::AxisAlignedBox(cast_object<Ogre::Vector3>(cooked.bounds_min), cast_object<Ogre::Vector3>(cooked.bounds_max)));
+    // result->ogre_mesh_->buildEdgeList();
+
+    return result;
+}
 
-    if (collision_mode == AutoCollisionMode::Complex)
+// bump version whenever cooking output changes, so that stale caches are re-cooked
+const static uint hmesh_magic = 0x48534D48; // HMSH
+const static uint hmesh_version = 3;
+
+struct HMeshHeader
+{
+    uint magic;
+    uint version;
+    uint collision_mode;
+    uint vertex_size;
+    std::uint64_t source_size;
+    std::int64_t source_time;
+    std::uint64_t source_hash;
+    uint vertex_count;
+    uint index_count;
+    uint sub_mesh_count;
+    uint collision_count;
+    uint collision_position_count;
+    uint collision_index_count;
+    uint collision_face_count;
+    uint lod_level_count;
+    float lod_reduction;
+    float lod_distance;
+    float collision_reduction;
+    uint reserved;
+    Vector3 bounds_min;
+    Vector3 bounds_max;
+
+    size_t get_file_size() const
     {
-        result->collisions_.add({Vector3::zero(), Quaternion(), MakeShared<ConcaveMeshCollision>(vertices_copy, indices_copy)});
+        return sizeof(HMeshHeader) +
+               sizeof(StaticMesh::Vertex) * vertex_count +
+               sizeof(uint) * index_count +
+               sizeof(StaticMesh::CookedSubMesh) * sub_mesh_count +
+               sizeof(float) * lod_level_count +
+               sizeof(StaticMesh::CookedSubMesh) * sub_mesh_count * lod_level_count +
+               sizeof(StaticMesh::CookedCollision) * collision_count +
+               sizeof(Vector3) * collision_position_count +
+               sizeof(uint) * collision_index_count +
+               sizeof(StaticMesh::CookedFace) * collision_face_count;
     }
-    else if (collision_mode == AutoCollisionMode::Convex)
+};
+
+static bool get_source_stamp(const Path& path, std::uint64_t& out_size, std::int64_t& out_time)
+{
+    std::error_code error;
+    const std::filesystem::path fs_path = path.get_absolute_string().std();
+
+    out_size = std::filesystem::file_size(fs_path, error);
+    if (error) return false;
+
+    out_time = std::filesystem::last_write_time(fs_path, error).time_since_epoch().count();
+    return !error;
+}
+
+// only used when source timestamp changed to tell if content changed too
+static std::uint64_t hash_file(const Path& path)
+{
+    if (const auto file = MappedFile::open(path))
     {
-        result->collisions_.add({Vector3::zero(), Quaternion(), MakeShared<ConvexMeshCollision>(vertices_copy, indices_copy)});
+        return ContentHash::combine_bytes(ContentHash::seed, file->get_data(), file->get_size());
     }
 
-    result->ogre_mesh_->_setBounds(Ogre::AxisAlignedBox(cast_object<Ogre::Vector3>(visual_bounds.min), cast_object<Ogre::Vector3>(visual_bounds.max)));
-    // result->ogre_mesh_->buildEdgeList();
+    return ContentHash::seed;
+}
 
+template<typename T>
+FORCEINLINE const T* read_cooked_array(const byte*& cursor, uint count)
+{
+    const T* result = reinterpret_cast<const T*>(cursor);
+    cursor += sizeof(T) * count;
     return result;
 }
+
+bool StaticMesh::map_cooked(const Path& source_path, const Path& cooked_path, AutoCollisionMode collision_mode, const MeshLodSettings& lod, Shared<MappedFile>& out_file, CookedMeshView& out_view)
+{
+    const std::filesystem::path fs_cooked_path = cooked_path.get_absolute_string().std();
+
+    // header is validated before mapping, so that stale timestamp can be fixed while file is not mapped yet
+    HMeshHeader header;
+    {
+        std::ifstream stream(fs_cooked_path, std::ios::in | std::ios::binary);
+        if (!stream.read(reinterpret_cast<char*>(&header), sizeof(HMeshHeader))) return false;
+    }
+
+    if (header.magic != hmesh_magic || header.version != hmesh_version) return false;
+    if (header.vertex_size != sizeof(Vertex) || header.collision_mode != (uint)collision_mode) return false;
+    if (header.lod_level_count != lod.level_count || header.lod_reduction != lod.reduction || header.lod_distance != lod.distance || header.collision_reduction != lod.collision_reduction) return false;
+
+    std::uint64_t source_size;
+    std::int64_t source_time;
+    if (!get_source_stamp(source_path, source_size, source_time)) return false;
+    if (source_size != header.source_size) return false;
+
+    if (source_time != header.source_time)
+    {
+        if (hash_file(source_path) != header.source_hash) return false;
+
+        // content is the same, only file was touched, store new time so that next launch does not hash it again
+        std::fstream stream(fs_cooked_path, std::ios::in | std::ios::out | std::ios::binary);
+        if (stream.seekp(offsetof(HMeshHeader, source_time)))
+        {
+            stream.write(reinterpret_cast<const char*>(&source_time), sizeof(source_time));
+        }
+    }
+
+    const auto file = MappedFile::open(cooked_path);
+    if (!file || file->get_size() != header.get_file_size()) return false;
+
+    const byte* cursor = file->get_data() + sizeof(HMeshHeader);
+
+    CookedMeshView view;
+    view.vertex_count = header.vertex_count;
+    view.vertices = read_cooked_array<Vertex>(cursor, header.vertex_count);
+    view.index_count = header.index_count;
+    view.indices = read_cooked_array<uint>(cursor, header.index_count);
+    view.sub_mesh_count = header.sub_mesh_count;
+    view.sub_meshes = read_cooked_array<CookedSubMesh>(cursor, header.sub_mesh_count);
+    view.lod_level_count = header.lod_level_count;
+    view.lod_distances = read_cooked_array<float>(cursor, header.lod_level_count);
+    view.lod_sub_meshes = read_cooked_array<CookedSubMesh>(cursor, header.sub_mesh_count * header.lod_level_count);
+    view.collision_count = header.collision_count;
+    view.collisions = read_cooked_array<CookedCollision>(cursor, header.collision_count);
+    view.collision_positions = read_cooked_array<Vector3>(cursor, header.collision_position_count);
+    view.collision_indices = read_cooked_array<uint>(cursor, header.collision_index_count);
+    view.collision_faces = read_cooked_array<CookedFace>(cursor, header.collision_face_count);
+    view.bounds_min = header.bounds_min;
+    view.bounds_max = header.bounds_max;
+
+    out_file = file;
+    out_view = view;
+    return true;
+}
+
+template<typename T>
+FORCEINLINE void write_cooked_array(std::ofstream& stream, const List<T>& list)
+{
+    stream.write(reinterpret_cast<const char*>(list.get_data()), sizeof(T) * list.length());
+}
+
+bool StaticMesh::save_cooked(const CookedMesh& cooked, const Path& source_path, const Path& cooked_path, AutoCollisionMode collision_mode, const MeshLodSettings& lod)
+{
+    HMeshHeader header = {};
+    header.magic = hmesh_magic;
+    header.version = hmesh_version;
+    header.collision_mode = (uint)collision_mode;
+    header.vertex_size = sizeof(Vertex);
+    if (!get_source_stamp(source_path, header.source_size, header.source_time)) return false;
+    header.source_hash = hash_file(source_path);
+    header.vertex_count = cooked.vertices.length();
+    header.index_count = cooked.indices.length();
+    header.sub_mesh_count = cooked.sub_meshes.length();
+    header.collision_count = cooked.collisions.length();
+    header.collision_position_count = cooked.collision_positions.length();
+    header.collision_index_count = cooked.collision_indices.length();
+    header.collision_face_count = cooked.collision_faces.length();
+    header.lod_level_count = cooked.lod_distances.length();
+    header.lod_reduction = lod.reduction;
+    header.lod_distance = lod.distance;
+    header.collision_reduction = lod.collision_reduction;
+    header.bounds_min = cooked.bounds_min;
+    header.bounds_max = cooked.bounds_max;
+
+    // write next to destination and swap, so that interrupted write never leaves broken cache
+    // name is unique per write, loads of the same mesh cooking at once must not write into one file
+    static std::atomic<uint> temp_counter = 0;
+    const std::filesystem::path fs_path = cooked_path.get_absolute_string().std();
+    std::filesystem::path temp_path = fs_path;
+    temp_path += String::format(".%zx.%u.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()), temp_counter++).std();
+
+    {
+        std::ofstream stream(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!stream) return false;
+
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(HMeshHeader));
+        write_cooked_array(stream, cooked.vertices);
+        write_cooked_array(stream, cooked.indices);
+        write_cooked_array(stream, cooked.sub_meshes);
+        write_cooked_array(stream, cooked.lod_distances);
+        write_cooked_array(stream, cooked.lod_sub_meshes);
+        write_cooked_array(stream, cooked.collisions);
+        write_cooked_array(stream, cooked.collision_positions);
+        write_cooked_array(stream, cooked.collision_indices);
+        write_cooked_array(stream, cooked.collision_faces);
+
+        if (!stream) return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, fs_path, error);
+    if (error)
+    {
+        // on windows old cache can't be replaced while some mesh still has it mapped, it is re-cooked next launch
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+
+    return true;
+}
@@ -4,9 +4,24 @@
 #include <base_lib/File.h>
 #include <base_lib/stb.h>
 #include "hexa_engine/Game.h"
+#include "hexa_engine/ThreadPool.h"
 
 #include <OgreTextureManager.h>
 #include <OgreHardwarePixelBuffer.h>
+#include <base_lib/Logger.h>
+#include <base_lib/Math.h>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+struct Texture::PendingLoad {
+    std::mutex mutex;
+    std::condition_variable decoded_condition;
+    bool decoded = false;
+    // null if decoding failed
+    Shared<Ogre::Image> image;
+};
 
 uint Texture::get_width() const {
     return ogre_texture_->getWidth();
@@ -17,9 +32,8 @@ uint Texture::get_height() const {
 }
 
 Color Texture::get_pixel(uint x, uint y) const {
-    Color pixel;
-    ogre_texture_->getBuffer()->readData((y * ogre_texture_->getWidth() + x) * sizeof(Color), sizeof(Color), &pixel);
-    return pixel;
+    ensure_shadow_copy();
+    return shadow_[y * get_width() + x];
 }
 
 void Texture::save_to_file(const Path& path) {
@@ -29,14 +43,192 @@ void Texture::save_to_file(const Path& path) {
 }
 
 void Texture::put_pixels(const Array2D<Color>& pixels) {
-    ogre_texture_->loadImage(Ogre::Image(Ogre::PF_R8G8B8A8, pixels.get_size_x(), pixels.get_size_y(), 4, (byte*)pixels.begin(), false));
+    if (pixels.get_size_x() != get_width() || pixels.get_size_y() != get_height()) {
+        release_shadow_copy();
+        ogre_texture_->unload();
+        ogre_texture_->loadImage(Ogre::Image(Ogre::PF_R8G8B8A8, pixels.get_size_x(), pixels.get_size_y(), 1, (byte*)pixels.begin(), false));
+        return;
+    }
+
+    // same size, so it is just a write of whole area
+    auto region = lock_region({0, 0, get_width(), get_height()}, TextureLock::Write);
+    for (uint y = 0; y < region.get_height(); y++) {
+        std::memcpy(region.get_row(y), pixels.begin() + static_cast<size_t>(y) * pixels.get_size_x(), region.get_width() * sizeof(Color));
+    }
 }
 
 Array2D<Color> Texture::get_pixels() const {
+    ensure_shadow_copy();
+
     Array2D<Color> pixels(get_width(), get_height());
-    ogre_texture_->getBuffer()->readData(0, pixels.get_size_total() * sizeof(Color), pixels.begin());
+    std::memcpy(pixels.begin(), &shadow_[0], pixels.get_size_total() * sizeof(Color));
     return pixels;
 }
 
+void Texture::keep_shadow_copy() {
+    ensure_shadow_copy();
+}
+
+void Texture::release_shadow_copy() {
+    shadow_.clear();
+    shadow_valid_ = false;
+}
+
+TextureRegion Texture::lock_region(const TextureRect& rect, TextureLock mode) {
+    TextureRect clipped;
+    clipped.x = Math::min(rect.x, get_width());
+    clipped.y = Math::min(rect.y, get_height());
+    clipped.width = Math::min(rect.width, get_width() - clipped.x);
+    clipped.height = Math::min(rect.height, get_height() - clipped.y);
+
+    // whole texture is about to be overwritten, reading it back first would be wasted
+    if (mode == TextureLock::Write && clipped.width == get_width() && clipped.height == get_height() && !shadow_valid_) {
+        shadow_.resize(get_width() * get_height(), Color());
+        shadow_valid_ = true;
+    }
+
+    ensure_shadow_copy();
+
+    Color* data = shadow_.length() > 0 ? &shadow_[clipped.y * get_width() + clipped.x] : nullptr;
+    return TextureRegion(this, clipped, data, get_width(), mode != TextureLock::Read);
+}
+
 Texture::Texture() {
 }
+
+bool Texture::decode_file(const Path& path, bool generate_mipmaps, Ogre::Image& out_image) {
+    try {
+        const Shared<Ogre::FileStreamDataStream> stream = MakeShared<Ogre::FileStreamDataStream>(new std::ifstream(path.get_absolute_string().c(), std::ios::in | std::ios::binary));
+        Ogre::Image decoded;
+        decoded.load(stream, path.extension.c());
+
+        out_image.create(Ogre::PF_R8G8B8A8, decoded.getWidth(), decoded.getHeight());
+        Ogre::PixelUtil::bulkPixelConversion(decoded.getPixelBox(), out_image.getPixelBox());
+
+        if (generate_mipmaps) out_image.generateMipmaps(false);
+    } catch (const std::exception& exception) {
+        print_error("Texture", "Failed to decode %s: %s", path.get_absolute_string().c(), exception.what());
+        return false;
+    }
+
+    return true;
+}
+
+void Texture::upload_image(const Ogre::Image& image) {
+    release_shadow_copy();
+
+    // same ogre texture is reloaded, so materials which bound it while loading show result without rebinding
+    ogre_texture_->unload();
+    ogre_texture_->setNumMipmaps(image.getNumMipmaps());
+    ogre_texture_->loadImage(image);
+    loaded_ = true;
+    failed_ = false;
+}
+
+void Texture::load_file_async(const Shared<Texture>& texture, const Path& path) {
+    texture->loaded_ = false;
+    texture->failed_ = false;
+
+    // worker holds pending load rather than texture member, which main thread resets
+    const auto pending = MakeShared<PendingLoad>();
+    texture->pending_ = pending;
+
+    ThreadPool::get().enqueue([path, pending, texture]() {
+        auto image = MakeShared<Ogre::Image>();
+        if (!decode_file(path, true, *image)) image = nullptr;
+
+        {
+            std::lock_guard lock(pending->mutex);
+            pending->decoded = true;
+            pending->image = image;
+        }
+        pending->decoded_condition.notify_all();
+
+        // ogre textures can be created only on main thread, synchronous load of the same texture may upload it sooner
+        Game::call_on_main_thread([texture]() {
+            texture->complete_load();
+        }, MainThreadPriority::Low);
+    });
+}
+
+bool Texture::complete_load() {
+    if (!pending_) return !failed_;
+
+    const auto pending = pending_;
+    pending_ = nullptr;
+
+    Shared<Ogre::Image> image;
+    {
+        std::unique_lock lock(pending->mutex);
+        pending->decoded_condition.wait(lock, [&pending]() { return pending->decoded; });
+        image = pending->image;
+    }
+
+    if (!image) {
+        failed_ = true;
+        return false;
+    }
+
+    upload_image(*image);
+    return true;
+}
+
+void Texture::ensure_shadow_copy() const {
+    if (shadow_valid_) return;
+
+    // the only readback, everything after it is served from memory
+    shadow_.resize(get_width() * get_height(), Color());
+    if (shadow_.length() > 0) {
+        ogre_texture_->getBuffer()->blitToMemory(Ogre::PixelBox(get_width(), get_height(), 1, Ogre::PF_R8G8B8A8, &shadow_[0]));
+    }
+    shadow_valid_ = true;
+}
+
+void Texture::upload_rect(const TextureRect& rect) {
+    if (rect.width == 0 || rect.height == 0 || !shadow_valid_) return;
+
+    const Ogre::Box box(rect.x, rect.y, rect.x + rect.width, rect.y + rect.height);
+
+    // box addresses into whole cpu copy, so rows keep full texture pitch
+    Ogre::PixelBox source(box, Ogre::PF_R8G8B8A8, &shadow_[0]);
+    source.rowPitch = get_width();
+    source.slicePitch = get_width() * get_height();
+
+    ogre_texture_->getBuffer()->blitFromMemory(source, box);
+
+    // lower mips are made from whole cpu copy again, otherwise they keep old pixels
+    if (ogre_texture_->getNumMipmaps() > 0 && !ogre_texture_->getMipmapsHardwareGenerated()) {
+        Ogre::Image image;
+        image.create(Ogre::PF_R8G8B8A8, get_width(), get_height());
+        std::memcpy(image.getData(), &shadow_[0], shadow_.length() * sizeof(Color));
+        image.generateMipmaps(false);
+
+        const uint mips = Math::min(static_cast<uint>(image.getNumMipmaps()), static_cast<uint>(ogre_texture_->getNumMipmaps()));
+        for (uint mip = 1; mip <= mips; mip++) {
+            ogre_texture_->getBuffer(0, mip)->blitFromMemory(image.getPixelBox(0, mip));
+        }
+    }
+}
+
+TextureRegion::TextureRegion(Texture* texture, const TextureRect& rect, Color* data, uint stride, bool write)
+    : texture_(texture)
+    , rect_(rect)
+    , data_(data)
+    , stride_(stride)
+    , write_(write) {
+}
+
+TextureRegion::TextureRegion(TextureRegion&& other) noexcept
+    : texture_(other.texture_)
+    , rect_(other.rect_)
+    , data_(other.data_)
+    , stride_(other.stride_)
+    , write_(other.write_) {
+    other.texture_ = nullptr;
+}
+
+TextureRegion::~TextureRegion() {
+    if (texture_ && write_) {
+        texture_->upload_rect(rect_);
+    }
+}
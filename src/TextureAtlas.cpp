@@ -0,0 +1,389 @@
+#include "hexa_engine/TextureAtlas.h"
+
+#include "hexa_engine/ContentHash.h"
+#include "hexa_engine/Module.h"
+#include "hexa_engine/Texture.h"
+#include "hexa_engine/ThreadPool.h"
+
+#include <OgreImage.h>
+#include <OgreTextureManager.h>
+#include <algorithm>
+#include <atomic>
+#include <base_lib/Logger.h>
+#include <base_lib/Math.h>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+// bump when packing or file layout changes
+const static uint texture_atlas_version = 1;
+const static uint max_atlas_size = 16384;
+
+struct AtlasSource
+{
+    String name;
+    Path path;
+    Ogre::Image image;
+    // top left corner of padded cell
+    uint x = 0;
+    uint y = 0;
+    uint cell_width = 0;
+    uint cell_height = 0;
+};
+
+static uint round_up_pow2(uint value)
+{
+    uint result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+static uint round_up(uint value, uint multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// sources have to be sorted by cell height, tallest first
+static bool pack(std::vector<AtlasSource*>& sources, uint width, uint height)
+{
+    uint x = 0;
+    uint y = 0;
+    uint shelf_height = 0;
+    for (auto source : sources)
+    {
+        if (source->cell_width > width) return false;
+
+        if (x + source->cell_width > width)
+        {
+            x = 0;
+            y += shelf_height;
+            shelf_height = 0;
+        }
+
+        if (y + source->cell_height > height) return false;
+
+        source->x = x;
+        source->y = y;
+        x += source->cell_width;
+        shelf_height = Math::max(shelf_height, source->cell_height);
+    }
+
+    return true;
+}
+
+// source goes to cell with padding on each side, padding repeats nearest edge pixel
+static void copy_with_border(const Ogre::Image& source, Ogre::Image& target, uint cell_x, uint cell_y, uint padding)
+{
+    const uint width = source.getWidth();
+    const uint height = source.getHeight();
+    const auto source_data = reinterpret_cast<const std::uint32_t*>(source.getData());
+    const auto target_data = reinterpret_cast<std::uint32_t*>(target.getData());
+    const uint target_width = target.getWidth();
+
+    for (uint y = 0; y < height + padding * 2; y++)
+    {
+        const uint source_y = Math::clamp(static_cast<int>(y) - static_cast<int>(padding), 0, static_cast<int>(height) - 1);
+        auto target_row = target_data + static_cast<size_t>(cell_y + y) * target_width + cell_x;
+        const auto source_row = source_data + static_cast<size_t>(source_y) * width;
+
+        for (uint x = 0; x < padding; x++)
+        {
+            target_row[x] = source_row[0];
+            target_row[padding + width + x] = source_row[width - 1];
+        }
+        std::memcpy(target_row + padding, source_row, width * sizeof(std::uint32_t));
+    }
+}
+
+static bool read_cache(const Path& layout_path, const Path& image_path, std::uint64_t hash, Map<Name, TextureAtlasEntry>& out_entries, uint& out_layers, Ogre::Image& out_image)
+{
+    if (!layout_path.exists() || !image_path.exists()) return false;
+
+    std::ifstream file(layout_path.get_absolute_string().std());
+    std::string magic;
+    uint version;
+    std::uint64_t cached_hash;
+    uint entry_count;
+    if (!(file >> magic >> version >> cached_hash >> out_layers >> entry_count)) return false;
+    if (magic != "hexa_atlas" || version != texture_atlas_version || cached_hash != hash) return false;
+
+    Map<Name, TextureAtlasEntry> entries;
+    for (uint i = 0; i < entry_count; i++)
+    {
+        std::string name;
+        TextureAtlasEntry entry;
+        if (!(file >> name >> entry.layer >> entry.uv_min.x >> entry.uv_min.y >> entry.uv_max.x >> entry.uv_max.y)) return false;
+
+        entries[Name(String(name.c_str()))] = entry;
+    }
+
+    if (!Texture::decode_file(image_path, false, out_image)) return false;
+
+    out_entries = entries;
+    return true;
+}
+
+// written next to target and renamed over it, so that other process never reads half written file
+// temp name keeps extension, ogre picks image codec by it
+template<typename F>
+static bool write_file_safe(const Path& path, F&& write)
+{
+    const std::filesystem::path fs_path = path.get_absolute_string().std();
+    std::filesystem::path temp_path = fs_path;
+    temp_path.replace_extension(".tmp" + fs_path.extension().string());
+
+    std::error_code error;
+    if (write(temp_path))
+    {
+        std::filesystem::rename(temp_path, fs_path, error);
+        if (!error) return true;
+    }
+
+    std::filesystem::remove(temp_path, error);
+    print_warning("Texture Atlas", "Failed to write %s", path.get_absolute_string().c());
+    return false;
+}
+
+static void write_cache(const Path& layout_path, const Path& image_path, std::uint64_t hash, const Map<Name, TextureAtlasEntry>& entries, uint layers, Ogre::Image& image)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(layout_path.get_absolute_string().std()).parent_path(), error);
+
+    const bool image_written = write_file_safe(image_path, [&image](const std::filesystem::path& temp_path) {
+        try
+        {
+            image.save(temp_path.string());
+            return true;
+        }
+        catch (const std::exception& exception)
+        {
+            print_warning("Texture Atlas", "Failed to save image: %s", exception.what());
+            return false;
+        }
+    });
+    if (!image_written) return;
+
+    // layout is written last, so that it never points to image which was not written
+    write_file_safe(layout_path, [&](const std::filesystem::path& temp_path) {
+        std::ofstream file(temp_path, std::ios::out | std::ios::trunc);
+        file << "hexa_atlas " << texture_atlas_version << " " << hash << " " << layers << " " << entries.size() << "\n";
+        file << std::setprecision(9);
+        for (const auto& entry : entries)
+        {
+            file << entry.key.to_string().std() << " " << entry.value.layer << " " << entry.value.uv_min.x << " " << entry.value.uv_min.y << " " << entry.value.uv_max.x << " " << entry.value.uv_max.y << "\n";
+        }
+
+        file.close();
+        return !file.fail();
+    });
+}
+
+Shared<TextureAtlas> TextureAtlas::build(const Shared<Module>& module, const String& directory, TextureAtlasMode mode, uint padding)
+{
+    if (!module) return nullptr;
+
+    const auto directory_path = module->get_textures_path() + directory;
+    if (!directory_path.exists())
+    {
+        print_error("Texture Atlas", "Directory does not exist: %s", directory_path.get_absolute_string().c());
+        return nullptr;
+    }
+
+    padding = round_up_pow2(Math::max(padding, 1u));
+
+    // ordered by name, so that packing and hash don't depend on order of directory listing
+    Map<String, Path> files;
+    for (const auto& path : directory_path.list())
+    {
+        if (path.get_type() == EPathType::Regular && path.extension == ".png")
+        {
+            files[path.filename] = path;
+        }
+    }
+
+    if (files.size() == 0)
+    {
+        print_warning("Texture Atlas", "No textures in %s", directory_path.get_absolute_string().c());
+        return nullptr;
+    }
+
+    std::uint64_t hash = ContentHash::seed;
+    hash = ContentHash::combine(hash, texture_atlas_version);
+    hash = ContentHash::combine(hash, mode);
+    hash = ContentHash::combine(hash, padding);
+    for (const auto& file : files)
+    {
+        const std::filesystem::path fs_path = file.value.get_absolute_string().std();
+        std::error_code error;
+        const auto size = std::filesystem::file_size(fs_path, error);
+        const auto time = std::filesystem::last_write_time(fs_path, error).time_since_epoch().count();
+
+        hash = ContentHash::combine_bytes(hash, file.key.c(), file.key.std().size());
+        hash = ContentHash::combine(hash, size);
+        hash = ContentHash::combine(hash, time);
+    }
+
+    String cache_name = String::format("%s_%s_%s", module->get_module_name().c(), directory.c(), mode == TextureAtlasMode::Atlas ? "atlas" : "array");
+    std::string sanitized = cache_name.std();
+    for (auto& character : sanitized)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(character))) character = '_';
+    }
+    const Path cache_directory = Path("cache") + "atlases";
+    const Path layout_path = cache_directory + (String(sanitized.c_str()) + ".atlas");
+    const Path image_path = cache_directory + (String(sanitized.c_str()) + ".png");
+
+    auto result = MakeSharedInternal(TextureAtlas);
+    result->mode_ = mode;
+
+    uint layers = 1;
+    Ogre::Image image;
+    if (read_cache(layout_path, image_path, hash, result->entries_, layers, image))
+    {
+        verbose("Texture Atlas", "Loaded %s from cache", directory_path.get_absolute_string().c());
+    }
+    else
+    {
+        std::vector<AtlasSource> sources(files.size());
+        uint index = 0;
+        for (const auto& file : files)
+        {
+            sources[index].name = file.key;
+            sources[index].path = file.value;
+            index++;
+        }
+
+        std::atomic<bool> decoded = true;
+        ThreadPool::get().parallel_for(static_cast<uint>(sources.size()), [&sources, &decoded](uint begin, uint end) {
+            for (uint i = begin; i < end; i++)
+            {
+                if (!Texture::decode_file(sources[i].path, false, sources[i].image)) decoded = false;
+            }
+        });
+        if (!decoded) return nullptr;
+
+        if (mode == TextureAtlasMode::Atlas)
+        {
+            std::vector<AtlasSource*> order;
+            uint area = 0;
+            for (auto& source : sources)
+            {
+                // cells start at multiples of padding, so borders stay aligned down to the last mip
+                source.cell_width = round_up(source.image.getWidth() + padding * 2, padding);
+                source.cell_height = round_up(source.image.getHeight() + padding * 2, padding);
+                area += source.cell_width * source.cell_height;
+                order.push_back(&source);
+            }
+            std::stable_sort(order.begin(), order.end(), [](const AtlasSource* a, const AtlasSource* b) { return a->cell_height > b->cell_height; });
+
+            uint width = round_up_pow2(static_cast<uint>(Math::sqrt(static_cast<double>(area))));
+            uint height = width;
+            while (true)
+            {
+                // checked before packing, so that neither first guess nor doubled size can go over limit
+                if (width > max_atlas_size || height > max_atlas_size)
+                {
+                    print_error("Texture Atlas", "Textures of %s don't fit into %ux%u", directory_path.get_absolute_string().c(), max_atlas_size, max_atlas_size);
+                    return nullptr;
+                }
+
+                if (pack(order, width, height)) break;
+
+                if (width == height) width *= 2;
+                else height *= 2;
+            }
+
+            image.create(Ogre::PF_R8G8B8A8, width, height);
+            std::memset(image.getData(), 0, image.getSize());
+
+            for (const auto& source : sources)
+            {
+                copy_with_border(source.image, image, source.x, source.y, padding);
+
+                TextureAtlasEntry entry;
+                entry.uv_min = Vector2(static_cast<float>(source.x + padding) / width, static_cast<float>(source.y + padding) / height);
+                entry.uv_max = Vector2(static_cast<float>(source.x + padding + source.image.getWidth()) / width, static_cast<float>(source.y + padding + source.image.getHeight()) / height);
+                result->entries_[Name(source.name)] = entry;
+            }
+        }
+        else
+        {
+            const uint width = sources[0].image.getWidth();
+            const uint height = sources[0].image.getHeight();
+            layers = static_cast<uint>(sources.size());
+
+            // layers are stacked vertically, which is the same memory as 3d image with one slice per layer
+            image.create(Ogre::PF_R8G8B8A8, width, height * layers);
+            const size_t layer_size = static_cast<size_t>(width) * height * sizeof(std::uint32_t);
+
+            for (uint i = 0; i < layers; i++)
+            {
+                auto& source = sources[i].image;
+                if (source.getWidth() != width || source.getHeight() != height)
+                {
+                    print_warning("Texture Atlas", "%s is scaled to %ux%u to fit array", sources[i].path.get_absolute_string().c(), width, height);
+                    source.resize(width, height);
+                }
+
+                std::memcpy(image.getData() + layer_size * i, source.getData(), layer_size);
+
+                TextureAtlasEntry entry;
+                entry.uv_min = Vector2(0.0f, 0.0f);
+                entry.uv_max = Vector2(1.0f, 1.0f);
+                entry.layer = i;
+                result->entries_[Name(sources[i].name)] = entry;
+            }
+        }
+
+        write_cache(layout_path, image_path, hash, result->entries_, layers, image);
+
+        verbose("Texture Atlas", "Packed %u textures of %s into %ux%u", static_cast<uint>(sources.size()), directory_path.get_absolute_string().c(), static_cast<uint>(image.getWidth()), static_cast<uint>(image.getHeight()));
+    }
+
+    // rebuilding replaces texture of previous build
+    const String texture_name = String::format("atlas:%s", directory.c());
+    if (Ogre::TextureManager::getSingleton().resourceExists(texture_name.c(), module->get_module_name().c()))
+    {
+        Ogre::TextureManager::getSingleton().remove(texture_name.c(), module->get_module_name().c());
+    }
+
+    Shared<Ogre::Texture> ogre_texture;
+    if (mode == TextureAtlasMode::Atlas)
+    {
+        // deeper mips would shrink borders below one pixel and neighbours would bleed in
+        int mipmaps = 0;
+        for (uint border = padding; border > 1; border >>= 1) mipmaps++;
+        ogre_texture = Ogre::TextureManager::getSingleton().loadImage(texture_name.c(), module->get_module_name().c(), image, Ogre::TEX_TYPE_2D, mipmaps, 1, false, Ogre::PF_R8G8B8A8);
+    }
+    else
+    {
+        const uint height = static_cast<uint>(image.getHeight()) / layers;
+        const Ogre::Image array(Ogre::PF_R8G8B8A8, image.getWidth(), height, layers, image.getData(), false);
+        ogre_texture = Ogre::TextureManager::getSingleton().loadImage(texture_name.c(), module->get_module_name().c(), array, Ogre::TEX_TYPE_2D_ARRAY, Ogre::MIP_DEFAULT, 1, false, Ogre::PF_R8G8B8A8);
+    }
+
+    result->texture_ = MakeSharedInternal(Texture);
+    result->texture_->ogre_texture_ = ogre_texture;
+    result->texture_->id_ = module->get_asset_id(Name(texture_name));
+
+    return result;
+}
+
+bool TextureAtlas::contains(const Name& name) const
+{
+    return entries_.contains(name);
+}
+
+TextureAtlasEntry TextureAtlas::get_entry(const Name& name) const
+{
+    if (const auto entry = entries_.find(name))
+    {
+        return *entry;
+    }
+
+    return TextureAtlasEntry();
+}
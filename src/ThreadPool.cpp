@@ -0,0 +1,126 @@
+#include "hexa_engine/ThreadPool.h"
+
+#include <atomic>
+#include <base_lib/Math.h>
+
+ThreadPool::ThreadPool(uint worker_count)
+{
+    for (uint i = 0; i < worker_count; i++)
+    {
+        workers_.add(MakeShared<std::thread>(&ThreadPool::worker_loop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(tasks_mutex_);
+        stopping_ = true;
+    }
+    tasks_condition_.notify_all();
+
+    for (auto& worker : workers_)
+    {
+        worker->join();
+    }
+}
+
+ThreadPool& ThreadPool::get()
+{
+    // one thread is left for whoever is waiting on results
+    static ThreadPool instance(Math::max(std::thread::hardware_concurrency(), 2u) - 1);
+    return instance;
+}
+
+void ThreadPool::enqueue(const Task& task)
+{
+    {
+        std::lock_guard lock(tasks_mutex_);
+        tasks_.push_back(task);
+    }
+    tasks_condition_.notify_one();
+}
+
+struct ParallelForState
+{
+    ThreadPool::RangeTask task;
+    uint count;
+    uint grain;
+    std::atomic<uint> next = 0;
+    std::atomic<uint> done = 0;
+    std::mutex done_mutex;
+    std::condition_variable done_condition;
+
+    // returns true if there was work to do
+    bool run_range()
+    {
+        const uint begin = next.fetch_add(grain);
+        if (begin >= count) return false;
+
+        const uint end = Math::min(begin + grain, count);
+        task(begin, end);
+
+        if (done.fetch_add(end - begin) + (end - begin) == count)
+        {
+            std::lock_guard lock(done_mutex);
+            done_condition.notify_all();
+        }
+
+        return true;
+    }
+};
+
+void ThreadPool::parallel_for(uint count, const RangeTask& task, uint grain)
+{
+    if (count == 0) return;
+
+    grain = Math::max(grain, 1u);
+    const uint range_count = (count + grain - 1) / grain;
+    if (range_count == 1 || workers_.length() == 0)
+    {
+        task(0, count);
+        return;
+    }
+
+    // helpers may start after everything is done, so they keep state alive on their own
+    const auto state = MakeShared<ParallelForState>();
+    state->task = task;
+    state->count = count;
+    state->grain = grain;
+
+    const uint helper_count = Math::min(range_count - 1, workers_.length());
+    for (uint i = 0; i < helper_count; i++)
+    {
+        enqueue([state]() {
+            while (state->run_range())
+            {
+            }
+        });
+    }
+
+    while (state->run_range())
+    {
+    }
+
+    std::unique_lock lock(state->done_mutex);
+    state->done_condition.wait(lock, [&state, count]() { return state->done.load() == count; });
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock lock(tasks_mutex_);
+            tasks_condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+
+            if (tasks_.empty()) return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+    }
+}
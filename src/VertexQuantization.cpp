@@ -0,0 +1,273 @@
+#include "hexa_engine/VertexQuantization.h"
+
+#include "hexa_engine/Shader.h"
+
+#include <base_lib/Math.h>
+#include <bit>
+
+static_assert(sizeof(VertexQuantization::CompactVertex) == 20);
+static_assert(sizeof(VertexQuantization::QuantizedVertex) == 16);
+
+// mirrors decode_octahedral and decode_position, short2 and short4 normalized attributes already arrive as [-1, 1]
+// input semantics stay the same for every format, only types differ
+const static char* shader_source = R"(
+#if defined(QUANTIZED_VERTEX)
+uniform float4 quantization_center;
+uniform float4 quantization_extents;
+#endif
+
+#if defined(COMPACT_VERTEX) || defined(QUANTIZED_VERTEX)
+float3 decode_normal(float2 encoded)
+{
+    float3 result = float3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-result.z, 0.0);
+    result.x += result.x >= 0.0 ? -t : t;
+    result.y += result.y >= 0.0 ? -t : t;
+    return normalize(result);
+}
+#endif
+
+#if defined(QUANTIZED_VERTEX)
+float4 decode_position(float4 encoded)
+{
+    return float4(quantization_center.xyz + encoded.xyz * quantization_extents.xyz, 1.0);
+}
+#elif defined(COMPACT_VERTEX)
+float4 decode_position(float4 encoded)
+{
+    return float4(encoded.xyz, 1.0);
+}
+#endif
+
+#line 1
+)";
+
+FORCEINLINE std::int16_t encode_snorm16(float value)
+{
+    return static_cast<std::int16_t>(Math::round(Math::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+FORCEINLINE float decode_snorm16(std::int16_t value)
+{
+    return Math::max(value / 32767.0f, -1.0f);
+}
+
+FORCEINLINE float sign_not_zero(float value)
+{
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+uint VertexQuantization::get_vertex_size(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::Compact:
+        return sizeof(CompactVertex);
+    case VertexFormat::Quantized:
+        return sizeof(QuantizedVertex);
+    default:
+        return sizeof(StaticMesh::Vertex);
+    }
+}
+
+uint VertexQuantization::get_shader_features(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::Compact:
+        return ShaderFeatures::COMPACT_VERTEX;
+    case VertexFormat::Quantized:
+        return ShaderFeatures::QUANTIZED_VERTEX;
+    default:
+        return 0;
+    }
+}
+
+String VertexQuantization::get_shader_source()
+{
+    return shader_source;
+}
+
+byte16 VertexQuantization::float_to_half(float value)
+{
+    const uint bits = std::bit_cast<uint>(value);
+    const uint sign = (bits >> 16) & 0x8000;
+    const uint float_exponent = (bits >> 23) & 0xff;
+    const int exponent = static_cast<int>(float_exponent) - 127 + 15;
+    uint mantissa = bits & 0x7fffff;
+
+    // inf and nan
+    if (float_exponent == 0xff) return static_cast<byte16>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    // too big, becomes inf
+    if (exponent >= 31) return static_cast<byte16>(sign | 0x7c00);
+
+    // too small for normal half, becomes subnormal or zero
+    if (exponent <= 0)
+    {
+        if (exponent < -10) return static_cast<byte16>(sign);
+
+        mantissa |= 0x800000;
+        const uint shift = 14 - exponent;
+        uint half_mantissa = mantissa >> shift;
+        const uint rest = mantissa & ((1u << shift) - 1);
+        const uint halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half_mantissa & 1))) half_mantissa++;
+
+        return static_cast<byte16>(sign | half_mantissa);
+    }
+
+    // round to nearest even, carry into exponent is intended
+    uint half = sign | (exponent << 10) | (mantissa >> 13);
+    const uint rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+
+    return static_cast<byte16>(half);
+}
+
+float VertexQuantization::half_to_float(byte16 value)
+{
+    const uint sign = (value & 0x8000u) << 16;
+    const uint exponent = (value >> 10) & 0x1f;
+    const uint mantissa = value & 0x3ff;
+
+    if (exponent == 0)
+    {
+        const float subnormal = mantissa * 5.9604645e-8f; // 2^-24
+        return sign ? -subnormal : subnormal;
+    }
+
+    if (exponent == 31) return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+
+    return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+uint VertexQuantization::encode_octahedral(const Vector3& normal)
+{
+    const float length = Math::abs(normal.x) + Math::abs(normal.y) + Math::abs(normal.z);
+    if (length < KINDA_SMALL_NUMBER) return 0;
+
+    float x = normal.x / length;
+    float y = normal.y / length;
+
+    // lower hemisphere is folded over diagonals
+    if (normal.z < 0.0f)
+    {
+        const float folded_x = (1.0f - Math::abs(y)) * sign_not_zero(x);
+        const float folded_y = (1.0f - Math::abs(x)) * sign_not_zero(y);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    return static_cast<byte16>(encode_snorm16(x)) | static_cast<uint>(static_cast<byte16>(encode_snorm16(y))) << 16;
+}
+
+Vector3 VertexQuantization::decode_octahedral(uint encoded)
+{
+    Vector3 result;
+    result.x = decode_snorm16(static_cast<std::int16_t>(encoded & 0xffff));
+    result.y = decode_snorm16(static_cast<std::int16_t>(encoded >> 16));
+    result.z = 1.0f - Math::abs(result.x) - Math::abs(result.y);
+
+    const float t = Math::max(-result.z, 0.0f);
+    result.x += result.x >= 0.0f ? -t : t;
+    result.y += result.y >= 0.0f ? -t : t;
+
+    return result.normalized();
+}
+
+void VertexQuantization::encode_position(const Vector3& pos, const Vector3& center, const Vector3& extents, std::int16_t out[4])
+{
+    out[0] = encode_snorm16((pos.x - center.x) / extents.x);
+    out[1] = encode_snorm16((pos.y - center.y) / extents.y);
+    out[2] = encode_snorm16((pos.z - center.z) / extents.z);
+    out[3] = 32767;
+}
+
+Vector3 VertexQuantization::decode_position(const std::int16_t encoded[4], const Vector3& center, const Vector3& extents)
+{
+    return Vector3(
+        center.x + decode_snorm16(encoded[0]) * extents.x,
+        center.y + decode_snorm16(encoded[1]) * extents.y,
+        center.z + decode_snorm16(encoded[2]) * extents.z);
+}
+
+Vector3 VertexQuantization::get_safe_extents(const Vector3& bounds_min, const Vector3& bounds_max)
+{
+    const Vector3 extents = (bounds_max - bounds_min) * 0.5f;
+    return Vector3(
+        extents.x > KINDA_SMALL_NUMBER ? extents.x : 1.0f,
+        extents.y > KINDA_SMALL_NUMBER ? extents.y : 1.0f,
+        extents.z > KINDA_SMALL_NUMBER ? extents.z : 1.0f);
+}
+
+void VertexQuantization::encode(const StaticMesh::Vertex* vertices, uint count, VertexFormat format, const Vector3& bounds_min, const Vector3& bounds_max, byte* out)
+{
+    switch (format)
+    {
+    case VertexFormat::Full:
+        memcpy(out, vertices, sizeof(StaticMesh::Vertex) * count);
+        break;
+    case VertexFormat::Compact:
+    {
+        auto compact = reinterpret_cast<CompactVertex*>(out);
+        for (uint i = 0; i < count; i++)
+        {
+            compact[i].pos = vertices[i].pos;
+            compact[i].uv[0] = float_to_half(vertices[i].uv.x);
+            compact[i].uv[1] = float_to_half(vertices[i].uv.y);
+            compact[i].norm = encode_octahedral(vertices[i].norm);
+        }
+        break;
+    }
+    case VertexFormat::Quantized:
+    {
+        const Vector3 center = (bounds_min + bounds_max) * 0.5f;
+        const Vector3 extents = get_safe_extents(bounds_min, bounds_max);
+
+        auto quantized = reinterpret_cast<QuantizedVertex*>(out);
+        for (uint i = 0; i < count; i++)
+        {
+            encode_position(vertices[i].pos, center, extents, quantized[i].pos);
+            quantized[i].uv[0] = float_to_half(vertices[i].uv.x);
+            quantized[i].uv[1] = float_to_half(vertices[i].uv.y);
+            quantized[i].norm = encode_octahedral(vertices[i].norm);
+        }
+        break;
+    }
+    }
+}
+
+void VertexQuantization::decode(const byte* data, uint count, VertexFormat format, const Vector3& bounds_min, const Vector3& bounds_max, StaticMesh::Vertex* out)
+{
+    switch (format)
+    {
+    case VertexFormat::Full:
+        memcpy(out, data, sizeof(StaticMesh::Vertex) * count);
+        break;
+    case VertexFormat::Compact:
+    {
+        auto compact = reinterpret_cast<const CompactVertex*>(data);
+        for (uint i = 0; i < count; i++)
+        {
+            out[i].pos = compact[i].pos;
+            out[i].uv = Vector2(half_to_float(compact[i].uv[0]), half_to_float(compact[i].uv[1]));
+            out[i].norm = decode_octahedral(compact[i].norm);
+        }
+        break;
+    }
+    case VertexFormat::Quantized:
+    {
+        const Vector3 center = (bounds_min + bounds_max) * 0.5f;
+        const Vector3 extents = get_safe_extents(bounds_min, bounds_max);
+
+        auto quantized = reinterpret_cast<const QuantizedVertex*>(data);
+        for (uint i = 0; i < count; i++)
+        {
+            out[i].pos = decode_position(quantized[i].pos, center, extents);
+            out[i].uv = Vector2(half_to_float(quantized[i].uv[0]), half_to_float(quantized[i].uv[1]));
+            out[i].norm = decode_octahedral(quantized[i].norm);
+        }
+        break;
+    }
+    }
+}
@@ -3,24 +3,48 @@
 #include "hexa_engine/AudioChannel.h"
 #include "hexa_engine/CollisionMaskBits.h"
 #include "hexa_engine/Game.h"
+#include "hexa_engine/InstancedMeshSet.h"
+#include "hexa_engine/Material.h"
 // #include "HexaGame/Entities/ItemDrop.h"
 #include "hexa_engine/Audio.h"
+#include "hexa_engine/CameraComponent.h"
+#include "hexa_engine/MeshComponent.h"
 #include "hexa_engine/OgreApp.h"
+#include "hexa_engine/Player.h"
 #include "hexa_engine/Settings.h"
 #include "hexa_engine/StaticMesh.h"
 #include "hexa_engine/Texture.h"
+#include "hexa_engine/WorldCells.h"
 #include "hexa_engine/physics/RaycastCallback.h"
 
 #include <OgreEntity.h>
 #include <OgreHardwarePixelBuffer.h>
+#include <OgreInstanceManager.h>
 #include <OgreMesh.h>
+#include <OgreRenderSystem.h>
 #include <OgreRoot.h>
 #include <OgreSceneManager.h>
+#include <OgreStaticGeometry.h>
 #include <OgreSubEntity.h>
+#include <base_lib/Assert.h>
 #include <base_lib/Quaternion.h>
+#include <bit>
+#include <cmath>
 #include <reactphysics3d/reactphysics3d.h>
 #include <soloud/soloud_wav.h>
 
+// how often bodies are tested against activation sources, there is no need to do it every frame
+const static float activation_check_interval = 0.25f;
+// bodies are frozen a bit farther than they are woken up, so that they don't flicker on the border
+const static float activation_hysteresis = 1.1f;
+// batch size of first instance managers of mesh, small so that rare meshes don't waste instance buffers
+const static uint min_instance_batch_size = 64;
+const static uint max_instance_batch_size = 4096;
+// new managers with bigger batches are created when instances of mesh would need more batches than this
+const static uint max_instance_batches_per_group = 4;
+// long frame does not try to catch up with all physics steps it missed, rest of the time is dropped
+const static uint max_physics_steps_per_tick = 8;
+
 bool World::spawn_entity(const Shared<Entity>& entity, const Transform& transform) {
     if (entities_.contains(entity)) return false;
 
@@ -92,7 +116,10 @@ void World::init() {
     manager_->setShadowTextureSize(2048);
     manager_->setShadowFarDistance(5000);
 
-    manager_->setSkyBox(true, "Engine/Skybox", 300, true);
+    // there are no materials without render system
+    if (!Game::is_headless()) {
+        manager_->setSkyBox(true, "Engine/Skybox", 300, true);
+    }
 
     set_ambient_light(Color::white(), 0.5f);
 
@@ -117,16 +144,26 @@ void World::tick(float delta_time) {
 
     // fixed tick for physics
     if (delta_time != 0.0f) {
+        activation_check_accum_ += delta_time;
+        if (activation_check_accum_ >= activation_check_interval) {
+            activation_check_accum_ = 0.0f;
+            update_physics_activation();
+        }
+
         physics_tick_accum_ += delta_time;
         const auto interval = Game::get_settings()->get_physics_tick_interval();
-        /*while (physics_tick_accum_ > interval)
-        {
-            //physics_world_->update(interval);
-            //physics_tick_accum_ -= interval;
 
-            physics_world_->update(physics_tick_accum_);
-            physics_tick_accum_ = 0;
-        }*/
+        // same fixed interval with and without rendering, so that headless simulation behaves like the game
+        uint steps = 0;
+        while (physics_tick_accum_ >= interval && steps < max_physics_steps_per_tick) {
+            physics_world_->update(interval);
+            physics_tick_accum_ -= interval;
+            steps++;
+        }
+
+        if (steps == max_physics_steps_per_tick) {
+            physics_tick_accum_ = Math::min(physics_tick_accum_, interval);
+        }
     }
 
     // tick timers
@@ -166,6 +203,12 @@ void World::tick(float delta_time) {
             }
         }
     }
+
+    // pipelined frame does this when it is published
+    if (!simulating_) {
+        rebuild_static_batches();
+        flush_instanced_mesh_sets();
+    }
 }
 
 const Set<Shared<Entity>>& World::get_entities() const {
@@ -210,6 +253,29 @@ void World::set_directional_light(const Color& color, float intensity, const Qua
     directional_light_->setSpecularColour(light.x, light.y, light.z);
 }
 
+void World::add_activation_source(const Shared<Entity>& entity) {
+    if (entity == nullptr) return;
+
+    for (const auto& source : activation_sources_) {
+        if (source.lock() == entity) return;
+    }
+
+    activation_sources_.add(entity);
+}
+
+void World::remove_activation_source(const Shared<Entity>& entity) {
+    for (uint i = 0; i < activation_sources_.length(); i++) {
+        if (activation_sources_[i].lock() == entity) {
+            activation_sources_.remove_at(i);
+            return;
+        }
+    }
+}
+
+void World::set_activation_radius(float radius) {
+    activation_radius_ = Math::max(radius, 0.0f);
+}
+
 void World::on_start() {
 }
 
@@ -219,6 +285,32 @@ void World::on_tick(float delta_time) {
 void World::on_close() {
 }
 
+void World::apply_render_state() {
+    // commands may add more commands, those run immediately as simulation is not running now
+    auto commands = std::move(render_commands_);
+    render_commands_.clear();
+    for (auto& command : commands) {
+        command();
+    }
+
+    for (const auto& entity : render_dirty_entities_) {
+        if (!entity->scene_node_) continue;
+
+        const auto& transform = entity->transform_;
+        entity->scene_node_->setPosition(cast_object<Ogre::Vector3>(transform.location));
+        entity->scene_node_->setOrientation(Ogre::Quaternion(transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z));
+        entity->scene_node_->setScale(cast_object<Ogre::Vector3>(transform.scale));
+    }
+    render_dirty_entities_.clear();
+
+    rebuild_static_batches();
+    flush_instanced_mesh_sets();
+}
+
+void World::mark_render_dirty(const Shared<Entity>& entity) {
+    render_dirty_entities_.add(entity);
+}
+
 void World::close() {
     on_close();
 
@@ -231,6 +323,21 @@ void World::close() {
         entity->on_destroyed(entity);
     }
 
+    activation_sources_.clear();
+    frozen_bodies_.clear();
+
+    // geometry itself is destroyed with scene manager, so are objects of pending commands
+    render_commands_.clear();
+    render_dirty_entities_.clear();
+    static_batch_cells_.clear();
+    instance_managers_.clear();
+
+    for (auto& set : instanced_mesh_sets_) {
+        set->clear();
+        set->release();
+    }
+    instanced_mesh_sets_.clear();
+
     Game::instance_->physics_->destroyPhysicsWorld(physics_world_);
     physics_world_ = nullptr;
 
@@ -239,9 +346,11 @@ void World::close() {
 }
 
 void World::spawn_entity_internal(const Shared<Entity>& entity) {
-    const auto& rot = entity->transform_.rotation;
-    entity->scene_node_ = world_root_->createChildSceneNode(cast_object<Ogre::Vector3>(entity->transform_.location), Ogre::Quaternion(rot.w, rot.x, rot.y, rot.z));
-    entity->scene_node_->setScale(cast_object<Ogre::Vector3>(entity->transform_.scale));
+    run_render_command([this, entity]() {
+        const auto& rot = entity->transform_.rotation;
+        entity->scene_node_ = world_root_->createChildSceneNode(cast_object<Ogre::Vector3>(entity->transform_.location), Ogre::Quaternion(rot.w, rot.x, rot.y, rot.z));
+        entity->scene_node_->setScale(cast_object<Ogre::Vector3>(entity->transform_.scale));
+    });
     entity->world_ = weak_from_this();
     /*if (entity->is_rigid_body())
     {
@@ -259,6 +368,11 @@ void World::spawn_entity_internal(const Shared<Entity>& entity) {
         tick_list_.add(entity);
     }
 
+    // done here rather than in player hooks, so that subclasses can't skip it
+    if (cast<Player>(entity)) {
+        add_activation_source(entity);
+    }
+
     entity->start();
 }
 
@@ -268,11 +382,66 @@ void World::do_destroy(const Shared<Entity>& entity) {
         component->on_destroy();
     }
 
-    world_root_->removeChild(entity->scene_node_);
+    run_render_command([this, entity]() {
+        world_root_->removeChild(entity->scene_node_);
+    });
 
     entity->on_destroyed(entity);
 }
 
+void World::update_physics_activation() {
+    List<Vector3> source_locations;
+
+    if (const auto& camera = Game::instance_->current_camera_) {
+        source_locations.add(camera->get_owner()->get_location());
+    }
+
+    for (uint i = 0; i < activation_sources_.length(); i++) {
+        if (const auto source = activation_sources_[i].lock()) {
+            source_locations.add(source->get_location());
+        } else {
+            activation_sources_.remove_at(i--);
+        }
+    }
+
+    const float freeze_radius = activation_radius_ * activation_hysteresis;
+
+    for (uint i = 0; i < physics_world_->getNbRigidBodies(); i++) {
+        auto body = physics_world_->getRigidBody(i);
+        if (body->getType() != reactphysics3d::BodyType::DYNAMIC) continue;
+
+        // without sources there is nothing to measure against, so everything stays simulated
+        float nearest_distance = source_locations.length() > 0 ? std::numeric_limits<float>::max() : 0.0f;
+        const Vector3 body_location = cast_object<Vector3>(body->getTransform().getPosition());
+        for (const auto& source_location : source_locations) {
+            nearest_distance = Math::min(nearest_distance, Vector3::distance(body_location, source_location));
+        }
+
+        if (const auto frozen = frozen_bodies_.find(body)) {
+            if (nearest_distance <= activation_radius_) {
+                body->setIsActive(true);
+                body->setLinearVelocity(cast_object<reactphysics3d::Vector3>(frozen->linear_velocity));
+                body->setAngularVelocity(cast_object<reactphysics3d::Vector3>(frozen->angular_velocity));
+                body->setIsSleeping(frozen->sleeping);
+
+                frozen_bodies_.remove(body);
+            }
+        } else if (nearest_distance > freeze_radius && body->isActive()) {
+            frozen_bodies_.insert(body, {
+                cast_object<Vector3>(body->getLinearVelocity()),
+                cast_object<Vector3>(body->getAngularVelocity()),
+                body->isSleeping()
+            });
+
+            body->setIsActive(false);
+        }
+    }
+}
+
+void World::forget_body(reactphysics3d::RigidBody* body) {
+    frozen_bodies_.remove(body);
+}
+
 void World::set_entity_tick_enabled(const Shared<Entity>& entity, bool state) {
     if (state) {
         tick_list_.add(entity);
@@ -289,17 +458,158 @@ void World::mark_entity_for_destroy(const Shared<Entity>& entity, bool state) {
     }
 }
 
-List<Ogre::InstanceManager*> World::get_or_create_instance_managers(const Shared<StaticMesh>& mesh, uint batch_instance_count, uint instanced_params_count) {
-    if (auto managers = instance_managers_.find(mesh)) {
-        return *managers;
-    } else {
-        auto& new_managers = instance_managers_[mesh];
+List<Ogre::InstanceManager*> World::acquire_instance_managers(const Shared<StaticMesh>& mesh) {
+    auto& instancing = instance_managers_[mesh];
+    instancing.live_count++;
+
+    const bool needs_group = instancing.groups.length() == 0;
+    const auto batch_size = needs_group ? 0 : instancing.groups[instancing.groups.length() - 1].batch_size;
+    if (needs_group || (batch_size < max_instance_batch_size && instancing.live_count > batch_size * max_instance_batches_per_group)) {
+        InstanceManagerGroup group;
+        group.batch_size = Math::clamp(std::bit_ceil(instancing.live_count), min_instance_batch_size, max_instance_batch_size);
+
+        const auto group_id = instancing.next_group_id++;
         for (uint i = 0; i < mesh->ogre_mesh_->getNumSubMeshes(); i++) {
-            auto new_manager = manager_->createInstanceManager(String::format("%s_%i", mesh->name_.c(), i).c(), mesh->ogre_mesh_, Ogre::InstanceManager::HWInstancingBasic, batch_instance_count, Ogre::IM_USEALL, i);
+            group.managers.add(create_instance_manager(String::format("%s_%u_%i", mesh->name_.c(), group_id, i), mesh, i, group.batch_size));
+        }
+
+        instancing.groups.add(group);
+    }
+
+    auto& group = instancing.groups[instancing.groups.length() - 1];
+    group.live_count++;
+    return group.managers;
+}
+
+void World::release_instance_managers(const Shared<StaticMesh>& mesh, const List<Ogre::InstanceManager*>& managers) {
+    auto instancing = instance_managers_.find(mesh);
+    if (!instancing || managers.length() == 0) return;
+
+    instancing->live_count--;
+
+    for (uint i = 0; i < instancing->groups.length(); i++) {
+        auto& group = instancing->groups[i];
+        if (group.managers[0] != managers[0]) continue;
+
+        group.live_count--;
+
+        // last group is kept while mesh has instances, next ones will go to it anyway
+        if (group.live_count == 0 && (i + 1 < instancing->groups.length() || instancing->live_count == 0)) {
+            for (auto manager : group.managers) {
+                manager_->destroyInstanceManager(manager);
+            }
 
-            new_manager->setNumCustomParams(instanced_params_count);
-            new_managers.add(new_manager);
+            instancing->groups.remove_at(i);
         }
-        return new_managers;
+        break;
+    }
+
+    if (instancing->live_count == 0) {
+        instance_managers_.remove(mesh);
+    }
+}
+
+Ogre::InstanceManager* World::create_instance_manager(const String& name, const Shared<StaticMesh>& mesh, uint sub_mesh, uint batch_size) const {
+    // instance data buffer when hardware has it, transforms in vertex texture otherwise, both carry custom params
+    const auto technique = Game::instance_->ogre_app_->getRoot()->getRenderSystem()->getCapabilities()->hasCapability(Ogre::RSC_VERTEX_BUFFER_INSTANCE_DATA)
+        ? Ogre::InstanceManager::HWInstancingBasic
+        : Ogre::InstanceManager::HWInstancingVTF;
+
+    auto manager = manager_->createInstanceManager(name.c(), mesh->ogre_mesh_, technique, batch_size, Ogre::IM_USEALL, sub_mesh);
+    manager->setNumCustomParams(InstanceParams::COUNT);
+    return manager;
+}
+
+Shared<InstancedMeshSet> World::create_instanced_mesh_set(const Shared<StaticMesh>& mesh, const List<Shared<Material>>& materials) {
+    if (!Check(mesh && mesh->ogre_mesh_, "World", "Instanced mesh set requires valid mesh")) return nullptr;
+
+    auto set = MakeShared<InstancedMeshSet>(this, mesh, materials);
+    instanced_mesh_sets_.add(set);
+    return set;
+}
+
+void World::destroy_instanced_mesh_set(const Shared<InstancedMeshSet>& set) {
+    for (uint i = 0; i < instanced_mesh_sets_.length(); i++) {
+        if (instanced_mesh_sets_[i] == set) {
+            set->clear();
+            run_render_command([set]() {
+                set->release();
+            });
+            instanced_mesh_sets_.remove_at(i);
+            return;
+        }
+    }
+}
+
+void World::flush_instanced_mesh_sets() {
+    if (instanced_mesh_sets_.length() == 0) return;
+
+    Vector3 camera_location;
+    const bool has_camera = Game::instance_->current_camera_ != nullptr;
+    if (has_camera) {
+        camera_location = Game::instance_->current_camera_->get_owner()->get_location();
+    }
+
+    for (auto& set : instanced_mesh_sets_) {
+        set->flush(has_camera ? &camera_location : nullptr);
+    }
+}
+
+void World::add_static_batch_member(MeshComponent* component, const Transform& transform) {
+    // static batches are split into world cells, so that far ones are culled and removal rebuilds only part of the world
+    const auto key = WorldCells::get_key(transform.location);
+    component->static_batch_cell_ = key;
+
+    auto& cell = static_batch_cells_[key];
+    if (!cell.geometry) {
+        cell.geometry = manager_->createStaticGeometry(String::format("static_batch_%llu", static_cast<unsigned long long>(key)).c());
+        cell.geometry->setRegionDimensions(Ogre::Vector3(WorldCells::cell_size));
+        cell.geometry->setOrigin(cast_object<Ogre::Vector3>(WorldCells::get_origin(transform.location)));
+    }
+
+    cell.members.insert(component, transform);
+    cell.dirty = true;
+}
+
+void World::remove_static_batch_member(MeshComponent* component) {
+    if (auto cell = static_batch_cells_.find(component->static_batch_cell_)) {
+        cell->members.remove(component);
+        cell->dirty = true;
+    }
+}
+
+void World::mark_static_batch_dirty(MeshComponent* component) {
+    if (auto cell = static_batch_cells_.find(component->static_batch_cell_)) {
+        cell->dirty = true;
+    }
+}
+
+void World::rebuild_static_batches() {
+    List<std::uint64_t> empty_cells;
+
+    for (auto& entry : static_batch_cells_) {
+        auto& cell = entry.value;
+        if (!cell.dirty) continue;
+        cell.dirty = false;
+
+        // ogre can not remove single entity from built geometry, so only this cell is built again from remaining members
+        cell.geometry->reset();
+
+        if (cell.members.size() == 0) {
+            empty_cells.add(entry.key);
+            continue;
+        }
+
+        for (const auto& member : cell.members) {
+            const auto& rot = member.value.rotation;
+            cell.geometry->addEntity(member.key->ogre_entity_, cast_object<Ogre::Vector3>(member.value.location), Ogre::Quaternion(rot.w, rot.x, rot.y, rot.z), cast_object<Ogre::Vector3>(member.value.scale));
+        }
+
+        cell.geometry->build();
+    }
+
+    for (const auto& key : empty_cells) {
+        manager_->destroyStaticGeometry(static_batch_cells_[key].geometry);
+        static_batch_cells_.remove(key);
     }
 }
@@ -0,0 +1,21 @@
+#include "hexa_engine/WorldCells.h"
+
+#include <cmath>
+
+std::uint64_t WorldCells::get_key(const Vector3& location)
+{
+    const auto coordinate = [](float value) -> std::uint64_t
+    {
+        return static_cast<std::uint64_t>(static_cast<int32>(std::floor(value / cell_size))) & 0x1fffff;
+    };
+
+    return coordinate(location.x) << 42 | coordinate(location.y) << 21 | coordinate(location.z);
+}
+
+Vector3 WorldCells::get_origin(const Vector3& location)
+{
+    return Vector3(
+        std::floor(location.x / cell_size) * cell_size,
+        std::floor(location.y / cell_size) * cell_size,
+        std::floor(location.z / cell_size) * cell_size);
+}
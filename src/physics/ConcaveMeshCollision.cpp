@@ -11,7 +11,19 @@ ConcaveMeshCollision::ConcaveMeshCollision(const List<StaticMesh::Vertex>& verti
     {
         vertices_copy_[i] = vertices[i].pos;
     }
-    
+
+    create_shape();
+}
+
+ConcaveMeshCollision::ConcaveMeshCollision(const List<Vector3>& positions, const List<uint>& indices)
+    : vertices_copy_(positions)
+    , indices_copy_(indices)
+{
+    create_shape();
+}
+
+void ConcaveMeshCollision::create_shape()
+{
     triangle_vertex_array = new reactphysics3d::TriangleVertexArray(
         vertices_copy_.length(),
         vertices_copy_.get_data(),
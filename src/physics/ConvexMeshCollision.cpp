@@ -4,21 +4,38 @@
 #include <reactphysics3d/engine/PhysicsCommon.h>
 
 ConvexMeshCollision::ConvexMeshCollision(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices)
-    : indices_copy_(indices)
+{
+    cook(vertices, indices, vertices_copy_, indices_copy_, faces);
+
+    create_shape();
+}
+
+ConvexMeshCollision::ConvexMeshCollision(const List<Vector3>& positions, const List<uint>& face_indices, const List<GeometryEditor::Face>& faces)
+    : vertices_copy_(positions)
+    , indices_copy_(face_indices)
+    , faces(faces)
+{
+    create_shape();
+}
+
+void ConvexMeshCollision::cook(const List<StaticMesh::Vertex>& vertices, const List<uint>& indices, List<Vector3>& out_positions, List<uint>& out_face_indices, List<GeometryEditor::Face>& out_faces)
 {
     auto source_vertices = vertices;
     auto source_indices = indices;
-    
+
     GeometryEditor::optimize_collision(source_vertices, source_indices);
-    
-    GeometryEditor::compute_faces(source_vertices, source_indices, faces, indices_copy_);
-    
-    vertices_copy_ = List<Vector3>(source_vertices.length());
+
+    GeometryEditor::compute_faces(source_vertices, source_indices, out_faces, out_face_indices);
+
+    out_positions = List<Vector3>(source_vertices.length());
     for (uint i = 0; i < source_vertices.length(); i++)
     {
-        vertices_copy_[i] = source_vertices[i].pos;
+        out_positions[i] = source_vertices[i].pos;
     }
+}
 
+void ConvexMeshCollision::create_shape()
+{
     polygon_vertex_array = new reactphysics3d::PolygonVertexArray(
         vertices_copy_.length(),
         vertices_copy_.get_data(),
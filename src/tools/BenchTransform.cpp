@@ -0,0 +1,76 @@
+#include "hexa_engine/tools/BenchTransform.h"
+
+#include "hexa_engine/GeometryEditor.h"
+
+#include <base_lib/Logger.h>
+#include <chrono>
+#include <cstdlib>
+
+// scale, rotate and translate one vertex at a time, the way chained GeometryEditor calls used to do it
+static void transform_per_vertex(List<StaticMesh::Vertex>& vertices, const Transform& transformation) {
+    for (auto& vertex : vertices) {
+        vertex.pos *= transformation.scale;
+    }
+    for (auto& vertex : vertices) {
+        vertex.pos = transformation.rotation.rotate_vector3(vertex.pos);
+        vertex.norm = transformation.rotation.rotate_vector3(vertex.norm);
+    }
+    for (auto& vertex : vertices) {
+        vertex.pos += transformation.location;
+    }
+}
+
+template<typename Callable>
+static double measure_ms(uint iterations, Callable callable) {
+    const auto start = std::chrono::steady_clock::now();
+    for (uint i = 0; i < iterations; i++) {
+        callable();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+void Tools::BenchTransform::execute(const List<String>& args) {
+    const uint vertex_count = args.length() >= 1 ? static_cast<uint>(std::strtoul(args[0].c(), nullptr, 10)) : 1000000;
+    const uint iterations = args.length() >= 2 ? static_cast<uint>(std::strtoul(args[1].c(), nullptr, 10)) : 20;
+    if (vertex_count == 0 || iterations == 0) {
+        print_error("bench_transform", "Vertex count and iterations must be positive");
+        return;
+    }
+
+    List<StaticMesh::Vertex> source(vertex_count);
+    for (uint i = 0; i < vertex_count; i++) {
+        const float f = static_cast<float>(i);
+        source[i].pos = Vector3(f * 0.25f, f * 0.5f - 3.0f, 7.0f - f * 0.125f);
+        source[i].uv = Vector2(f * 0.001f, 1.0f - f * 0.001f);
+        source[i].norm = Vector3(0.0f, 0.0f, 1.0f);
+    }
+
+    // uniform scale keeps normals unit length, so per-vertex path gives the same result
+    const Transform transformation(Vector3(10.0f, -5.0f, 2.0f), Quaternion::from_axis_angle(Vector3::forward(), 90), Vector3(100.0f, 100.0f, 100.0f));
+
+    List<StaticMesh::Vertex> reference = source;
+    transform_per_vertex(reference, transformation);
+
+    List<StaticMesh::Vertex> work = source;
+    const double per_vertex_ms = measure_ms(iterations, [&]() { transform_per_vertex(work, transformation); });
+    verbose("bench_transform", "%u vertices, %u iterations", vertex_count, iterations);
+    verbose("bench_transform", "per-vertex: %.3f ms", per_vertex_ms);
+
+    const char* level_names[] = {"scalar", "sse", "avx"};
+    for (uint level = 0; level <= static_cast<uint>(GeometryEditor::get_simd_level()); level++) {
+        const auto simd_level = static_cast<GeometryEditor::SimdLevel>(level);
+
+        work = source;
+        GeometryEditor::transform(work, transformation, simd_level);
+
+        float max_error = 0.0f;
+        for (uint i = 0; i < vertex_count; i++) {
+            max_error = Math::max(max_error, (work[i].pos - reference[i].pos).magnitude() / Math::max(reference[i].pos.magnitude(), 1.0f));
+            max_error = Math::max(max_error, (work[i].norm - reference[i].norm).magnitude());
+            max_error = Math::max(max_error, Math::max(Math::abs(work[i].uv.x - reference[i].uv.x), Math::abs(work[i].uv.y - reference[i].uv.y)));
+        }
+
+        const double ms = measure_ms(iterations, [&]() { GeometryEditor::transform(work, transformation, simd_level); });
+        verbose("bench_transform", "%s: %.3f ms, %.2fx, max relative error %g", level_names[level], ms, per_vertex_ms / ms, max_error);
+    }
+}
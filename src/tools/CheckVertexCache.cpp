@@ -0,0 +1,97 @@
+#include "hexa_engine/tools/CheckVertexCache.h"
+
+#include "hexa_engine/GeometryEditor.h"
+
+#include <algorithm>
+#include <base_lib/Logger.h>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+static bool check(bool condition, const char* what) {
+    if (condition) {
+        verbose("check_vertex_cache", "ok: %s", what);
+    } else {
+        print_error("check_vertex_cache", "FAILED: %s", what);
+    }
+    return condition;
+}
+
+// triangles as sorted vertex triples, so that rotated triangles compare equal
+static std::vector<std::uint64_t> get_triangle_keys(const List<uint>& indices) {
+    std::vector<std::uint64_t> result;
+    for (uint i = 0; i + 2 < indices.length(); i += 3) {
+        uint a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a > b) std::swap(a, b);
+        if (b > c) std::swap(b, c);
+        if (a > b) std::swap(a, b);
+        result.push_back((static_cast<std::uint64_t>(a) << 42) | (static_cast<std::uint64_t>(b) << 21) | c);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void Tools::CheckVertexCache::execute(const List<String>& args) {
+    const uint grid_size = args.length() >= 1 ? static_cast<uint>(std::strtoul(args[0].c(), nullptr, 10)) : 64;
+    if (grid_size < 2) {
+        print_error("check_vertex_cache", "Grid size must be at least 2");
+        return;
+    }
+
+    bool passed = true;
+
+    // same triangle twice, second one is fully cached
+    {
+        const auto stats = GeometryEditor::analyze_vertex_cache({0, 1, 2, 0, 1, 2}, 3, 3);
+        passed &= check(stats.vertices_transformed == 3 && stats.acmr == 1.5f && stats.atvr == 1.0f, "repeated triangle hits cache");
+    }
+
+    // three new vertices push first ones out of FIFO of size 3
+    {
+        const auto stats = GeometryEditor::analyze_vertex_cache({0, 1, 2, 3, 4, 5, 0, 1, 2}, 6, 3);
+        passed &= check(stats.vertices_transformed == 9 && stats.acmr == 3.0f && stats.atvr == 1.5f, "evicted vertices are transformed again");
+    }
+
+    // FIFO is not refreshed by hits, unlike LRU
+    {
+        const auto stats = GeometryEditor::analyze_vertex_cache({0, 1, 2, 0, 3, 4, 0, 1, 2}, 5, 3);
+        passed &= check(stats.vertices_transformed == 8, "hits don't refresh FIFO position");
+    }
+
+    // grid of quads with triangles in scrambled order, worst case for any cache
+    const uint side = grid_size + 1;
+    List<uint> indices;
+    for (uint y = 0; y < grid_size; y++) {
+        for (uint x = 0; x < grid_size; x++) {
+            const uint v = y * side + x;
+            indices.add_many({v, v + 1, v + side, v + 1, v + side + 1, v + side});
+        }
+    }
+
+    const uint triangle_count = indices.length() / 3;
+    std::uint64_t random = 0x2545F4914F6CDD1Dull;
+    for (uint i = triangle_count - 1; i > 0; i--) {
+        random = random * 6364136223846793005ull + 1442695040888963407ull;
+        const uint j = static_cast<uint>((random >> 33) % (i + 1));
+        for (uint k = 0; k < 3; k++) std::swap(indices[i * 3 + k], indices[j * 3 + k]);
+    }
+
+    const auto keys_before = get_triangle_keys(indices);
+    const auto before = GeometryEditor::analyze_vertex_cache(indices, side * side);
+
+    GeometryEditor::optimize_vertex_cache(indices, side * side);
+    const auto after = GeometryEditor::analyze_vertex_cache(indices, side * side);
+
+    verbose("check_vertex_cache", "%ux%u grid, cache %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", grid_size, grid_size, GeometryEditor::default_cache_size, before.acmr, after.acmr, before.atvr, after.atvr);
+
+    passed &= check(indices.length() == triangle_count * 3 && get_triangle_keys(indices) == keys_before, "optimization keeps the same triangles");
+    passed &= check(after.acmr < before.acmr, "optimization lowers ACMR");
+    // tipsify stays well below 1.0 on regular grids, scrambled order is close to 2.0
+    passed &= check(after.acmr < 0.9f, "optimized ACMR is below 0.9");
+
+    if (passed) {
+        verbose("check_vertex_cache", "All checks passed");
+    } else {
+        print_error("check_vertex_cache", "Some checks failed");
+    }
+}